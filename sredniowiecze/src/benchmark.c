@@ -0,0 +1,247 @@
+/** @file
+    Benchmark of the game engine on big armies.
+
+    The first player's peasants keep producing peasants on free neighbouring
+    fields, so the army doubles every few turns, while the second player only
+    ends turns. For each doubling of the army the average time of one command
+    (including commands rejected because the target field is occupied)
+    is printed, which shows how the cost of a command scales with the number
+    of units on the board.
+
+    Usage: middle_ages_benchmark [units], by default 65536 units.
+
+    With --check-grid the benchmark instead checks results of
+    spatialGridNearest() against a brute-force search, on random insertions,
+    removals and moves of values on boards of several sizes.
+*/
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "engine.h"
+#include "spatial_grid.h"
+
+/// Size of the board used by the benchmark.
+const int BENCHMARK_BOARD_SIZE = 1 << 30;
+
+/// A peasant of the first player which may still have free neighbouring fields.
+typedef struct Producer {
+    int x; //!< Column number of the peasant.
+    int y; //!< Row number of the peasant.
+    int readyTurn; //!< First turn in which the peasant can produce again.
+    bool surrounded; //!< True if all neighbouring fields are occupied.
+} Producer;
+
+/// Returns the current time in nanoseconds.
+long long nanoseconds() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+/// Number of values placed in the grid by the check.
+#define CHECK_VALUES 1000
+
+/// Maximum number of values requested by one query of the check.
+#define CHECK_MAX_K 40
+
+/// Number of random operations done by the check on one board.
+const int CHECK_STEPS = 50000;
+
+/// A value placed in the grid by the check.
+typedef struct CheckedValue {
+    int x; //!< Column number of the value.
+    int y; //!< Row number of the value.
+    unsigned long long sequence; //!< Number of insertions before the insertion of the value.
+    bool present; //!< True if the value is in the grid.
+} CheckedValue;
+
+/// Compares results of queries in the order in which spatialGridNearest() returns them.
+int compareNeighbours(const void *a, const void *b) {
+    const SpatialGridNeighbour *first = a, *second = b;
+    if (first->distance != second->distance) {
+        return (first->distance < second->distance) ? -1 : 1;
+    }
+    return (first->item.sequence > second->item.sequence) ? -1 : 1;
+}
+
+/// Returns a random position in [first, first + span).
+int randomPosition(long long first, long long span) {
+    return first + (((long long) rand() << 31) + rand()) % span;
+}
+
+/**
+ * Checks spatialGridNearest() on positions from [first, first + span) in both coordinates.
+ * @return true if all queries returned the same values as a brute-force search.
+ */
+bool checkSpatialGrid(long long first, long long span) {
+    static CheckedValue values[CHECK_VALUES];
+    static SpatialGridNeighbour expected[CHECK_VALUES];
+    SpatialGridNeighbour found[CHECK_MAX_K];
+    unsigned long long insertions = 0;
+    SpatialGrid grid;
+    initSpatialGrid(&grid);
+    memset(values, 0, sizeof(values));
+
+    for (int step = 0; step < CHECK_STEPS; step++) {
+        CheckedValue *value = &values[rand() % CHECK_VALUES];
+        int operation = rand() % 4;
+        if (!value->present) {
+            *value = (CheckedValue) {.x = randomPosition(first, span), .y = randomPosition(first, span),
+                                     .sequence = insertions++, .present = true};
+            spatialGridInsert(&grid, value->x, value->y, value);
+        }
+        else if (operation == 0) {
+            spatialGridRemove(&grid, value->x, value->y, value);
+            value->present = false;
+        }
+        else {
+            // Mostly moves to a neighbouring field, like units do, sometimes jumps anywhere.
+            long long x = value->x + rand() % 3 - 1, y = value->y + rand() % 3 - 1;
+            if (operation == 3) {
+                x = randomPosition(first, span);
+                y = randomPosition(first, span);
+            }
+            x = (x < first) ? first : (x >= first + span) ? first + span - 1 : x;
+            y = (y < first) ? first : (y >= first + span) ? first + span - 1 : y;
+            spatialGridMove(&grid, value->x, value->y, x, y, value);
+            value->x = x;
+            value->y = y;
+        }
+
+        if (step % 7 == 0) {
+            int x = randomPosition(first, span), y = randomPosition(first, span);
+            size_t k = 1 + rand() % CHECK_MAX_K;
+            size_t count = spatialGridNearest(&grid, x, y, k, found);
+            size_t expectedCount = 0;
+            for (int i = 0; i < CHECK_VALUES; i++) {
+                if (values[i].present) {
+                    long long dx = llabs((long long) values[i].x - x), dy = llabs((long long) values[i].y - y);
+                    expected[expectedCount].item.sequence = values[i].sequence;
+                    expected[expectedCount].item.value = &values[i];
+                    expected[expectedCount].distance = (dx > dy) ? dx : dy;
+                    expectedCount++;
+                }
+            }
+            qsort(expected, expectedCount, sizeof(SpatialGridNeighbour), compareNeighbours);
+            if (expectedCount > k) {
+                expectedCount = k;
+            }
+            bool same = (count == expectedCount);
+            for (size_t i = 0; same && i < count; i++) {
+                same = found[i].item.value == expected[i].item.value && found[i].distance == expected[i].distance;
+            }
+            if (!same) {
+                printf("wrong result of query %zu nearest to (%d, %d) in step %d\n", k, x, y, step);
+                freeSpatialGrid(&grid);
+                return false;
+            }
+        }
+    }
+    freeSpatialGrid(&grid);
+    return true;
+}
+
+/// Runs checkSpatialGrid() on dense and sparse boards, and near the end of the int range.
+int checkGrid() {
+    const long long boards[][2] = {{1, 50}, {1, 5000}, {1, 1 << 30}, {INT_MAX - 999, 1000}, {1, INT_MAX}};
+    srand(1);
+    for (size_t i = 0; i < sizeof(boards) / sizeof(boards[0]); i++) {
+        if (!checkSpatialGrid(boards[i][0], boards[i][1])) {
+            return 1;
+        }
+        printf("positions from %lld to %lld: OK\n", boards[i][0], boards[i][0] + boards[i][1] - 1);
+    }
+    return 0;
+}
+
+/// The main function.
+int main(int argc, char **argv) {
+    if (argc > 1 && strcmp(argv[1], "--check-grid") == 0) {
+        return checkGrid();
+    }
+    long long targetUnits = (argc > 1) ? atoll(argv[1]) : 65536;
+    int x1 = BENCHMARK_BOARD_SIZE / 2, y1 = BENCHMARK_BOARD_SIZE / 2;
+
+    startGame();
+    if (init(BENCHMARK_BOARD_SIZE, 1 << 30, 1, x1, y1, 1, 1) != SUCCESS) {
+        endGame();
+        return 1;
+    }
+
+    // Units of the first player: king, peasant and two knights.
+    long long units = 4, commands = 0, reportedUnits = units;
+    long long producerCount = 1, producerCapacity = 1024;
+    Producer *producers = malloc(producerCapacity * sizeof(Producer));
+    producers[0] = (Producer) {.x = x1 + 1, .y = y1, .readyTurn = 3, .surrounded = false};
+
+    printf("%10s %12s %14s\n", "units", "commands", "ns/command");
+    long long start = nanoseconds();
+    for (int turn = 1; units < targetUnits && producerCount > 0; turn++) {
+        long long count = producerCount;
+        for (long long i = 0; i < count && units < targetUnits; i++) {
+            Producer *producer = &producers[i];
+            if (producer->readyTurn > turn) {
+                continue;
+            }
+            bool produced = false;
+            for (int dx = -1; dx <= 1 && !produced; dx++) {
+                for (int dy = -1; dy <= 1 && !produced; dy++) {
+                    if (dx == 0 && dy == 0) {
+                        continue;
+                    }
+                    commands++;
+                    int x = producer->x + dx, y = producer->y + dy;
+                    if (producePeasant(producer->x, producer->y, x, y) == SUCCESS) {
+                        produced = true;
+                        units++;
+                        producer->readyTurn = turn + 3;
+                        if (producerCount == producerCapacity) {
+                            producerCapacity *= 2;
+                            producers = realloc(producers, producerCapacity * sizeof(Producer));
+                            producer = &producers[i];
+                        }
+                        producers[producerCount++] = (Producer) {.x = x, .y = y, .readyTurn = turn + 2,
+                                                                 .surrounded = false};
+                    }
+                }
+            }
+            producer->surrounded = !produced;
+        }
+
+        // Drops peasants surrounded by other units.
+        long long kept = 0;
+        for (long long i = 0; i < producerCount; i++) {
+            if (!producers[i].surrounded) {
+                producers[kept++] = producers[i];
+            }
+        }
+        producerCount = kept;
+
+        commands += 2;
+        endTurn();
+        endTurn();
+
+        if (units >= 2 * reportedUnits || units >= targetUnits) {
+            long long end = nanoseconds();
+            printf("%10lld %12lld %14.1f\n", units, commands, (double) (end - start) / commands);
+            reportedUnits = units;
+            commands = 0;
+            start = nanoseconds();
+        }
+    }
+
+    AllocationStats stats = getAllocationStats();
+    printf("unit records: %lld allocated, %lld released, %lld slabs, "
+           "%.1f allocated per turn (at most %lld)\n",
+           stats.unitAllocations, stats.unitReleases, stats.slabAllocations,
+           (double) stats.unitAllocations / stats.turns, stats.maxTurnAllocations);
+
+    free(producers);
+    endGame();
+    return 0;
+}
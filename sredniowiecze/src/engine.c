@@ -7,6 +7,9 @@
 #include <stdlib.h>
 
 #include "engine.h"
+#include "position_map.h"
+#include "spatial_grid.h"
+#include "unit_kernels.h"
 
 /// Maximum length of a side of the top left corner printed by printTopLeft.
 const int MAX_TOP_LEFT_SIZE = 10;
@@ -16,7 +19,7 @@ typedef enum UnitType {
     PEASANT, KING, KNIGHT
 } UnitType;
 
-/// Stores information about a unit.
+/// Information about a unit, copied out of the UnitStore which holds it.
 typedef struct Unit {
     UnitType type; //!< Type of the unit.
     int x; //!< Number of column in which the unit is currently placed.
@@ -25,13 +28,54 @@ typedef struct Unit {
     int lastAction; //!< Stores in which turn did the unit perform its last action (move or production).
 } Unit;
 
-/// A list of units.
+/// A list of units. Elements are handles of units, which stay valid while units move between slots of their store.
 typedef struct UnitList {
-    Unit unit; //!< The unit which is stored in this element of the list.
+    int player; //!< Which player owns the unit, its data is in game.stores[player - 1].
+    size_t slot; //!< Index of the unit's data in the arrays of its store.
     struct UnitList *next; //!< Pointer to the next unit on the list.
     struct UnitList **prev_next; //!< Pointer to a pointer pointing to this struct.
+    struct UnitList *playerNext; //!< Pointer to the next unit of the same player.
+    struct UnitList **playerPrev_next; //!< Pointer to a pointer pointing to this struct in the player's list.
 } UnitList;
 
+/// Number of unit records in the first slab allocated by the pool.
+const size_t MIN_SLAB_SIZE = 64;
+
+/// Maximum number of unit records in a slab, each slab is twice as big as the previous one up to this size.
+const size_t MAX_SLAB_SIZE = 1 << 16;
+
+/// A block of unit records allocated at once.
+typedef struct UnitSlab {
+    struct UnitSlab *next; //!< The previously allocated slab.
+    size_t size; //!< Number of records in the slab.
+    UnitList units[]; //!< The records.
+} UnitSlab;
+
+/// Allocates unit records in slabs and reuses released records.
+typedef struct UnitPool {
+    UnitSlab *slabs; //!< All allocated slabs, the most recent one first.
+    size_t used; //!< Number of records of the most recent slab which were already handed out.
+    UnitList *released; //!< Released records, linked by their next pointers.
+} UnitPool;
+
+/// Minimum capacity of the arrays of a UnitStore.
+const size_t MIN_STORE_CAPACITY = 16;
+
+/**
+ * Units of one player, each field in a separate array indexed by slots.
+ * Removing a unit moves the unit from the last slot into its slot.
+ */
+typedef struct UnitStore {
+    int *x; //!< Column numbers of the units.
+    int *y; //!< Row numbers of the units.
+    UnitType *type; //!< Types of the units.
+    int *lastAction; //!< Turns in which the units performed their last actions.
+    unsigned long long *sequence; //!< Increases with the time of adding the unit.
+    UnitList **handles; //!< Elements of game.units of the units.
+    size_t size; //!< Number of units in the store.
+    size_t capacity; //!< Size of each of the arrays.
+} UnitStore;
+
 /// Stores information about the currently played game.
 typedef struct Game {
     int boardSize; //!< Size of the board on which the game is played.
@@ -43,6 +87,18 @@ typedef struct Game {
     char *topLeft; //!< A text representation of the top left corner of the board.
     bool initialized; //!< True if INIT was already read.
     UnitList *units; //!< List of units on the board.
+    UnitList *playerUnits[2]; //!< Lists of units of each player (index player - 1), in the order of game.units.
+    int unitCounts[2][3]; //!< Numbers of units of each player (index player - 1) by type.
+    PositionMap positions; //!< Elements of units indexed by positions of their units.
+    SpatialGrid playerGrids[2]; //!< Elements of units of each player (index player - 1) by their positions.
+    SpatialGridNeighbour *neighbours; //!< Buffer for results of nearest enemy queries.
+    size_t neighboursCapacity; //!< Size of the neighbours and distances buffers.
+    UnitPool pool; //!< Records of all units (elements of units).
+    UnitStore stores[2]; //!< Data of units of each player (index player - 1).
+    unsigned long long addedUnits; //!< Number of units added since the start of the game.
+    int *distances; //!< Buffer for distances computed by nearest enemy queries.
+    AllocationStats allocationStats; //!< Counters of allocations from pool.
+    long long turnAllocations; //!< Number of records allocated from pool in the current turn.
 } Game;
 
 /// Stores game data.
@@ -88,33 +144,163 @@ bool isInitialized() {
 void startGame() {
     game.initialized = false;
     game.units = NULL;
+    for (int i = 0; i < 2; i++) {
+        game.playerUnits[i] = NULL;
+        for (int j = 0; j < 3; j++) {
+            game.unitCounts[i][j] = 0;
+        }
+        initSpatialGrid(&game.playerGrids[i]);
+        game.stores[i] = (UnitStore) {.x = NULL, .y = NULL, .type = NULL, .lastAction = NULL,
+                                      .sequence = NULL, .handles = NULL, .size = 0, .capacity = 0};
+    }
+    initPositionMap(&game.positions);
+    game.addedUnits = 0;
+    game.neighbours = NULL;
+    game.distances = NULL;
+    game.neighboursCapacity = 0;
+    game.pool.slabs = NULL;
+    game.pool.used = 0;
+    game.pool.released = NULL;
+    game.allocationStats.unitAllocations = 0;
+    game.allocationStats.unitReleases = 0;
+    game.allocationStats.slabAllocations = 0;
+    game.allocationStats.maxTurnAllocations = 0;
+    game.allocationStats.turns = 1;
+    game.turnAllocations = 0;
     game.currentTurn = 1;
     game.currentPlayer = 1;
 }
 
-/// Frees memory allocated by all elements of a UnitList.
-void freeList(UnitList *unitList) {
-    if (unitList != NULL) {
-        freeList(unitList->next);
-        free(unitList);
+/// Takes a record for a unit from game.pool.
+UnitList *allocateUnit() {
+    UnitPool *pool = &game.pool;
+    UnitList *unit;
+    if (pool->released != NULL) {
+        unit = pool->released;
+        pool->released = unit->next;
+    }
+    else {
+        if (pool->slabs == NULL || pool->used == pool->slabs->size) {
+            size_t size = MIN_SLAB_SIZE;
+            if (pool->slabs != NULL) {
+                size = (2 * pool->slabs->size < MAX_SLAB_SIZE) ? 2 * pool->slabs->size : MAX_SLAB_SIZE;
+            }
+            UnitSlab *slab = malloc(sizeof(UnitSlab) + size * sizeof(UnitList));
+            slab->next = pool->slabs;
+            slab->size = size;
+            pool->slabs = slab;
+            pool->used = 0;
+            game.allocationStats.slabAllocations++;
+        }
+        unit = &pool->slabs->units[pool->used++];
+    }
+
+    game.allocationStats.unitAllocations++;
+    game.turnAllocations++;
+    if (game.turnAllocations > game.allocationStats.maxTurnAllocations) {
+        game.allocationStats.maxTurnAllocations = game.turnAllocations;
+    }
+    return unit;
+}
+
+/// Returns a record of a removed unit to game.pool.
+void releaseUnit(UnitList *unit) {
+    unit->next = game.pool.released;
+    game.pool.released = unit;
+    game.allocationStats.unitReleases++;
+}
+
+/// Frees all slabs of game.pool at once, together with all units still on the board.
+void freeUnitPool() {
+    while (game.pool.slabs != NULL) {
+        UnitSlab *next = game.pool.slabs->next;
+        free(game.pool.slabs);
+        game.pool.slabs = next;
+    }
+    game.pool.used = 0;
+    game.pool.released = NULL;
+    game.units = NULL;
+}
+
+AllocationStats getAllocationStats() {
+    return game.allocationStats;
+}
+
+/// Frees the arrays of a store.
+void freeUnitStore(UnitStore *store) {
+    free(store->x);
+    free(store->y);
+    free(store->type);
+    free(store->lastAction);
+    free(store->sequence);
+    free(store->handles);
+    store->size = 0;
+    store->capacity = 0;
+}
+
+/// Returns the store which holds the data of a unit.
+UnitStore *storeOf(const UnitList *unit) {
+    return &game.stores[unit->player - 1];
+}
+
+/// Returns a copy of the data of a unit.
+Unit getUnit(const UnitList *unit) {
+    const UnitStore *store = storeOf(unit);
+    Unit ret = {.type = store->type[unit->slot], .x = store->x[unit->slot], .y = store->y[unit->slot],
+                .player = unit->player, .lastAction = store->lastAction[unit->slot]};
+    return ret;
+}
+
+/// Appends a unit to a store, enlarging its arrays if needed.
+void pushToStore(UnitStore *store, UnitList *unit, UnitType type, int x, int y) {
+    if (store->size == store->capacity) {
+        store->capacity = (store->capacity == 0) ? MIN_STORE_CAPACITY : 2 * store->capacity;
+        store->x = realloc(store->x, store->capacity * sizeof(int));
+        store->y = realloc(store->y, store->capacity * sizeof(int));
+        store->type = realloc(store->type, store->capacity * sizeof(UnitType));
+        store->lastAction = realloc(store->lastAction, store->capacity * sizeof(int));
+        store->sequence = realloc(store->sequence, store->capacity * sizeof(unsigned long long));
+        store->handles = realloc(store->handles, store->capacity * sizeof(UnitList *));
+    }
+    size_t slot = store->size++;
+    store->x[slot] = x;
+    store->y[slot] = y;
+    store->type[slot] = type;
+    store->lastAction[slot] = game.currentTurn - 1;
+    store->sequence[slot] = game.addedUnits++;
+    store->handles[slot] = unit;
+    unit->slot = slot;
+}
+
+/// Removes a unit from its store, moving the unit from the last slot into its slot.
+void removeFromStore(UnitStore *store, const UnitList *unit) {
+    size_t slot = unit->slot, last = --store->size;
+    if (slot != last) {
+        store->x[slot] = store->x[last];
+        store->y[slot] = store->y[last];
+        store->type[slot] = store->type[last];
+        store->lastAction[slot] = store->lastAction[last];
+        store->sequence[slot] = store->sequence[last];
+        store->handles[slot] = store->handles[last];
+        store->handles[slot]->slot = slot;
     }
 }
 
 void endGame() {
-    freeList(game.units);
+    freeUnitPool();
+    freePositionMap(&game.positions);
+    for (int i = 0; i < 2; i++) {
+        freeSpatialGrid(&game.playerGrids[i]);
+        freeUnitStore(&game.stores[i]);
+    }
+    free(game.neighbours);
+    free(game.distances);
     free(game.topLeft);
 }
 
 /// Returns a UnitList containing the unit at position (x, y).
 UnitList *atPosition(int x, int y) {
-    UnitList *current = game.units;
-    while (current != NULL) {
-        if (current->unit.x == x && current->unit.y == y) {
-            return current;
-        }
-        current = current->next;
-    }
-    return NULL;
+    return positionMapGet(&game.positions, x, y);
 }
 
 void printTopLeft() {
@@ -153,7 +339,7 @@ void setTopLeftChar(int x, int y, UnitType type, int player) {
  * Assumes that the target field is empty, this should be checked before calling addUnit.
  */
 void addUnit(UnitType type, int x, int y, int player) {
-    UnitList *temp = malloc(sizeof(UnitList));
+    UnitList *temp = allocateUnit();
     temp->next = game.units;
     if (temp->next != NULL) {
         temp->next->prev_next = &temp->next;
@@ -161,23 +347,40 @@ void addUnit(UnitType type, int x, int y, int player) {
     game.units = temp;
     temp->prev_next = &game.units;
 
-    temp->unit.type = type;
-    temp->unit.x = x;
-    temp->unit.y = y;
-    temp->unit.player = player;
-    temp->unit.lastAction = game.currentTurn-1;
+    UnitList **playerUnits = &game.playerUnits[player - 1];
+    temp->playerNext = *playerUnits;
+    if (temp->playerNext != NULL) {
+        temp->playerNext->playerPrev_next = &temp->playerNext;
+    }
+    *playerUnits = temp;
+    temp->playerPrev_next = playerUnits;
+    game.unitCounts[player - 1][type]++;
+
+    temp->player = player;
+    pushToStore(&game.stores[player - 1], temp, type, x, y);
+    positionMapSet(&game.positions, x, y, temp);
+    spatialGridInsert(&game.playerGrids[player - 1], x, y, temp);
 
     setTopLeftChar(x, y, type, player);
 }
 
 /// Removes an element from a list.
 void removeUnit(UnitList *unit) {
-    setTopLeftChar(unit->unit.x, unit->unit.y, unit->unit.type, 0);
+    Unit data = getUnit(unit);
+    setTopLeftChar(data.x, data.y, data.type, 0);
+    positionMapRemove(&game.positions, data.x, data.y);
+    spatialGridRemove(&game.playerGrids[data.player - 1], data.x, data.y, unit);
     *(unit->prev_next) = unit->next;
     if (unit->next != NULL) {
         unit->next->prev_next = unit->prev_next;
     }
-    free(unit);
+    *(unit->playerPrev_next) = unit->playerNext;
+    if (unit->playerNext != NULL) {
+        unit->playerNext->playerPrev_next = unit->playerPrev_next;
+    }
+    game.unitCounts[data.player - 1][data.type]--;
+    removeFromStore(storeOf(unit), unit);
+    releaseUnit(unit);
 }
 
 int init(int n, int k, int p, int x1, int y1, int x2, int y2) {
@@ -230,9 +433,12 @@ int move(int x1, int y1, int x2, int y2) {
         return INPUT_ERROR;
     }
     UnitList *unit = atPosition(x1, y1);
-    if (unit == NULL ||
-        unit->unit.player != game.currentPlayer ||
-        unit->unit.lastAction == game.currentTurn ||
+    if (unit == NULL) {
+        return INPUT_ERROR;
+    }
+    Unit first = getUnit(unit);
+    if (first.player != game.currentPlayer ||
+        first.lastAction == game.currentTurn ||
         abs(x2-x1) > 1 || abs(y2-y1) > 1 || (x1 == x2 && y1 == y2) ||
         x2 < 1 || x2 > game.boardSize || y2 < 1 || y2 > game.boardSize) {
 
@@ -240,24 +446,26 @@ int move(int x1, int y1, int x2, int y2) {
     }
 
     UnitList *unit2 = atPosition(x2, y2);
+    Unit second;
     int returnCode = SUCCESS;
     bool unitRemoved = false;
     if (unit2 != NULL) {
-        if (unit->unit.player == unit2->unit.player) {
+        second = getUnit(unit2);
+        if (first.player == second.player) {
             return INPUT_ERROR;
         }
 
-        if (unit->unit.type == unit2->unit.type) {
-            if (unit->unit.type == KING) {
+        if (first.type == second.type) {
+            if (first.type == KING) {
                 returnCode = DRAW;
             }
             removeUnit(unit);
             unitRemoved = true;
             removeUnit(unit2);
         }
-        else if (unit2->unit.type > unit->unit.type) {
-            if (unit->unit.type == KING) {
-                if (unit->unit.player == 1) {
+        else if (second.type > first.type) {
+            if (first.type == KING) {
+                if (first.player == 1) {
                     returnCode = whoWon(2);
                 }
                 else {
@@ -267,9 +475,9 @@ int move(int x1, int y1, int x2, int y2) {
             removeUnit(unit);
             unitRemoved = true;
         }
-        else if (unit->unit.type > unit2->unit.type) {
-            if (unit2->unit.type == KING) {
-                if (unit2->unit.player == 1) {
+        else if (first.type > second.type) {
+            if (second.type == KING) {
+                if (second.player == 1) {
                     returnCode = whoWon(2);
                 }
                 else {
@@ -281,11 +489,15 @@ int move(int x1, int y1, int x2, int y2) {
     }
 
     if (!unitRemoved) {
-        setTopLeftChar(x1, y1, unit->unit.type, 0);
-        unit->unit.x = x2;
-        unit->unit.y = y2;
-        unit->unit.lastAction = game.currentTurn;
-        setTopLeftChar(x2, y2, unit->unit.type, unit->unit.player);
+        setTopLeftChar(x1, y1, first.type, 0);
+        positionMapRemove(&game.positions, x1, y1);
+        UnitStore *store = storeOf(unit);
+        store->x[unit->slot] = x2;
+        store->y[unit->slot] = y2;
+        store->lastAction[unit->slot] = game.currentTurn;
+        positionMapSet(&game.positions, x2, y2, unit);
+        spatialGridMove(&game.playerGrids[first.player - 1], x1, y1, x2, y2, unit);
+        setTopLeftChar(x2, y2, first.type, first.player);
     }
     return returnCode;
 }
@@ -296,11 +508,14 @@ int produceUnit(int x1, int y1, int x2, int y2, UnitType type) {
         return INPUT_ERROR;
     }
     UnitList *unit = atPosition(x1, y1);
-    if (unit == NULL ||
-        unit->unit.player != game.currentPlayer ||
-        unit->unit.lastAction > game.currentTurn - 3 ||
+    if (unit == NULL) {
+        return INPUT_ERROR;
+    }
+    Unit first = getUnit(unit);
+    if (first.player != game.currentPlayer ||
+        first.lastAction > game.currentTurn - 3 ||
         abs(x2-x1) > 1 || abs(y2-y1) > 1 || (x1 == x2 && y1 == y2) ||
-        unit->unit.type != PEASANT ||
+        first.type != PEASANT ||
         x2 < 1 || x2 > game.boardSize || y2 < 1 || y2 > game.boardSize) {
             return INPUT_ERROR;
     }
@@ -310,7 +525,7 @@ int produceUnit(int x1, int y1, int x2, int y2, UnitType type) {
         return INPUT_ERROR;
     }
     addUnit(type, x2, y2, game.currentPlayer);
-    unit->unit.lastAction = game.currentTurn;
+    storeOf(unit)->lastAction[unit->slot] = game.currentTurn;
     return SUCCESS;
 }
 
@@ -332,6 +547,8 @@ int endTurn() {
     else {
         game.currentPlayer = 1;
         game.currentTurn++;
+        game.allocationStats.turns++;
+        game.turnAllocations = 0;
     }
     if (game.currentTurn == game.maxTurns+1) {
         return DRAW;
@@ -356,11 +573,75 @@ typedef struct TurnInfo {
     Unit nearestEnemyUnit; //!< The enemy unit which is the closest to the field.
 } TurnInfo;
 
+/// Maximum number of enemy units for which findNearestEnemies() computes distances to all of them.
+const size_t MAX_SCANNED_ENEMIES = 512;
+
+/// Maximum number of units on the board for which generateTurnInfo() checks all of them for neighbours.
+const size_t MAX_SCANNED_NEIGHBOURS = 64;
+
+/// Makes the neighbours and distances buffers at least size elements long.
+void reserveQueryBuffers(size_t size) {
+    if (size > game.neighboursCapacity) {
+        game.neighboursCapacity = (2 * game.neighboursCapacity > size) ? 2 * game.neighboursCapacity : size;
+        game.neighbours = realloc(game.neighbours, game.neighboursCapacity * sizeof(SpatialGridNeighbour));
+        game.distances = realloc(game.distances, game.neighboursCapacity * sizeof(int));
+    }
+}
+
+/// Same as findNearestEnemies(), but computes the distances to all enemy units at once.
+size_t scanNearestEnemies(const UnitStore *enemies, int x, int y) {
+    reserveQueryBuffers(enemies->size);
+    int nearest = maxMetricDistances(enemies->x, enemies->y, enemies->size, x, y, game.distances);
+    size_t count = 0;
+    for (size_t slot = 0; slot < enemies->size; slot++) {
+        if (game.distances[slot] == nearest) {
+            SpatialGridNeighbour found = {.item = {.x = enemies->x[slot], .y = enemies->y[slot],
+                                                   .sequence = enemies->sequence[slot],
+                                                   .value = enemies->handles[slot]},
+                                          .distance = nearest};
+            // Slots are not in the order of game.units, the most recently added unit goes first.
+            size_t i = count++;
+            while (i > 0 && game.neighbours[i - 1].item.sequence < found.item.sequence) {
+                game.neighbours[i] = game.neighbours[i - 1];
+                i--;
+            }
+            game.neighbours[i] = found;
+        }
+    }
+    return count;
+}
+
+/**
+ * Stores in game.neighbours all enemy units nearest to (x, y) in the maximum metric,
+ * in the order of game.units.
+ * @return The number of found units.
+ */
+size_t findNearestEnemies(int x, int y) {
+    if (game.stores[2 - game.myPlayer].size <= MAX_SCANNED_ENEMIES) {
+        return scanNearestEnemies(&game.stores[2 - game.myPlayer], x, y);
+    }
+    SpatialGrid *enemies = &game.playerGrids[2 - game.myPlayer];
+    /* Usually the nearest unit is unique, so it is enough to find the second nearest one.
+       If all found units are equally close, there may be more of them. */
+    for (size_t k = 2; ; k *= 2) {
+        reserveQueryBuffers(k);
+        size_t found = spatialGridNearest(enemies, x, y, k, game.neighbours);
+        if (found < k || game.neighbours[found - 1].distance > game.neighbours[0].distance) {
+
+            size_t count = 0;
+            while (count < found && game.neighbours[count].distance == game.neighbours[0].distance) {
+                count++;
+            }
+            return count;
+        }
+    }
+}
+
 /// Fills a TurnInfo struct with data about the field passed to this function.
 TurnInfo generateTurnInfo(int x, int y) {
     TurnInfo ret;
 
-    ret.myPeasants = 0;
+    ret.myPeasants = game.unitCounts[game.myPlayer - 1][PEASANT];
 
     for (int i = 0; i < 3; i++) {
         for (int j = 0; j < 3; j++) {
@@ -379,32 +660,45 @@ TurnInfo generateTurnInfo(int x, int y) {
         }
     }
 
-    UnitList *current = game.units;
-    ret.nearestEnemyUnit = current->unit;
-
-    while (current != NULL) {
-        if (abs(current->unit.x - x) <= 1 && abs(current->unit.y - y) <= 1) {
-            ret.nearbyFields[current->unit.x - x + 1][current->unit.y - y + 1] =
-                (game.myPlayer == current->unit.player) ? 1 : 2;
+    // Fields already marked are outside of the board (or the field itself).
+    if (game.stores[0].size + game.stores[1].size <= MAX_SCANNED_NEIGHBOURS) {
+        const UnitStore *mine = &game.stores[game.myPlayer - 1], *enemies = &game.stores[2 - game.myPlayer];
+        unsigned myMask = neighbourhoodMask(mine->x, mine->y, mine->size, x, y);
+        unsigned enemyMask = neighbourhoodMask(enemies->x, enemies->y, enemies->size, x, y);
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 3; j++) {
+                unsigned field = 1u << (3 * i + j);
+                if (ret.nearbyFields[i][j] == 0 && (myMask | enemyMask) & field) {
+                    ret.nearbyFields[i][j] = (myMask & field) ? 1 : 2;
+                }
+            }
         }
-        if (current->unit.player == game.myPlayer && current->unit.type == PEASANT) {
-            ret.myPeasants++;
+    }
+    else {
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 3; j++) {
+                if (ret.nearbyFields[i][j] == 0) {
+                    UnitList *unit = atPosition(x + i - 1, y + j - 1);
+                    if (unit != NULL) {
+                        ret.nearbyFields[i][j] = (game.myPlayer == unit->player) ? 1 : 2;
+                    }
+                }
+            }
         }
-        if (ret.nearestEnemyUnit.player == game.myPlayer
-            && current->unit.player != game.myPlayer) {
+    }
 
-            ret.nearestEnemyUnit = current->unit;
-        }
-        if (game.myPlayer != current->unit.player
-            && max(abs(current->unit.x - x), abs(current->unit.y - y))
-               <= max(abs(ret.nearestEnemyUnit.x - x), abs(ret.nearestEnemyUnit.y - y))
-            && (abs(current->unit.x - x) < abs(ret.nearestEnemyUnit.x - x)
-                || abs(current->unit.y - y) < abs(ret.nearestEnemyUnit.y - y))) {
+    /* Out of the nearest enemy units (in the order of game.units), takes the first one
+       and replaces it with each following one which is nearer along one of the axes. */
+    ret.nearestEnemyUnit = getUnit(game.units);
+    size_t nearestCount = findNearestEnemies(x, y);
+    for (size_t i = 0; i < nearestCount; i++) {
+        Unit current = getUnit(game.neighbours[i].item.value);
+        if (i == 0
+            || abs(current.x - x) < abs(ret.nearestEnemyUnit.x - x)
+            || abs(current.y - y) < abs(ret.nearestEnemyUnit.y - y)) {
 
-            ret.nearestEnemyUnit = current->unit;
+            ret.nearestEnemyUnit = current;
         }
-
-        current = current->next;
     }
 
     return ret;
@@ -428,87 +722,82 @@ int produceAI(int x1, int y1, int x2, int y2, UnitType type) {
 }
 
 int makeTurn() {
-    UnitList *current = game.units;
+    UnitList *current = game.playerUnits[game.myPlayer - 1];
     bool producedUnit = false;
 
     while (current != NULL) {
-        // current->next might later be unavailable if a knight is lost in a fight.
-        UnitList *nextUnit = current->next;
-
-        if (current->unit.player == game.myPlayer) {
-            if (current->unit.lastAction == game.currentTurn) {
-                /* If the loop reached a friendly unit which already make its move,
-                   this must be the second call of makeTurn() in the same turn
-                   and all units after this one were already processed in then
-                   previous call of makeTurn(). */
-                break;
-            }
+        /* current->playerNext might later be unavailable if a knight is lost in a fight.
+           Fights don't remove other friendly units, so nextUnit stays valid. */
+        UnitList *nextUnit = current->playerNext;
+        Unit unit = getUnit(current);
+
+        if (unit.lastAction == game.currentTurn) {
+            /* If the loop reached a friendly unit which already make its move,
+               this must be the second call of makeTurn() in the same turn
+               and all units after this one were already processed in then
+               previous call of makeTurn(). */
+            break;
+        }
 
-            // The value returned later by move() or produceUnit().
-            int ret = -1;
-
-            TurnInfo turnInfo = generateTurnInfo(current->unit.x, current->unit.y);
-            if (current->unit.type == KNIGHT) {
-                int diffX = sgn(turnInfo.nearestEnemyUnit.x - current->unit.x),
-                    diffY = sgn(turnInfo.nearestEnemyUnit.y - current->unit.y);
-                bool moved = false;
-
-                /* Try to make a move where both (i==2) directions (up and left etc.)
-                   match the direction to nearestEnemyUnit. If not possible,
-                   make a move where one (i==1) direction matches and
-                   if that's not possible either, make a move anywhere (i==0). */
-                for (int i = 2; i >= 0 && !moved; i--) {
-                    for (int dx = -1; dx <= 1 && !moved; dx++) {
-                        for (int dy = -1; dy <= 1 && !moved; dy++) {
-                            if ((dx == diffX) + (dy == diffY) == i
-                                && turnInfo.nearbyFields[dx + 1][dy + 1] != 1) {
-
-                                if (nextUnit->unit.x == current->unit.x + dx
-                                    && nextUnit->unit.y == current->unit.y + dy) {
-
-                                    nextUnit = nextUnit->next;
-                                }
-                                ret = moveAI(current->unit.x, current->unit.y,
-                                    current->unit.x + dx, current->unit.y + dy);
-                                moved = true;
-                            }
+        // The value returned later by move() or produceUnit().
+        int ret = -1;
+
+        TurnInfo turnInfo = generateTurnInfo(unit.x, unit.y);
+        if (unit.type == KNIGHT) {
+            int diffX = sgn(turnInfo.nearestEnemyUnit.x - unit.x),
+                diffY = sgn(turnInfo.nearestEnemyUnit.y - unit.y);
+            bool moved = false;
+
+            /* Try to make a move where both (i==2) directions (up and left etc.)
+               match the direction to nearestEnemyUnit. If not possible,
+               make a move where one (i==1) direction matches and
+               if that's not possible either, make a move anywhere (i==0). */
+            for (int i = 2; i >= 0 && !moved; i--) {
+                for (int dx = -1; dx <= 1 && !moved; dx++) {
+                    for (int dy = -1; dy <= 1 && !moved; dy++) {
+                        if ((dx == diffX) + (dy == diffY) == i
+                            && turnInfo.nearbyFields[dx + 1][dy + 1] != 1) {
+
+                            ret = moveAI(unit.x, unit.y,
+                                unit.x + dx, unit.y + dy);
+                            moved = true;
                         }
                     }
                 }
             }
+        }
 
-            else if (current->unit.type == PEASANT
-                     && current->unit.lastAction <= game.currentTurn - 3) {
+        else if (unit.type == PEASANT
+                 && unit.lastAction <= game.currentTurn - 3) {
 
-                UnitType toProduce = KNIGHT;
-                if (turnInfo.myPeasants < 2) {
-                    toProduce = PEASANT;
-                }
-                int diffX = sgn(turnInfo.nearestEnemyUnit.x - current->unit.x),
-                    diffY = sgn(turnInfo.nearestEnemyUnit.y - current->unit.y);
-                bool moved = false;
-
-                // Same as with moving a knight, just producing instead of moving.
-                for (int i = 2; i >= 0 && !moved; i--) {
-                    for (int dx = -1; dx <= 1 && !moved; dx++) {
-                        for (int dy = -1; dy <= 1 && !moved; dy++) {
-                            if ((dx == diffX) + (dy == diffY) == i
-                                && turnInfo.nearbyFields[dx + 1][dy + 1] == 0) {
-
-                                ret = produceAI(current->unit.x, current->unit.y,
-                                    current->unit.x + dx, current->unit.y + dy,
-                                    toProduce);
-                                moved = true;
-                            }
+            UnitType toProduce = KNIGHT;
+            if (turnInfo.myPeasants < 2) {
+                toProduce = PEASANT;
+            }
+            int diffX = sgn(turnInfo.nearestEnemyUnit.x - unit.x),
+                diffY = sgn(turnInfo.nearestEnemyUnit.y - unit.y);
+            bool moved = false;
+
+            // Same as with moving a knight, just producing instead of moving.
+            for (int i = 2; i >= 0 && !moved; i--) {
+                for (int dx = -1; dx <= 1 && !moved; dx++) {
+                    for (int dy = -1; dy <= 1 && !moved; dy++) {
+                        if ((dx == diffX) + (dy == diffY) == i
+                            && turnInfo.nearbyFields[dx + 1][dy + 1] == 0) {
+
+                            ret = produceAI(unit.x, unit.y,
+                                unit.x + dx, unit.y + dy,
+                                toProduce);
+                            moved = true;
                         }
                     }
                 }
             }
+        }
 
-            // The game has ended.
-            if (ret != -1 && ret != SUCCESS) {
-                return ret;
-            }
+        // The game has ended.
+        if (ret != -1 && ret != SUCCESS) {
+            return ret;
         }
         current = nextUnit;
     }
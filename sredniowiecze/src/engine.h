@@ -18,6 +18,15 @@
 /// Return code returned by functions when there is a draw.
 #define DRAW 1
 
+/// Counters of allocations of unit records, collected since startGame().
+typedef struct AllocationStats {
+    long long unitAllocations; //!< Number of records taken for new units.
+    long long unitReleases; //!< Number of records of removed units returned for reuse.
+    long long slabAllocations; //!< Number of blocks of records allocated from the system.
+    long long maxTurnAllocations; //!< The most records taken for new units in a single turn.
+    int turns; //!< Number of turns started so far.
+} AllocationStats;
+
 /**
  * Initializes a game. Needed before first INIT.
  */
@@ -28,6 +37,11 @@ void startGame();
  */
 void endGame();
 
+/**
+ * Returns counters of allocations of unit records.
+ */
+AllocationStats getAllocationStats();
+
 /**
  * Initializes a game with size of a board, number of rounds and positions of kings.
  * @return INPUT_ERROR or SUCCESS
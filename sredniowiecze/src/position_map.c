@@ -0,0 +1,102 @@
+/** @file
+    Implementation of a hash map from board positions to pointers.
+*/
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "position_map.h"
+
+/// Size of the table allocated at the first insertion.
+const size_t MIN_POSITION_MAP_CAPACITY = 16;
+
+/// Returns the index in the table at which searching for (x, y) starts.
+size_t positionHomeIndex(const PositionMap *map, int x, int y) {
+    uint64_t hash = (uint64_t) (uint32_t) x * 0x9E3779B97F4A7C15u
+                    ^ (uint64_t) (uint32_t) y * 0xC2B2AE3D27D4EB4Fu;
+    hash ^= hash >> 32;
+    return hash & (map->capacity - 1);
+}
+
+/// Returns the index of the entry for (x, y) or of the empty entry where it should be inserted.
+size_t positionEntryIndex(const PositionMap *map, int x, int y) {
+    size_t i = positionHomeIndex(map, x, y);
+    while (map->entries[i].value != NULL &&
+           (map->entries[i].x != x || map->entries[i].y != y)) {
+        i = (i + 1) & (map->capacity - 1);
+    }
+    return i;
+}
+
+/// Moves all entries to a table of the given size (a power of two).
+void resizePositionMap(PositionMap *map, size_t capacity) {
+    PositionMapEntry *oldEntries = map->entries;
+    size_t oldCapacity = map->capacity;
+
+    map->entries = calloc(capacity, sizeof(PositionMapEntry));
+    map->capacity = capacity;
+    for (size_t i = 0; i < oldCapacity; i++) {
+        if (oldEntries[i].value != NULL) {
+            map->entries[positionEntryIndex(map, oldEntries[i].x, oldEntries[i].y)] = oldEntries[i];
+        }
+    }
+    free(oldEntries);
+}
+
+void initPositionMap(PositionMap *map) {
+    map->entries = NULL;
+    map->capacity = 0;
+    map->size = 0;
+}
+
+void freePositionMap(PositionMap *map) {
+    free(map->entries);
+    initPositionMap(map);
+}
+
+void *positionMapGet(const PositionMap *map, int x, int y) {
+    if (map->size == 0) {
+        return NULL;
+    }
+    return map->entries[positionEntryIndex(map, x, y)].value;
+}
+
+void positionMapSet(PositionMap *map, int x, int y, void *value) {
+    // Keeping the table at most half full makes probe sequences short.
+    if (2 * (map->size + 1) > map->capacity) {
+        size_t capacity = (map->capacity == 0) ? MIN_POSITION_MAP_CAPACITY : 2 * map->capacity;
+        resizePositionMap(map, capacity);
+    }
+    PositionMapEntry *entry = &map->entries[positionEntryIndex(map, x, y)];
+    if (entry->value == NULL) {
+        map->size++;
+    }
+    entry->x = x;
+    entry->y = y;
+    entry->value = value;
+}
+
+void *positionMapRemove(PositionMap *map, int x, int y) {
+    if (map->size == 0) {
+        return NULL;
+    }
+    size_t mask = map->capacity - 1;
+    size_t hole = positionEntryIndex(map, x, y);
+    void *removed = map->entries[hole].value;
+    if (removed == NULL) {
+        return NULL;
+    }
+    map->size--;
+
+    /* Instead of leaving a tombstone, shift back the following entries
+       whose probe sequences pass through the freed entry. */
+    for (size_t i = (hole + 1) & mask; map->entries[i].value != NULL; i = (i + 1) & mask) {
+        size_t home = positionHomeIndex(map, map->entries[i].x, map->entries[i].y);
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            map->entries[hole] = map->entries[i];
+            hole = i;
+        }
+    }
+    map->entries[hole].value = NULL;
+    return removed;
+}
@@ -0,0 +1,67 @@
+/** @file
+    Interface of a hash map from board positions to pointers.
+*/
+
+#ifndef POSITION_MAP_H
+#define POSITION_MAP_H
+
+#include <stddef.h>
+
+/// An element of the position map's table.
+typedef struct PositionMapEntry {
+    int x; //!< Column number of the position.
+    int y; //!< Row number of the position.
+    void *value; //!< Value stored at the position, NULL if this entry is empty.
+} PositionMapEntry;
+
+/**
+ * Hash map with open addressing (linear probing) from positions (x, y)
+ * to non-NULL pointers. The board is too big for an array of all fields,
+ * so only the occupied ones are stored.
+ */
+typedef struct PositionMap {
+    PositionMapEntry *entries; //!< Table of entries, its size is a power of two.
+    size_t capacity; //!< Size of the table, 0 before the first insertion.
+    size_t size; //!< Number of non-empty entries.
+} PositionMap;
+
+/**
+ * Initializes an empty map. Doesn't allocate memory.
+ * @param[out] map The map to initialize.
+ */
+void initPositionMap(PositionMap *map);
+
+/**
+ * Frees memory used by a map. The map is empty afterwards.
+ * @param[in,out] map The map to free.
+ */
+void freePositionMap(PositionMap *map);
+
+/**
+ * Finds the value stored at a position.
+ * @param[in] map The map to search.
+ * @param[in] x Column number.
+ * @param[in] y Row number.
+ * @return The value stored at (x, y) or NULL if there is none.
+ */
+void *positionMapGet(const PositionMap *map, int x, int y);
+
+/**
+ * Stores a value at a position, replacing the previous one.
+ * @param[in,out] map The map to modify.
+ * @param[in] x Column number.
+ * @param[in] y Row number.
+ * @param[in] value The value to store, can't be NULL.
+ */
+void positionMapSet(PositionMap *map, int x, int y, void *value);
+
+/**
+ * Removes the value stored at a position.
+ * @param[in,out] map The map to modify.
+ * @param[in] x Column number.
+ * @param[in] y Row number.
+ * @return The removed value or NULL if there was none.
+ */
+void *positionMapRemove(PositionMap *map, int x, int y);
+
+#endif /* POSITION_MAP_H */
@@ -0,0 +1,287 @@
+/** @file
+    Implementation of a uniform grid of buckets answering nearest-neighbour
+    queries in the maximum metric.
+*/
+
+#include <limits.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "spatial_grid.h"
+
+/// Length of a side of a bucket (in fields).
+#define BUCKET_SIZE 16
+
+/// Length of a side of a region (in buckets).
+#define REGION_BUCKETS 8
+
+/// Length of a side of a region (in fields).
+#define REGION_SIZE (BUCKET_SIZE * REGION_BUCKETS)
+
+/// Largest region coordinate of a position on the board.
+#define MAX_REGION_COORDINATE ((INT_MAX - 1) / REGION_SIZE)
+
+/// Values placed in one square of BUCKET_SIZE x BUCKET_SIZE fields.
+typedef struct SpatialGridBucket {
+    int x; //!< Bucket coordinate of columns of the bucket.
+    int y; //!< Bucket coordinate of rows of the bucket.
+    size_t regionIndex; //!< Index of the bucket in its region's array.
+    SpatialGridItem *items; //!< Values in the bucket, in no particular order.
+    size_t size; //!< Number of values in the bucket.
+    size_t capacity; //!< Size of the items array.
+} SpatialGridBucket;
+
+/// Non-empty buckets in one square of REGION_BUCKETS x REGION_BUCKETS buckets.
+typedef struct SpatialGridRegion {
+    SpatialGridBucket **buckets; //!< Buckets in the region, in no particular order.
+    size_t size; //!< Number of buckets in the region.
+    size_t capacity; //!< Size of the buckets array.
+} SpatialGridRegion;
+
+/// Returns the bucket coordinate of a column or row number.
+int bucketCoordinate(int position) {
+    return (position - 1) / BUCKET_SIZE;
+}
+
+void initSpatialGrid(SpatialGrid *grid) {
+    initPositionMap(&grid->buckets);
+    initPositionMap(&grid->regions);
+    grid->size = 0;
+    grid->nextSequence = 0;
+}
+
+void freeSpatialGrid(SpatialGrid *grid) {
+    for (size_t i = 0; i < grid->regions.capacity; i++) {
+        SpatialGridRegion *region = grid->regions.entries[i].value;
+        if (region != NULL) {
+            for (size_t j = 0; j < region->size; j++) {
+                free(region->buckets[j]->items);
+                free(region->buckets[j]);
+            }
+            free(region->buckets);
+            free(region);
+        }
+    }
+    freePositionMap(&grid->buckets);
+    freePositionMap(&grid->regions);
+    grid->size = 0;
+}
+
+/// Creates an empty bucket with the given coordinates and adds it to the grid.
+SpatialGridBucket *createBucket(SpatialGrid *grid, int bx, int by) {
+    SpatialGridBucket *bucket = malloc(sizeof(SpatialGridBucket));
+    bucket->x = bx;
+    bucket->y = by;
+    bucket->items = NULL;
+    bucket->size = 0;
+    bucket->capacity = 0;
+    positionMapSet(&grid->buckets, bx, by, bucket);
+
+    int rx = bx / REGION_BUCKETS, ry = by / REGION_BUCKETS;
+    SpatialGridRegion *region = positionMapGet(&grid->regions, rx, ry);
+    if (region == NULL) {
+        region = malloc(sizeof(SpatialGridRegion));
+        region->buckets = NULL;
+        region->size = 0;
+        region->capacity = 0;
+        positionMapSet(&grid->regions, rx, ry, region);
+    }
+    if (region->size == region->capacity) {
+        region->capacity = (region->capacity == 0) ? 4 : 2 * region->capacity;
+        region->buckets = realloc(region->buckets, region->capacity * sizeof(SpatialGridBucket *));
+    }
+    bucket->regionIndex = region->size;
+    region->buckets[region->size++] = bucket;
+    return bucket;
+}
+
+/// Removes an empty bucket from the grid and frees it.
+void deleteBucket(SpatialGrid *grid, SpatialGridBucket *bucket) {
+    int rx = bucket->x / REGION_BUCKETS, ry = bucket->y / REGION_BUCKETS;
+    SpatialGridRegion *region = positionMapGet(&grid->regions, rx, ry);
+    region->buckets[bucket->regionIndex] = region->buckets[--region->size];
+    region->buckets[bucket->regionIndex]->regionIndex = bucket->regionIndex;
+    if (region->size == 0) {
+        positionMapRemove(&grid->regions, rx, ry);
+        free(region->buckets);
+        free(region);
+    }
+    positionMapRemove(&grid->buckets, bucket->x, bucket->y);
+    free(bucket->items);
+    free(bucket);
+}
+
+/// Returns the index of a value in a bucket which contains it.
+size_t itemIndex(const SpatialGridBucket *bucket, void *value) {
+    size_t i = 0;
+    while (bucket->items[i].value != value) {
+        i++;
+    }
+    return i;
+}
+
+/// Adds an item to the bucket containing its position.
+void addToBucket(SpatialGrid *grid, SpatialGridItem item) {
+    int bx = bucketCoordinate(item.x), by = bucketCoordinate(item.y);
+    SpatialGridBucket *bucket = positionMapGet(&grid->buckets, bx, by);
+    if (bucket == NULL) {
+        bucket = createBucket(grid, bx, by);
+    }
+    if (bucket->size == bucket->capacity) {
+        bucket->capacity = (bucket->capacity == 0) ? 4 : 2 * bucket->capacity;
+        bucket->items = realloc(bucket->items, bucket->capacity * sizeof(SpatialGridItem));
+    }
+    bucket->items[bucket->size++] = item;
+    grid->size++;
+}
+
+/// Removes a value placed at (x, y) from its bucket and returns its item.
+SpatialGridItem takeFromBucket(SpatialGrid *grid, int x, int y, void *value) {
+    SpatialGridBucket *bucket = positionMapGet(&grid->buckets, bucketCoordinate(x), bucketCoordinate(y));
+    size_t i = itemIndex(bucket, value);
+    SpatialGridItem item = bucket->items[i];
+    bucket->items[i] = bucket->items[--bucket->size];
+    if (bucket->size == 0) {
+        deleteBucket(grid, bucket);
+    }
+    grid->size--;
+    return item;
+}
+
+void spatialGridInsert(SpatialGrid *grid, int x, int y, void *value) {
+    SpatialGridItem item = {.x = x, .y = y, .sequence = grid->nextSequence++, .value = value};
+    addToBucket(grid, item);
+}
+
+void spatialGridRemove(SpatialGrid *grid, int x, int y, void *value) {
+    takeFromBucket(grid, x, y, value);
+}
+
+void spatialGridMove(SpatialGrid *grid, int x1, int y1, int x2, int y2, void *value) {
+    if (bucketCoordinate(x1) == bucketCoordinate(x2) && bucketCoordinate(y1) == bucketCoordinate(y2)) {
+        SpatialGridBucket *bucket = positionMapGet(&grid->buckets, bucketCoordinate(x1), bucketCoordinate(y1));
+        size_t i = itemIndex(bucket, value);
+        bucket->items[i].x = x2;
+        bucket->items[i].y = y2;
+        return;
+    }
+    SpatialGridItem item = takeFromBucket(grid, x1, y1, value);
+    item.x = x2;
+    item.y = y2;
+    addToBucket(grid, item);
+}
+
+/// Returns true if neighbour a should come before neighbour b in query results.
+bool isCloser(const SpatialGridNeighbour *a, const SpatialGridNeighbour *b) {
+    return a->distance < b->distance
+           || (a->distance == b->distance && a->item.sequence > b->item.sequence);
+}
+
+/// Stores the k nearest of the values seen so far, sorted, in neighbours.
+typedef struct NearestQuery {
+    int x; //!< Column number of the queried position.
+    int y; //!< Row number of the queried position.
+    size_t k; //!< Maximum number of values to find.
+    SpatialGridNeighbour *neighbours; //!< The nearest values seen so far.
+    size_t count; //!< Number of values in neighbours.
+} NearestQuery;
+
+/// Returns the distance from a position to the nearest one in a range of positions.
+long long distanceToRange(long long position, long long first, long long last) {
+    if (position < first) {
+        return first - position;
+    }
+    if (position > last) {
+        return position - last;
+    }
+    return 0;
+}
+
+/// Offers the values of a bucket to a query, unless all of them are too far.
+void offerBucket(NearestQuery *query, const SpatialGridBucket *bucket) {
+    if (query->count == query->k) {
+        long long firstX = (long long) bucket->x * BUCKET_SIZE + 1,
+                  firstY = (long long) bucket->y * BUCKET_SIZE + 1;
+        long long farthest = query->neighbours[query->k - 1].distance;
+        if (distanceToRange(query->x, firstX, firstX + BUCKET_SIZE - 1) > farthest
+            || distanceToRange(query->y, firstY, firstY + BUCKET_SIZE - 1) > farthest) {
+            return;
+        }
+    }
+    for (size_t i = 0; i < bucket->size; i++) {
+        SpatialGridNeighbour candidate = {.item = bucket->items[i]};
+        int dx = abs(candidate.item.x - query->x), dy = abs(candidate.item.y - query->y);
+        candidate.distance = (dx > dy) ? dx : dy;
+        if (query->count == query->k && !isCloser(&candidate, &query->neighbours[query->k - 1])) {
+            continue;
+        }
+        size_t j = (query->count == query->k) ? query->k - 1 : query->count++;
+        while (j > 0 && isCloser(&candidate, &query->neighbours[j - 1])) {
+            query->neighbours[j] = query->neighbours[j - 1];
+            j--;
+        }
+        query->neighbours[j] = candidate;
+    }
+}
+
+/// Offers the buckets of a region to a query.
+void offerRegion(NearestQuery *query, const SpatialGridRegion *region) {
+    for (size_t i = 0; i < region->size; i++) {
+        offerBucket(query, region->buckets[i]);
+    }
+}
+
+/// Offers the buckets of the region with coordinates (rx, ry) to a query if it exists.
+void offerRegionAt(NearestQuery *query, const SpatialGrid *grid, long long rx, long long ry) {
+    if (rx >= 0 && rx <= MAX_REGION_COORDINATE && ry >= 0 && ry <= MAX_REGION_COORDINATE) {
+        SpatialGridRegion *region = positionMapGet(&grid->regions, rx, ry);
+        if (region != NULL) {
+            offerRegion(query, region);
+        }
+    }
+}
+
+size_t spatialGridNearest(const SpatialGrid *grid, int x, int y, size_t k,
+                          SpatialGridNeighbour *neighbours) {
+    NearestQuery query = {.x = x, .y = y, .k = k, .neighbours = neighbours, .count = 0};
+    if (k == 0 || grid->size == 0) {
+        return 0;
+    }
+    long long rx = (x - 1) / REGION_SIZE, ry = (y - 1) / REGION_SIZE;
+    size_t visited = 0;
+
+    /* Searches rings of regions around the region of (x, y). Values in regions
+       outside of the first r rings are at least (r - 1) * REGION_SIZE + 1 away. */
+    for (long long r = 0; ; r++) {
+        if (query.count == grid->size
+            || (query.count == k && query.neighbours[k - 1].distance <= (r - 1) * REGION_SIZE)) {
+            break;
+        }
+        size_t ringSize = (r == 0) ? 1 : 8 * r;
+        if (visited + ringSize > grid->regions.size) {
+            // The values are far apart, so it is cheaper to check all of them.
+            query.count = 0;
+            for (size_t i = 0; i < grid->regions.capacity; i++) {
+                if (grid->regions.entries[i].value != NULL) {
+                    offerRegion(&query, grid->regions.entries[i].value);
+                }
+            }
+            break;
+        }
+        visited += ringSize;
+
+        if (r == 0) {
+            offerRegionAt(&query, grid, rx, ry);
+            continue;
+        }
+        for (long long i = -r; i <= r; i++) {
+            offerRegionAt(&query, grid, rx + i, ry - r);
+            offerRegionAt(&query, grid, rx + i, ry + r);
+        }
+        for (long long i = -r + 1; i <= r - 1; i++) {
+            offerRegionAt(&query, grid, rx - r, ry + i);
+            offerRegionAt(&query, grid, rx + r, ry + i);
+        }
+    }
+    return query.count;
+}
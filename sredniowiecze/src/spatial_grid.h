@@ -0,0 +1,95 @@
+/** @file
+    Interface of a uniform grid of buckets answering nearest-neighbour queries
+    in the maximum metric.
+*/
+
+#ifndef SPATIAL_GRID_H
+#define SPATIAL_GRID_H
+
+#include <stddef.h>
+
+#include "position_map.h"
+
+/// A value stored in the grid.
+typedef struct SpatialGridItem {
+    int x; //!< Column number of the value's position.
+    int y; //!< Row number of the value's position.
+    unsigned long long sequence; //!< Increases with the time of insertion, kept by moves.
+    void *value; //!< The stored value.
+} SpatialGridItem;
+
+/// A result of a nearest-neighbour query.
+typedef struct SpatialGridNeighbour {
+    SpatialGridItem item; //!< The found value with its position.
+    int distance; //!< Distance in the maximum metric from the queried position.
+} SpatialGridNeighbour;
+
+/**
+ * Values placed on the board, grouped into square buckets, which are grouped
+ * into bigger square regions. Only non-empty buckets and regions are stored,
+ * in maps indexed by their coordinates, so the grid works for boards of any size.
+ */
+typedef struct SpatialGrid {
+    PositionMap buckets; //!< Non-empty buckets (SpatialGridBucket) by bucket coordinates.
+    PositionMap regions; //!< Non-empty regions (SpatialGridRegion) by region coordinates.
+    size_t size; //!< Number of values in the grid.
+    unsigned long long nextSequence; //!< Sequence number of the next inserted value.
+} SpatialGrid;
+
+/**
+ * Initializes an empty grid. Doesn't allocate memory.
+ * @param[out] grid The grid to initialize.
+ */
+void initSpatialGrid(SpatialGrid *grid);
+
+/**
+ * Frees memory used by a grid. The grid is empty afterwards.
+ * @param[in,out] grid The grid to free.
+ */
+void freeSpatialGrid(SpatialGrid *grid);
+
+/**
+ * Inserts a value placed at (x, y).
+ * @param[in,out] grid The grid to modify.
+ * @param[in] x Column number, at least 1.
+ * @param[in] y Row number, at least 1.
+ * @param[in] value The value to insert, not in the grid yet.
+ */
+void spatialGridInsert(SpatialGrid *grid, int x, int y, void *value);
+
+/**
+ * Removes a value placed at (x, y).
+ * @param[in,out] grid The grid to modify.
+ * @param[in] x Column number of the value's position.
+ * @param[in] y Row number of the value's position.
+ * @param[in] value The value to remove.
+ */
+void spatialGridRemove(SpatialGrid *grid, int x, int y, void *value);
+
+/**
+ * Moves a value from (x1, y1) to (x2, y2). It keeps its place in the order
+ * of insertion.
+ * @param[in,out] grid The grid to modify.
+ * @param[in] x1 Column number before the move.
+ * @param[in] y1 Row number before the move.
+ * @param[in] x2 Column number after the move, at least 1.
+ * @param[in] y2 Row number after the move, at least 1.
+ * @param[in] value The value to move.
+ */
+void spatialGridMove(SpatialGrid *grid, int x1, int y1, int x2, int y2, void *value);
+
+/**
+ * Finds values nearest to (x, y) in the maximum metric.
+ * Equally distant values are ordered from the most recently inserted one.
+ * @param[in] grid The grid to search.
+ * @param[in] x Column number.
+ * @param[in] y Row number.
+ * @param[in] k Maximum number of values to find.
+ * @param[out] neighbours Array of at least k elements for the found values,
+ *                        sorted from the nearest one.
+ * @return The number of found values, min(k, number of values in the grid).
+ */
+size_t spatialGridNearest(const SpatialGrid *grid, int x, int y, size_t k,
+                          SpatialGridNeighbour *neighbours);
+
+#endif /* SPATIAL_GRID_H */
@@ -0,0 +1,186 @@
+/** @file
+    Implementation of vectorized computations on arrays of unit positions.
+*/
+
+#include <limits.h>
+#include <stddef.h>
+
+#include "unit_kernels.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+/// Defined if SSE4.1 and AVX2 versions of the kernels are compiled.
+#define UNIT_KERNELS_X86
+#include <immintrin.h>
+#endif
+
+/// Type of the versions of maxMetricDistances().
+typedef int (*DistancesKernel)(const int *xs, const int *ys, size_t count, int x, int y, int *distances);
+
+/// Type of the versions of neighbourhoodMask().
+typedef unsigned (*MaskKernel)(const int *xs, const int *ys, size_t count, int x, int y);
+
+/// Version of maxMetricDistances() used by this processor, NULL before the first call.
+DistancesKernel distancesKernel = NULL;
+
+/// Version of neighbourhoodMask() used by this processor, NULL before the first call.
+MaskKernel maskKernel = NULL;
+
+/// Returns the distance in the maximum metric between (x1, y1) and (x2, y2).
+int maxMetricDistance(int x1, int y1, int x2, int y2) {
+    int dx = (x1 > x2) ? x1 - x2 : x2 - x1;
+    int dy = (y1 > y2) ? y1 - y2 : y2 - y1;
+    return (dx > dy) ? dx : dy;
+}
+
+/// Returns the bit of a neighbourhood mask for a position, 0 if it is outside of the 3x3 square.
+unsigned neighbourhoodBit(int x, int y, int centerX, int centerY) {
+    if (maxMetricDistance(x, y, centerX, centerY) > 1) {
+        return 0;
+    }
+    return 1u << (3 * (x - centerX + 1) + (y - centerY + 1));
+}
+
+/// Scalar version of maxMetricDistances().
+int scalarMaxMetricDistances(const int *xs, const int *ys, size_t count, int x, int y, int *distances) {
+    int nearest = -1;
+    for (size_t i = 0; i < count; i++) {
+        distances[i] = maxMetricDistance(xs[i], ys[i], x, y);
+        if (nearest < 0 || distances[i] < nearest) {
+            nearest = distances[i];
+        }
+    }
+    return nearest;
+}
+
+/// Scalar version of neighbourhoodMask().
+unsigned scalarNeighbourhoodMask(const int *xs, const int *ys, size_t count, int x, int y) {
+    unsigned mask = 0;
+    for (size_t i = 0; i < count; i++) {
+        mask |= neighbourhoodBit(xs[i], ys[i], x, y);
+    }
+    return mask;
+}
+
+/// Returns the smaller of the nearest distance found by a vectorized loop (INT_MAX if none) and by the scalar tail.
+int combineNearest(int vectorNearest, int tailNearest) {
+    if (tailNearest >= 0 && tailNearest < vectorNearest) {
+        return tailNearest;
+    }
+    return (vectorNearest == INT_MAX) ? -1 : vectorNearest;
+}
+
+#ifdef UNIT_KERNELS_X86
+
+/// SSE4.1 version of maxMetricDistances().
+__attribute__((target("sse4.1")))
+int sseMaxMetricDistances(const int *xs, const int *ys, size_t count, int x, int y, int *distances) {
+    __m128i pointX = _mm_set1_epi32(x), pointY = _mm_set1_epi32(y);
+    __m128i nearest = _mm_set1_epi32(INT_MAX);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i dx = _mm_abs_epi32(_mm_sub_epi32(_mm_loadu_si128((const __m128i *) (xs + i)), pointX));
+        __m128i dy = _mm_abs_epi32(_mm_sub_epi32(_mm_loadu_si128((const __m128i *) (ys + i)), pointY));
+        __m128i distance = _mm_max_epi32(dx, dy);
+        _mm_storeu_si128((__m128i *) (distances + i), distance);
+        nearest = _mm_min_epi32(nearest, distance);
+    }
+    nearest = _mm_min_epi32(nearest, _mm_shuffle_epi32(nearest, _MM_SHUFFLE(1, 0, 3, 2)));
+    nearest = _mm_min_epi32(nearest, _mm_shuffle_epi32(nearest, _MM_SHUFFLE(2, 3, 0, 1)));
+    return combineNearest(_mm_cvtsi128_si32(nearest),
+                          scalarMaxMetricDistances(xs + i, ys + i, count - i, x, y, distances + i));
+}
+
+/// SSE4.1 version of neighbourhoodMask().
+__attribute__((target("sse4.1")))
+unsigned sseNeighbourhoodMask(const int *xs, const int *ys, size_t count, int x, int y) {
+    __m128i pointX = _mm_set1_epi32(x), pointY = _mm_set1_epi32(y), two = _mm_set1_epi32(2);
+    unsigned mask = 0;
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i dx = _mm_abs_epi32(_mm_sub_epi32(_mm_loadu_si128((const __m128i *) (xs + i)), pointX));
+        __m128i dy = _mm_abs_epi32(_mm_sub_epi32(_mm_loadu_si128((const __m128i *) (ys + i)), pointY));
+        __m128i near = _mm_and_si128(_mm_cmpgt_epi32(two, dx), _mm_cmpgt_epi32(two, dy));
+        // Positions in the square are rare, so they are handled one by one.
+        int lanes = _mm_movemask_ps(_mm_castsi128_ps(near));
+        while (lanes != 0) {
+            size_t j = i + __builtin_ctz(lanes);
+            mask |= neighbourhoodBit(xs[j], ys[j], x, y);
+            lanes &= lanes - 1;
+        }
+    }
+    return mask | scalarNeighbourhoodMask(xs + i, ys + i, count - i, x, y);
+}
+
+/// AVX2 version of maxMetricDistances().
+__attribute__((target("avx2")))
+int avx2MaxMetricDistances(const int *xs, const int *ys, size_t count, int x, int y, int *distances) {
+    __m256i pointX = _mm256_set1_epi32(x), pointY = _mm256_set1_epi32(y);
+    __m256i nearest = _mm256_set1_epi32(INT_MAX);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i dx = _mm256_abs_epi32(_mm256_sub_epi32(_mm256_loadu_si256((const __m256i *) (xs + i)), pointX));
+        __m256i dy = _mm256_abs_epi32(_mm256_sub_epi32(_mm256_loadu_si256((const __m256i *) (ys + i)), pointY));
+        __m256i distance = _mm256_max_epi32(dx, dy);
+        _mm256_storeu_si256((__m256i *) (distances + i), distance);
+        nearest = _mm256_min_epi32(nearest, distance);
+    }
+    __m128i half = _mm_min_epi32(_mm256_castsi256_si128(nearest), _mm256_extracti128_si256(nearest, 1));
+    half = _mm_min_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(1, 0, 3, 2)));
+    half = _mm_min_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(2, 3, 0, 1)));
+    return combineNearest(_mm_cvtsi128_si32(half),
+                          scalarMaxMetricDistances(xs + i, ys + i, count - i, x, y, distances + i));
+}
+
+/// AVX2 version of neighbourhoodMask().
+__attribute__((target("avx2")))
+unsigned avx2NeighbourhoodMask(const int *xs, const int *ys, size_t count, int x, int y) {
+    __m256i pointX = _mm256_set1_epi32(x), pointY = _mm256_set1_epi32(y), two = _mm256_set1_epi32(2);
+    unsigned mask = 0;
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i dx = _mm256_abs_epi32(_mm256_sub_epi32(_mm256_loadu_si256((const __m256i *) (xs + i)), pointX));
+        __m256i dy = _mm256_abs_epi32(_mm256_sub_epi32(_mm256_loadu_si256((const __m256i *) (ys + i)), pointY));
+        __m256i near = _mm256_and_si256(_mm256_cmpgt_epi32(two, dx), _mm256_cmpgt_epi32(two, dy));
+        // Positions in the square are rare, so they are handled one by one.
+        int lanes = _mm256_movemask_ps(_mm256_castsi256_ps(near));
+        while (lanes != 0) {
+            size_t j = i + __builtin_ctz(lanes);
+            mask |= neighbourhoodBit(xs[j], ys[j], x, y);
+            lanes &= lanes - 1;
+        }
+    }
+    return mask | scalarNeighbourhoodMask(xs + i, ys + i, count - i, x, y);
+}
+
+#endif /* UNIT_KERNELS_X86 */
+
+/// Chooses the versions of the kernels supported by this processor.
+void chooseKernels() {
+    distancesKernel = scalarMaxMetricDistances;
+    maskKernel = scalarNeighbourhoodMask;
+#ifdef UNIT_KERNELS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        distancesKernel = avx2MaxMetricDistances;
+        maskKernel = avx2NeighbourhoodMask;
+    }
+    else if (__builtin_cpu_supports("sse4.1")) {
+        distancesKernel = sseMaxMetricDistances;
+        maskKernel = sseNeighbourhoodMask;
+    }
+#endif
+}
+
+int maxMetricDistances(const int *xs, const int *ys, size_t count, int x, int y, int *distances) {
+    if (distancesKernel == NULL) {
+        chooseKernels();
+    }
+    return distancesKernel(xs, ys, count, x, y, distances);
+}
+
+unsigned neighbourhoodMask(const int *xs, const int *ys, size_t count, int x, int y) {
+    if (maskKernel == NULL) {
+        chooseKernels();
+    }
+    return maskKernel(xs, ys, count, x, y);
+}
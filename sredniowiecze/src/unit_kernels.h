@@ -0,0 +1,38 @@
+/** @file
+    Interface of vectorized computations on arrays of unit positions.
+
+    Each function has SSE4.1 and AVX2 versions on x86 processors, chosen at
+    the first call depending on what the processor supports, and a scalar
+    version used everywhere else.
+*/
+
+#ifndef UNIT_KERNELS_H
+#define UNIT_KERNELS_H
+
+#include <stddef.h>
+
+/**
+ * Computes distances in the maximum metric from (x, y) to each of the given positions.
+ * @param[in] xs Column numbers of the positions (at least 1).
+ * @param[in] ys Row numbers of the positions (at least 1).
+ * @param[in] count Number of the positions.
+ * @param[in] x Column number of the point (at least 1).
+ * @param[in] y Row number of the point (at least 1).
+ * @param[out] distances Array of count elements for the distances.
+ * @return The smallest of the distances or -1 if count is 0.
+ */
+int maxMetricDistances(const int *xs, const int *ys, size_t count, int x, int y, int *distances);
+
+/**
+ * Finds which fields of the 3x3 square centered at (x, y) contain one of the given positions.
+ * @param[in] xs Column numbers of the positions (at least 1).
+ * @param[in] ys Row numbers of the positions (at least 1).
+ * @param[in] count Number of the positions.
+ * @param[in] x Column number of the center (at least 1).
+ * @param[in] y Row number of the center (at least 1).
+ * @return A mask in which bit 3 * (dx + 1) + (dy + 1) is set if (x + dx, y + dy) is
+ *         one of the positions (for dx, dy from -1 to 1).
+ */
+unsigned neighbourhoodMask(const int *xs, const int *ys, size_t count, int x, int y);
+
+#endif /* UNIT_KERNELS_H */
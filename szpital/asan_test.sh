@@ -0,0 +1,41 @@
+#!/bin/bash
+# Testy regresji uruchamiane na programie zbudowanym z AddressSanitizerem
+# (make asan-test). Użycie: ./asan_test.sh PROGRAM
+
+prog=$(realpath "$1")
+directory=$(mktemp -d)
+trap 'rm -rf "$directory"' EXIT
+failures=0
+
+# Sprawdza, czy polecenia z pliku $2 dają odpowiedzi z pliku $3 (pozostałe argumenty to opcje).
+check() {
+   local name=$1 input=$2 expected=$3
+   shift 3
+   if "$prog" "$@" < "$input" > "$directory/out" 2> "$directory/err" && cmp -s "$directory/out" "$expected"; then
+      echo "$name: OK"
+   else
+      echo "$name: FAILED"
+      head -n 20 "$directory/err"
+      failures=$((failures + 1))
+   fi
+}
+
+# Zapisuje do pliku $1 opis długości $2 bajtów złożony ze znaku x.
+longDescription() {
+   head -c "$2" /dev/zero | tr '\0' x > "$1"
+}
+
+# Rekord dziennika dłuższy niż jego bufor (1 MiB) i odtworzenie go przy następnym uruchomieniu.
+longDescription "$directory/description" $((3 << 20))
+{ printf 'NEW_DISEASE_ENTER_DESCRIPTION a '; cat "$directory/description"; echo; } > "$directory/wal.in"
+echo OK > "$directory/wal.out"
+check "long write-ahead log record" "$directory/wal.in" "$directory/wal.out" --wal "$directory/log"
+echo 'PRINT_DESCRIPTION a 1' > "$directory/replay.in"
+{ cat "$directory/description"; echo; } > "$directory/replay.out"
+check "long write-ahead log record replay" "$directory/replay.in" "$directory/replay.out" --wal "$directory/log"
+
+if [[ $failures -gt 0 ]]; then
+   echo "$failures tests failed."
+   exit 1
+fi
+echo "All tests passed."
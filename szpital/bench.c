@@ -0,0 +1,146 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+#include "command.h"
+#include "output.h"
+#include "parse.h"
+#include "stats.h"
+#include "structure.h"
+
+/* Program mierzący wydajność struktury danych programu hospital.
+ * Wykonuje po kolei polecenia z pliku podanego w argumencie (np. wygenerowanego
+ * programem generate), tak jak hospital bez opcji -p, wypisując ich wyniki
+ * do /dev/null. Na standardowe wyjście wypisuje przepustowość, percentyle
+ * czasu wykonania poleceń (łącznie i dla każdego rodzaju polecenia) oraz
+ * największe zużycie pamięci przez proces.
+ *
+ * Użycie: bench [-i] [--compress] [--binary] PLIK (opcje jak w hospital). */
+
+// Czasy wykonania poleceń jednego rodzaju w nanosekundach.
+typedef struct Latencies {
+   uint64_t *values;
+   size_t count, capacity;
+} Latencies;
+
+static void addLatency(Latencies *latencies, uint64_t value) {
+   if (latencies->count == latencies->capacity) {
+      latencies->capacity = (latencies->capacity == 0) ? 1024 : 2 * latencies->capacity;
+      latencies->values = realloc(latencies->values, latencies->capacity * sizeof(uint64_t));
+   }
+   latencies->values[latencies->count++] = value;
+}
+
+static int compareLatencies(const void *a, const void *b) {
+   uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+   return (x > y) - (x < y);
+}
+
+// Zwraca percentyl (w tysięcznych) z posortowanych czasów.
+static uint64_t percentile(Latencies *latencies, int permille) {
+   size_t index = latencies->count * permille / 1000;
+   if (index >= latencies->count) {
+      index = latencies->count - 1;
+   }
+   return latencies->values[index];
+}
+
+static void printLatencies(FILE *report, const char *label, Latencies *latencies) {
+   if (latencies->count == 0) {
+      return;
+   }
+   qsort(latencies->values, latencies->count, sizeof(uint64_t), compareLatencies);
+   fprintf(report, "%-30s %10zu %10llu %10llu %10llu %10llu\n", label, latencies->count,
+           (unsigned long long) percentile(latencies, 500), (unsigned long long) percentile(latencies, 990),
+           (unsigned long long) percentile(latencies, 999),
+           (unsigned long long) latencies->values[latencies->count - 1]);
+}
+
+static uint64_t now() {
+   struct timespec time;
+   clock_gettime(CLOCK_MONOTONIC, &time);
+   return (uint64_t) time.tv_sec * 1000000000 + time.tv_nsec;
+}
+
+int main(int argc, char **argv) {
+   DatabaseOptions options = {.internDescriptions = false, .shards = 1, .compressDescriptions = false,
+                              .dictionarySamples = DEFAULT_DICTIONARY_SAMPLES};
+   const char *path = NULL;
+   bool binary = false;
+   for (int i = 1; i < argc; i++) {
+      if (strcmp("-i", argv[i]) == 0) {
+         options.internDescriptions = true;
+      }
+      else if (strcmp("--compress", argv[i]) == 0) {
+         options.compressDescriptions = true;
+      }
+      else if (strcmp("--binary", argv[i]) == 0) {
+         binary = true;
+      }
+      else {
+         path = argv[i];
+      }
+   }
+   int input = (path == NULL) ? -1 : open(path, O_RDONLY);
+   if (input < 0) {
+      fprintf(stderr, "usage: %s [-i] [--compress] [--binary] WORKLOAD\n", argv[0]);
+      return 1;
+   }
+
+   // Wyniki poleceń trafiają do /dev/null, a raport na pierwotne standardowe wyjście.
+   FILE *report = fdopen(dup(STDOUT_FILENO), "w");
+   int null = open("/dev/null", O_WRONLY);
+   dup2(null, STDOUT_FILENO);
+   close(null);
+
+   initializeOutput(DEFAULT_OUTPUT_BUFFER_SIZE);
+   Database *database = initializeDatabase(&options);
+   Reader *reader = createReader(input);
+   if (binary) {
+      readerUseBinaryProtocol(reader);
+      outputBinaryReplies(standardOutput, true);
+   }
+   ParsedInput parsed;
+   Latencies all = {NULL, 0, 0};
+   Latencies functions[FUNCTION_TYPES];
+   memset(functions, 0, sizeof(functions));
+
+   uint64_t start = now();
+   while (parseLine(reader, &parsed)) {
+      uint64_t begin = now();
+      executeCommand(&parsed, database, standardOutput, false);
+      uint64_t latency = now() - begin;
+      addLatency(&all, latency);
+      addLatency(&functions[parsed.function], latency);
+   }
+   outputFlush(standardOutput);
+   double seconds = (now() - start) / 1e9;
+
+   struct rusage usage;
+   getrusage(RUSAGE_SELF, &usage);
+   fprintf(report, "commands: %zu\n", all.count);
+   fprintf(report, "time: %.3f s\n", seconds);
+   fprintf(report, "throughput: %.0f ops/s\n", (seconds > 0) ? all.count / seconds : 0);
+   fprintf(report, "peak RSS: %ld KiB\n", usage.ru_maxrss);
+   fprintf(report, "%-30s %10s %10s %10s %10s %10s\n", "latency [ns]", "count", "p50", "p99", "p999", "max");
+   printLatencies(report, "all", &all);
+   for (int i = 0; i < FUNCTION_TYPES; i++) {
+      printLatencies(report, FUNCTION_NAMES[i], &functions[i]);
+      free(functions[i].values);
+   }
+   free(all.values);
+   fclose(report);
+
+   deleteReader(reader);
+   close(input);
+   deleteDatabase(database);
+   deleteOutput();
+   deleteCommandCounters();
+   return 0;
+}
@@ -0,0 +1,234 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "blob.h"
+
+// Rozmiar segmentu pliku. Dłuższe napisy (z nagłówkiem) nie są zapisywane w magazynie.
+#define SEGMENT_SIZE (64 << 20)
+
+// Brak segmentu (np. gdy nic nie jest kompaktowane).
+#define NO_SEGMENT SIZE_MAX
+
+/* Przy dopisaniu napisu zajmującego size bajtów kompaktowanie przegląda
+ * COMPACTION_FACTOR * size bajtów kompaktowanego segmentu (żywych jest w nim
+ * mniej niż połowa), więc zdąży go opróżnić, zanim zapełni się bieżący segment. */
+#define COMPACTION_FACTOR 2
+
+// Nagłówek napisu w pliku. Po usunięciu napisu owner jest równy NULL.
+typedef struct BlobHeader {
+   void *owner;
+   uint64_t length;
+} BlobHeader;
+
+typedef struct Segment {
+   char *data; // Mapowanie segmentu w pamięci.
+   size_t used; // Rozmiar zapisanej części segmentu.
+   size_t live; // Rozmiar żywych napisów (z nagłówkami).
+} Segment;
+
+struct BlobStore {
+   int fd;
+   MoveFunction move;
+   Segment *segments;
+   size_t segmentCount, segmentCapacity;
+   size_t *freeSegments; // Opróżnione segmenty do ponownego użycia.
+   size_t freeCount;
+   size_t active; // Segment, do którego dopisujemy napisy.
+   size_t compacted; // Kompaktowany segment i pozycja pierwszego nieprzeniesionego napisu.
+   size_t cursor;
+   size_t liveBytes;
+};
+
+// Zwraca rozmiar napisu o długości length w pliku (z nagłówkiem i wyrównaniem).
+static size_t recordSize(size_t length) {
+   return sizeof(BlobHeader) + (length + 7) / 8 * 8;
+}
+
+static BlobHeader *headerAt(BlobStore *store, uint64_t offset) {
+   return (BlobHeader *) (store->segments[offset / SEGMENT_SIZE].data + offset % SEGMENT_SIZE) - 1;
+}
+
+// Dodaje segment na koniec pliku. Zwraca NO_SEGMENT, jeżeli zabrakło miejsca.
+static size_t growFile(BlobStore *store) {
+   off_t offset = (off_t) store->segmentCount * SEGMENT_SIZE;
+   // Rezerwujemy miejsce od razu, żeby zapis przez mapowanie nie zawiódł (SIGBUS).
+   if (posix_fallocate(store->fd, offset, SEGMENT_SIZE) != 0) {
+      return NO_SEGMENT;
+   }
+   void *data = mmap(NULL, SEGMENT_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, store->fd, offset);
+   if (data == MAP_FAILED) {
+      return NO_SEGMENT;
+   }
+   if (store->segmentCount == store->segmentCapacity) {
+      store->segmentCapacity = (store->segmentCapacity == 0) ? 4 : 2 * store->segmentCapacity;
+      store->segments = realloc(store->segments, store->segmentCapacity * sizeof(Segment));
+      store->freeSegments = realloc(store->freeSegments, store->segmentCapacity * sizeof(size_t));
+   }
+   Segment *segment = &store->segments[store->segmentCount];
+   segment->data = data;
+   segment->used = 0;
+   segment->live = 0;
+   return store->segmentCount++;
+}
+
+// Oznacza pusty segment jako wolny.
+static void releaseSegment(BlobStore *store, size_t number) {
+   store->segments[number].used = 0;
+   store->segments[number].live = 0;
+   store->freeSegments[store->freeCount++] = number;
+   if (store->compacted == number) {
+      store->compacted = NO_SEGMENT;
+   }
+}
+
+/* Wybiera do kompaktowania segment, w którym zostało mniej niż pół żywych danych
+ * (jeżeli żaden nie jest kompaktowany). */
+static void chooseCompacted(BlobStore *store) {
+   for (size_t i = 0; store->compacted == NO_SEGMENT && i < store->segmentCount; i++) {
+      Segment *segment = &store->segments[i];
+      if (i != store->active && segment->used > 0 && 2 * segment->live < segment->used) {
+         store->compacted = i;
+         store->cursor = 0;
+      }
+   }
+}
+
+/* Zapewnia, że w bieżącym segmencie jest size wolnych bajtów, zaczynając
+ * w razie potrzeby nowy segment. Zwraca false, jeżeli zabrakło miejsca. */
+static bool reserve(BlobStore *store, size_t size) {
+   if (store->active != NO_SEGMENT && store->segments[store->active].used + size <= SEGMENT_SIZE) {
+      return true;
+   }
+   size_t segment = (store->freeCount > 0) ? store->freeSegments[--store->freeCount] : growFile(store);
+   if (segment == NO_SEGMENT) {
+      return false;
+   }
+   size_t previous = store->active;
+   store->active = segment;
+   // Napisy poprzedniego segmentu mogły zostać usunięte, gdy był bieżący.
+   if (previous != NO_SEGMENT && store->segments[previous].live == 0) {
+      releaseSegment(store, previous);
+   }
+   chooseCompacted(store);
+   return true;
+}
+
+// Zapisuje napis w bieżącym segmencie (w którym jest na niego miejsce) i zwraca jego adres.
+static uint64_t writeRecord(BlobStore *store, const char *data, size_t length, void *owner) {
+   Segment *segment = &store->segments[store->active];
+   BlobHeader *header = (BlobHeader *) (segment->data + segment->used);
+   header->owner = owner;
+   header->length = length;
+   memcpy(header + 1, data, length);
+   uint64_t offset = (uint64_t) store->active * SEGMENT_SIZE + segment->used + sizeof(BlobHeader);
+   segment->used += recordSize(length);
+   segment->live += recordSize(length);
+   return offset;
+}
+
+/* Przegląda około budget bajtów kompaktowanego segmentu (albo do jego końca),
+ * przenosząc jego żywe napisy do bieżącego segmentu. Usunięte napisy też
+ * zużywają budżet, więc jedno wywołanie nie przegląda całego segmentu. */
+static void compact(BlobStore *store, size_t budget) {
+   while (store->compacted != NO_SEGMENT && budget > 0) {
+      Segment *segment = &store->segments[store->compacted];
+      // Segment bez żywych napisów jest zwalniany bez przeglądania reszty.
+      if (store->cursor >= segment->used || segment->live == 0) {
+         releaseSegment(store, store->compacted);
+         chooseCompacted(store);
+         continue;
+      }
+      BlobHeader *header = (BlobHeader *) (segment->data + store->cursor);
+      size_t size = recordSize(header->length);
+      if (header->owner != NULL) {
+         if (!reserve(store, size)) {
+            return;
+         }
+         // reserve mogło powiększyć tablicę segmentów.
+         segment = &store->segments[store->compacted];
+         header = (BlobHeader *) (segment->data + store->cursor);
+         uint64_t offset = writeRecord(store, (const char *) (header + 1), header->length, header->owner);
+         store->move(header->owner, offset);
+         header->owner = NULL;
+         segment->live -= size;
+      }
+      budget = (budget > size) ? budget - size : 0;
+      store->cursor += size;
+   }
+}
+
+BlobStore *openBlobStore(const char *path, MoveFunction move) {
+   int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+   if (fd < 0) {
+      return NULL;
+   }
+   unlink(path);
+   BlobStore *store = malloc(sizeof(BlobStore));
+   store->fd = fd;
+   store->move = move;
+   store->segments = NULL;
+   store->segmentCount = 0;
+   store->segmentCapacity = 0;
+   store->freeSegments = NULL;
+   store->freeCount = 0;
+   store->active = NO_SEGMENT;
+   store->compacted = NO_SEGMENT;
+   store->cursor = 0;
+   store->liveBytes = 0;
+   return store;
+}
+
+void closeBlobStore(BlobStore *store) {
+   for (size_t i = 0; i < store->segmentCount; i++) {
+      munmap(store->segments[i].data, SEGMENT_SIZE);
+   }
+   close(store->fd);
+   free(store->segments);
+   free(store->freeSegments);
+   free(store);
+}
+
+uint64_t blobAppend(BlobStore *store, const char *data, size_t length, void *owner) {
+   size_t size = recordSize(length);
+   if (size > SEGMENT_SIZE) {
+      return NO_BLOB;
+   }
+   compact(store, COMPACTION_FACTOR * size);
+   if (!reserve(store, size)) {
+      return NO_BLOB;
+   }
+   store->liveBytes += length;
+   return writeRecord(store, data, length, owner);
+}
+
+const char *blobData(BlobStore *store, uint64_t offset) {
+   return store->segments[offset / SEGMENT_SIZE].data + offset % SEGMENT_SIZE;
+}
+
+void blobFree(BlobStore *store, uint64_t offset) {
+   BlobHeader *header = headerAt(store, offset);
+   size_t number = offset / SEGMENT_SIZE;
+   Segment *segment = &store->segments[number];
+   header->owner = NULL;
+   segment->live -= recordSize(header->length);
+   store->liveBytes -= header->length;
+   if (number == store->active) {
+      return;
+   }
+   if (segment->live == 0) {
+      releaseSegment(store, number);
+   }
+   else if (store->compacted == NO_SEGMENT && 2 * segment->live < segment->used) {
+      store->compacted = number;
+      store->cursor = 0;
+   }
+}
+
+size_t blobLiveBytes(BlobStore *store) {
+   return store->liveBytes;
+}
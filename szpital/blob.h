@@ -0,0 +1,47 @@
+#ifndef BLOB_H
+#define BLOB_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Magazyn dużych napisów w pliku tymczasowym. Napisy są dopisywane na koniec
+ * bieżącego segmentu pliku i odczytywane przez mapowanie pliku do pamięci,
+ * więc w pamięci zostają tylko strony, do których program się odwołuje
+ * (resztę system może w każdej chwili zrzucić do pliku).
+ *
+ * Miejsce po usuniętych napisach jest odzyskiwane stopniowo: gdy w segmencie
+ * zostanie mniej niż połowa żywych danych, przy każdym dopisaniu kilka jego
+ * napisów jest przenoszonych na koniec bieżącego segmentu (o czym informuje
+ * MoveFunction), a opróżniony segment jest używany ponownie. */
+typedef struct BlobStore BlobStore;
+
+// Wartość zwracana przez blobAppend, gdy napisu nie udało się zapisać.
+#define NO_BLOB UINT64_MAX
+
+// Wywoływana, gdy napis właściciela owner zostanie przeniesiony pod adres offset.
+typedef void (*MoveFunction)(void *owner, uint64_t offset);
+
+/* Tworzy pusty magazyn w pliku path (plik jest od razu usuwany z katalogu,
+ * więc znika po zakończeniu programu). Zwraca NULL, jeżeli nie udało się
+ * utworzyć pliku. */
+BlobStore *openBlobStore(const char *path, MoveFunction move);
+
+// Zwalnia magazyn i jego plik.
+void closeBlobStore(BlobStore *store);
+
+/* Zapisuje length bajtów z data jako napis właściciela owner. Zwraca adres
+ * napisu albo NO_BLOB, jeżeli napis nie mieści się w segmencie pliku
+ * albo zabrakło miejsca na dysku. Może przenieść inne
+ * napisy, więc wskaźniki zwrócone wcześniej przez blobData tracą ważność. */
+uint64_t blobAppend(BlobStore *store, const char *data, size_t length, void *owner);
+
+// Zwraca wskaźnik na napis o adresie offset (ważny do następnego blobAppend).
+const char *blobData(BlobStore *store, uint64_t offset);
+
+// Usuwa napis o adresie offset.
+void blobFree(BlobStore *store, uint64_t offset);
+
+// Zwraca łączną długość napisów w magazynie.
+size_t blobLiveBytes(BlobStore *store);
+
+#endif // BLOB_H
@@ -0,0 +1,205 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "bulk.h"
+#include "command.h"
+#include "parse.h"
+#include "stats.h"
+
+// Największa długość fragmentu pliku parsowanego przez jeden wątek naraz.
+#define CHUNK_SIZE (16 << 20)
+
+/* Liczba fragmentów na wątek, które mogą czekać sparsowane na wykonanie
+ * (ogranicza pamięć zajmowaną przez polecenia, gdy parsowanie wyprzedza wykonywanie). */
+#define CHUNKS_AHEAD 2
+
+/* Fragment pliku i jego polecenia. Argumenty poleceń wskazują
+ * na zmapowany plik, więc są ważne do końca bulkLoad. */
+typedef struct Chunk {
+   const char *begin, *end;
+   ParsedInput *commands;
+   size_t count;
+   bool parsed;
+} Chunk;
+
+typedef struct BulkLoad {
+   Chunk *chunks;
+   size_t chunkCount;
+   // Pola poniżej są zmieniane pod blokadą mutex.
+   size_t next; // Pierwszy fragment, którego nie zaczął parsować żaden wątek.
+   size_t executed; // Liczba wykonanych fragmentów.
+   size_t window; // Największa liczba fragmentów sparsowanych, ale niewykonanych.
+   pthread_mutex_t mutex;
+   pthread_cond_t parsedCondition, executedCondition;
+} BulkLoad;
+
+// Parsuje wiersze fragmentu chunk (pomijając wiersze niezawierające poprawnego polecenia).
+static void parseChunk(Chunk *chunk) {
+   size_t capacity = 0;
+   const char *line = chunk->begin;
+   while (line < chunk->end) {
+      const char *newline = memchr(line, '\n', chunk->end - line);
+      const char *lineEnd = (newline == NULL) ? chunk->end : newline;
+      if (chunk->count == capacity) {
+         capacity = (capacity == 0) ? 1024 : 2 * capacity;
+         chunk->commands = realloc(chunk->commands, capacity * sizeof(ParsedInput));
+      }
+      uint64_t start = startTiming(ParsePhase);
+      if (parseCommand(line, lineEnd - line, &chunk->commands[chunk->count])) {
+         chunk->count++;
+      }
+      stopTiming(ParsePhase, start);
+      line = lineEnd + 1;
+   }
+}
+
+static void *parseChunks(void *argument) {
+   BulkLoad *load = argument;
+   pthread_mutex_lock(&load->mutex);
+   while (load->next < load->chunkCount) {
+      if (load->next >= load->executed + load->window) {
+         pthread_cond_wait(&load->executedCondition, &load->mutex);
+         continue;
+      }
+      Chunk *chunk = &load->chunks[load->next++];
+      pthread_mutex_unlock(&load->mutex);
+      parseChunk(chunk);
+      pthread_mutex_lock(&load->mutex);
+      chunk->parsed = true;
+      pthread_cond_broadcast(&load->parsedCondition);
+   }
+   pthread_mutex_unlock(&load->mutex);
+   return NULL;
+}
+
+/* Wykonuje polecenie bez wypisywania odpowiedzi. Zwraca false,
+ * jeżeli odpowiedzią byłoby IGNORED. */
+static bool applyCommand(ParsedInput *input, Database *database) {
+   switch (input->function) {
+      case NewDiseaseEnterDescription:
+         return newDiseaseEnterDescription(input->atr1, input->atr2, database) == OkStatus;
+      case NewDiseaseCopyDescription:
+         return newDiseaseCopyDescription(input->atr1, input->atr2, database) == OkStatus;
+      case ChangeDescription:
+         return changeDescription(input->atr1, input->n, input->atr2, database) == OkStatus;
+      case DeletePatientData:
+         return deletePatientData(input->atr1, database) == OkStatus;
+      case SaveSnapshot:
+         return snapshotDatabase(input->atr1, database) == OkStatus;
+      default:
+         return true;
+   }
+}
+
+static void executeChunk(Chunk *chunk, Database *database, Output *output, bool debug) {
+   for (size_t i = 0; i < chunk->count; i++) {
+      ParsedInput *input = &chunk->commands[i];
+      if (output == NULL && (input->function == PrintDescription || input->function == PrintStats)) {
+         continue;
+      }
+      uint64_t start = startTiming(ExecutePhase);
+      bool applied = (output == NULL) ? applyCommand(input, database)
+                                      : executeCommand(input, database, output, debug);
+      stopTiming(ExecutePhase, start);
+      if (!applied && databaseFailure(database) != NULL) {
+         exitOnFailure(database);
+      }
+      countCommand(input->function, applied);
+   }
+}
+
+/* Dzieli size bajtów data na fragmenty kończące się znakiem nowej linii
+ * (poza ostatnim), nie dłuższe niż chunkSize, chyba że zawierają dłuższy wiersz. */
+static size_t splitChunks(const char *data, size_t size, size_t chunkSize, Chunk **chunks) {
+   size_t count = 0, capacity = size / chunkSize + 1;
+   *chunks = calloc(capacity, sizeof(Chunk));
+   const char *begin = data, *end = data + size;
+   while (begin < end) {
+      const char *split = end;
+      if ((size_t) (end - begin) > chunkSize) {
+         const char *newline = memchr(begin + chunkSize - 1, '\n', end - (begin + chunkSize - 1));
+         split = (newline == NULL) ? end : newline + 1;
+      }
+      if (count == capacity) {
+         capacity *= 2;
+         *chunks = realloc(*chunks, capacity * sizeof(Chunk));
+      }
+      (*chunks)[count++] = (Chunk) {.begin = begin, .end = split, .commands = NULL, .count = 0,
+                                    .parsed = false};
+      begin = split;
+   }
+   return count;
+}
+
+bool bulkLoad(const char *path, Database *database, size_t threads, Output *output, bool debug) {
+   int fd = open(path, O_RDONLY);
+   if (fd < 0) {
+      return false;
+   }
+   struct stat status;
+   if (fstat(fd, &status) != 0) {
+      close(fd);
+      return false;
+   }
+   size_t size = status.st_size;
+   if (size == 0) {
+      close(fd);
+      return true;
+   }
+   char *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+   close(fd);
+   if (data == MAP_FAILED) {
+      return false;
+   }
+   posix_madvise(data, size, POSIX_MADV_SEQUENTIAL);
+
+   // Małe pliki też dzielimy między wszystkie wątki.
+   size_t chunkSize = size / threads + 1;
+   if (chunkSize > CHUNK_SIZE) {
+      chunkSize = CHUNK_SIZE;
+   }
+   BulkLoad load = {.next = 0, .executed = 0, .window = CHUNKS_AHEAD * threads};
+   load.chunkCount = splitChunks(data, size, chunkSize, &load.chunks);
+   pthread_mutex_init(&load.mutex, NULL);
+   pthread_cond_init(&load.parsedCondition, NULL);
+   pthread_cond_init(&load.executedCondition, NULL);
+   pthread_t *parsers = malloc(threads * sizeof(pthread_t));
+   for (size_t i = 0; i < threads; i++) {
+      pthread_create(&parsers[i], NULL, parseChunks, &load);
+   }
+
+   for (size_t i = 0; i < load.chunkCount; i++) {
+      Chunk *chunk = &load.chunks[i];
+      pthread_mutex_lock(&load.mutex);
+      while (!chunk->parsed) {
+         pthread_cond_wait(&load.parsedCondition, &load.mutex);
+      }
+      pthread_mutex_unlock(&load.mutex);
+
+      executeChunk(chunk, database, output, debug);
+      free(chunk->commands);
+      chunk->commands = NULL;
+
+      pthread_mutex_lock(&load.mutex);
+      load.executed++;
+      pthread_cond_broadcast(&load.executedCondition);
+      pthread_mutex_unlock(&load.mutex);
+   }
+
+   for (size_t i = 0; i < threads; i++) {
+      pthread_join(parsers[i], NULL);
+   }
+   free(parsers);
+   pthread_mutex_destroy(&load.mutex);
+   pthread_cond_destroy(&load.parsedCondition);
+   pthread_cond_destroy(&load.executedCondition);
+   free(load.chunks);
+   munmap(data, size);
+   return true;
+}
@@ -0,0 +1,25 @@
+#ifndef BULK_H
+#define BULK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "output.h"
+#include "structure.h"
+
+// Największa liczba wątków parsujących w bulkLoad.
+#define MAX_BULK_THREADS 256
+
+/* Wykonuje na database polecenia z pliku path w protokole tekstowym.
+ * Plik jest mapowany do pamięci i dzielony na fragmenty na granicach wierszy,
+ * które parsuje równolegle threads wątków. Polecenia wykonuje po kolei wątek
+ * wywołujący, w kolejności z pliku (każdy fragment zaraz po sparsowaniu), więc
+ * stan database jest taki sam, jak po wczytaniu pliku ze standardowego wejścia.
+ *
+ * Jeżeli output nie jest NULL, wypisuje do niego odpowiedzi na polecenia
+ * (a przy debug liczbę opisów na stderr jak executeCommand). W przeciwnym
+ * przypadku pomija polecenia, które tylko wypisują (PRINT_DESCRIPTION i STATS).
+ * Struktura nie może być podzielona na części. Zwraca false, jeżeli pliku
+ * nie da się wczytać (wtedy niczego nie wykonuje). */
+bool bulkLoad(const char *path, Database *database, size_t threads, Output *output, bool debug);
+
+#endif // BULK_H
@@ -0,0 +1,135 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "command.h"
+#include "memory.h"
+#include "stats.h"
+
+static const char *OK_MESSAGE = "OK";
+static const char *IGNORED_MESSAGE = "IGNORED";
+
+// Rozmiar bufora raportu (raport ma stałą liczbę krótkich wierszy).
+#define REPORT_SIZE 4096
+
+typedef struct Report {
+   char data[REPORT_SIZE];
+   size_t length;
+} Report;
+
+void exitOnFailure(Database *database) {
+   fprintf(stderr, "ERROR: %s\n", databaseFailure(database));
+   exit(1);
+}
+
+void printAcknowledgement(Output *output, bool applied) {
+   const char *message = applied ? OK_MESSAGE : IGNORED_MESSAGE;
+   outputReply(output, applied ? OkReply : IgnoredReply, message, strlen(message));
+}
+
+bool executeCommand(ParsedInput *input, Database *database, Output *output, bool debug) {
+   CommandStatus status = OkStatus;
+   StringView description;
+   DatabaseStatistics statistics;
+   switch (input->function) {
+      case NewDiseaseEnterDescription:
+         status = newDiseaseEnterDescription(input->atr1, input->atr2, database);
+         break;
+      case NewDiseaseCopyDescription:
+         status = newDiseaseCopyDescription(input->atr1, input->atr2, database);
+         break;
+      case ChangeDescription:
+         status = changeDescription(input->atr1, input->n, input->atr2, database);
+         break;
+      case PrintDescription:
+         status = getDescription(input->atr1, input->n, database, &description);
+         break;
+      case DeletePatientData:
+         status = deletePatientData(input->atr1, database);
+         break;
+      case SaveSnapshot:
+         status = snapshotDatabase(input->atr1, database);
+         break;
+      case PrintStats:
+         break;
+   }
+   if (status == FailedStatus && databaseFailure(database) != NULL) {
+      exitOnFailure(database);
+   }
+
+   if (input->function == PrintStats) {
+      collectStatistics(database, &statistics);
+      printStatisticsReport(output, &statistics);
+   }
+   else if (input->function == PrintDescription && status == OkStatus) {
+      outputReply(output, DescriptionReply, description.data, description.length);
+   }
+   else {
+      // Nieudany zapis migawki też jest zgłaszany jako IGNORED.
+      printAcknowledgement(output, status == OkStatus);
+   }
+   if (debug) {
+      outputNumberLine(errorOutput, "DESCRIPTIONS: ", countDescriptions(database));
+   }
+   return status == OkStatus;
+}
+
+// Dopisuje do raportu wiersz sformatowany jak w printf.
+static void reportLine(Report *report, const char *format, ...) {
+   va_list arguments;
+   va_start(arguments, format);
+   int length = vsnprintf(report->data + report->length, REPORT_SIZE - report->length, format, arguments);
+   va_end(arguments);
+   if (length > 0 && (size_t) length < REPORT_SIZE - report->length - 1) {
+      report->length += length;
+      report->data[report->length++] = '\n';
+   }
+}
+
+static double ratio(uint64_t numerator, uint64_t denominator) {
+   return (denominator == 0) ? 0.0 : (double) numerator / denominator;
+}
+
+void printStatisticsReport(Output *output, const DatabaseStatistics *statistics) {
+   CommandCounters counters;
+   sumCommandCounters(&counters);
+   Report report = {.length = 0};
+   for (int i = 0; i < FUNCTION_TYPES; i++) {
+      reportLine(&report, "%s: %llu (OK: %llu, IGNORED: %llu)", FUNCTION_NAMES[i],
+                 (unsigned long long) counters.commands[i],
+                 (unsigned long long) (counters.commands[i] - counters.ignored[i]),
+                 (unsigned long long) counters.ignored[i]);
+   }
+   reportLine(&report, "PATIENTS: %zu", statistics->patients);
+   reportLine(&report, "DESCRIPTIONS: %d", statistics->descriptions);
+   reportLine(&report, "DESCRIPTION BYTES: %zu", statistics->descriptionBytes);
+   reportLine(&report, "SHARED DESCRIPTION BYTES: %zu", statistics->sharedBytes);
+   reportLine(&report, "SPILLED DESCRIPTION BYTES: %zu", statistics->spilledBytes);
+   reportLine(&report, "AVERAGE HISTORY LENGTH: %.2f", ratio(statistics->historyEntries, statistics->patients));
+   reportLine(&report, "COMPRESSION RATIO: %.2f",
+              ratio(statistics->compressedTextBytes, statistics->compressedBytes));
+   reportLine(&report, "PARSE TIME [us]: %llu", (unsigned long long) counters.time[ParsePhase] / 1000);
+   reportLine(&report, "EXECUTE TIME [us]: %llu", (unsigned long long) counters.time[ExecutePhase] / 1000);
+   reportLine(&report, "OUTPUT TIME [us]: %llu", (unsigned long long) counters.time[OutputPhase] / 1000);
+   reportLine(&report, "DECOMPRESSIONS: %llu", (unsigned long long) counters.runs[DecompressPhase]);
+   reportLine(&report, "AVERAGE DECOMPRESSION TIME [ns]: %.2f",
+              ratio(counters.time[DecompressPhase], counters.runs[DecompressPhase]));
+   outputReply(output, ReportReply, report.data, report.length);
+}
+
+void printStatistics(Database *database) {
+   DatabaseStatistics statistics;
+   collectStatistics(database, &statistics);
+   outputNumberLine(errorOutput, "PATIENTS: ", statistics.patients);
+   outputNumberLine(errorOutput, "DESCRIPTIONS: ", statistics.descriptions);
+   if (statistics.interning) {
+      outputNumberLine(errorOutput, "INTERNED DESCRIPTIONS: ", statistics.internedDescriptions);
+      outputNumberLine(errorOutput, "INTERN HITS: ", statistics.internHits);
+      outputNumberLine(errorOutput, "INTERN SAVED BYTES: ", statistics.internSavedBytes);
+   }
+   outputNumberLine(errorOutput, "SYSTEM ALLOCATIONS: ", memoryStatistics.systemAllocations);
+   outputNumberLine(errorOutput, "SYSTEM FREES: ", memoryStatistics.systemFrees);
+   outputNumberLine(errorOutput, "POOL ALLOCATIONS: ", memoryStatistics.poolAllocations);
+   outputNumberLine(errorOutput, "POOL FREES: ", memoryStatistics.poolFrees);
+   outputNumberLine(errorOutput, "ARENA ALLOCATIONS: ", memoryStatistics.arenaAllocations);
+}
@@ -0,0 +1,34 @@
+#ifndef COMMAND_H
+#define COMMAND_H
+
+#include <stdbool.h>
+#include "output.h"
+#include "parse.h"
+#include "structure.h"
+
+/* Odpowiedzi programu hospital na polecenia: warstwa nad funkcjami
+ * z structure.h, które tylko zwracają wyniki. */
+
+/* Wykonuje polecenie input na database i wypisuje odpowiedź do output,
+ * a jeżeli debug == true, liczbę opisów na stderr. Zwraca false,
+ * jeżeli polecenie zostało zignorowane (wypisało IGNORED). Po błędzie
+ * struktury kończy program (patrz exitOnFailure). */
+bool executeCommand(ParsedInput *input, Database *database, Output *output, bool debug);
+
+/* Kończy program po błędzie struktury database (patrz databaseFailure), wypisując
+ * jego opis na stderr. Niewypisane odpowiedzi są pomijane, bo polecenia mogły
+ * nie zostać zapisane trwale. */
+void exitOnFailure(Database *database);
+
+// Wypisuje do output odpowiedź OK (jeżeli applied) albo IGNORED.
+void printAcknowledgement(Output *output, bool applied);
+
+/* Wypisuje do output raport polecenia STATS: liczniki poleceń wszystkich
+ * wątków (patrz stats.h) i statystyki struktury danych statistics. */
+void printStatisticsReport(Output *output, const DatabaseStatistics *statistics);
+
+/* Wypisuje na standardowe wyjście diagnostyczne statystyki struktury danych
+ * (m.in. liczbę pacjentów, opisów i pamięć zaoszczędzoną przez internowanie). */
+void printStatistics(Database *database);
+
+#endif // COMMAND_H
@@ -0,0 +1,317 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "compress.h"
+
+// Najkrótsze zapisywane odwołanie (krótsze nie opłaca się zapisywać).
+#define MIN_MATCH 4
+
+// Największy rozmiar słownika.
+#define DICTIONARY_SIZE (32 << 10)
+
+// Największa łączna długość próbek (dalsze próbki są pomijane).
+#define SAMPLE_LIMIT (1 << 20)
+
+/* Słownik jest budowany z fragmentów próbek o długości FRAGMENT_LENGTH,
+ * ocenianych sumą częstości występowania w próbkach ich podsłów
+ * o długości KMER_LENGTH. */
+#define FRAGMENT_LENGTH 64
+#define KMER_LENGTH 8
+
+// Liczby bitów skrótów: pozycji w słowniku, pozycji w napisie i podsłów przy budowie słownika.
+#define DICTIONARY_HASH_BITS 15
+#define TEXT_HASH_BITS 13
+#define KMER_HASH_BITS 16
+
+// Zapas w buforze wyniku na liczby jednej sekwencji.
+#define SEQUENCE_OVERHEAD 32
+
+struct Compressor {
+   size_t samples; // Liczba próbek, których brakuje do zbudowania słownika.
+   char *sampleData; // Zebrane próbki (sklejone).
+   size_t sampleLength, sampleCapacity;
+   bool trained;
+   char *dictionary;
+   size_t dictionaryLength;
+   // Pozycja (plus 1) ostatniego wystąpienia w słowniku początku o danym skrócie.
+   uint32_t *dictionaryTable;
+   /* Pozycja (plus base) ostatniego wystąpienia w kompresowanym napisie początku
+    * o danym skrócie. Wpisy mniejsze niż base pochodzą z poprzednich napisów,
+    * więc tablicy nie trzeba czyścić przed każdym napisem. */
+   uint32_t *textTable;
+   uint32_t base;
+   char *output;
+   size_t outputCapacity;
+};
+
+// Zwraca skrót (o bits bitach) czterech bajtów od data.
+static uint32_t hashFour(const char *data, int bits) {
+   uint32_t value;
+   memcpy(&value, data, sizeof(value));
+   return (value * 2654435761u) >> (32 - bits);
+}
+
+// Zwraca skrót (o bits bitach) KMER_LENGTH bajtów od data.
+static uint32_t hashKmer(const char *data, int bits) {
+   uint64_t value;
+   memcpy(&value, data, sizeof(value));
+   return (value * 0x9E3779B97F4A7C15ull) >> (64 - bits);
+}
+
+static size_t matchLength(const char *a, const char *b, size_t limit) {
+   size_t length = 0;
+   while (length < limit && a[length] == b[length]) {
+      length++;
+   }
+   return length;
+}
+
+// Zapisuje value pod adres output (po 7 bitów na bajt). Zwraca liczbę zapisanych bajtów.
+static size_t writeNumber(char *output, size_t value) {
+   size_t length = 0;
+   while (value >= 0x80) {
+      output[length++] = (char) (value | 0x80);
+      value >>= 7;
+   }
+   output[length++] = (char) value;
+   return length;
+}
+
+// Odczytuje liczbę zapisaną przez writeNumber i przesuwa *input za nią.
+static size_t readNumber(const char **input) {
+   size_t value = 0;
+   int shift = 0;
+   unsigned char byte;
+   do {
+      byte = (unsigned char) *(*input)++;
+      value |= (size_t) (byte & 0x7F) << shift;
+      shift += 7;
+   } while (byte & 0x80);
+   return value;
+}
+
+// Zwraca sumę częstości podsłów zaczynających się we fragmencie od pozycji start.
+static uint64_t fragmentScore(Compressor *compressor, const uint32_t *frequencies, size_t start) {
+   uint64_t score = 0;
+   for (size_t i = start; i < start + FRAGMENT_LENGTH && i + KMER_LENGTH <= compressor->sampleLength; i++) {
+      score += frequencies[hashKmer(compressor->sampleData + i, KMER_HASH_BITS)];
+   }
+   return score;
+}
+
+typedef struct Fragment {
+   size_t start;
+   uint64_t score;
+} Fragment;
+
+static int compareFragments(const void *a, const void *b) {
+   uint64_t x = ((const Fragment *) a)->score, y = ((const Fragment *) b)->score;
+   return (x < y) - (x > y);
+}
+
+/* Wybiera do słownika fragmenty próbek od najwyżej ocenionych. Po wybraniu
+ * fragmentu jego podsłowa przestają się liczyć, więc fragment, który głównie
+ * powtarza już wybrane, straci ponad połowę oceny i zostanie pominięty.
+ * Najlepsze fragmenty trafiają na koniec słownika, najbliżej kompresowanego
+ * napisu, żeby odległości odwołań do nich były najkrótsze. */
+static void selectFragments(Compressor *compressor) {
+   uint32_t *frequencies = calloc((size_t) 1 << KMER_HASH_BITS, sizeof(uint32_t));
+   for (size_t i = 0; i + KMER_LENGTH <= compressor->sampleLength; i++) {
+      frequencies[hashKmer(compressor->sampleData + i, KMER_HASH_BITS)]++;
+   }
+   size_t count = compressor->sampleLength / FRAGMENT_LENGTH;
+   Fragment *fragments = malloc(count * sizeof(Fragment));
+   for (size_t i = 0; i < count; i++) {
+      fragments[i].start = i * FRAGMENT_LENGTH;
+      fragments[i].score = fragmentScore(compressor, frequencies, fragments[i].start);
+   }
+   qsort(fragments, count, sizeof(Fragment), compareFragments);
+
+   compressor->dictionary = malloc(DICTIONARY_SIZE);
+   size_t remaining = DICTIONARY_SIZE;
+   for (size_t i = 0; i < count && remaining >= FRAGMENT_LENGTH; i++) {
+      const char *fragment = compressor->sampleData + fragments[i].start;
+      uint64_t score = fragmentScore(compressor, frequencies, fragments[i].start);
+      if (score == 0 || 2 * score < fragments[i].score) {
+         continue;
+      }
+      remaining -= FRAGMENT_LENGTH;
+      memcpy(compressor->dictionary + remaining, fragment, FRAGMENT_LENGTH);
+      for (size_t j = 0; j + KMER_LENGTH <= FRAGMENT_LENGTH; j++) {
+         frequencies[hashKmer(fragment + j, KMER_HASH_BITS)] = 0;
+      }
+   }
+   compressor->dictionaryLength = DICTIONARY_SIZE - remaining;
+   memmove(compressor->dictionary, compressor->dictionary + remaining, compressor->dictionaryLength);
+   free(fragments);
+   free(frequencies);
+}
+
+// Buduje słownik z zebranych próbek (jeżeli są krótkie, słownikiem są one całe).
+static void buildDictionary(Compressor *compressor) {
+   if (compressor->sampleLength <= DICTIONARY_SIZE) {
+      compressor->dictionary = compressor->sampleData;
+      compressor->dictionaryLength = compressor->sampleLength;
+      compressor->sampleData = NULL;
+   }
+   else {
+      selectFragments(compressor);
+   }
+   free(compressor->sampleData);
+   compressor->sampleData = NULL;
+
+   compressor->dictionaryTable = calloc((size_t) 1 << DICTIONARY_HASH_BITS, sizeof(uint32_t));
+   for (size_t i = 0; i + MIN_MATCH <= compressor->dictionaryLength; i++) {
+      compressor->dictionaryTable[hashFour(compressor->dictionary + i, DICTIONARY_HASH_BITS)] = i + 1;
+   }
+   compressor->trained = true;
+}
+
+static void addSample(Compressor *compressor, StringView text) {
+   if (compressor->sampleLength + text.length <= SAMPLE_LIMIT) {
+      if (compressor->sampleLength + text.length > compressor->sampleCapacity) {
+         while (compressor->sampleLength + text.length > compressor->sampleCapacity) {
+            compressor->sampleCapacity = (compressor->sampleCapacity == 0) ? 4096 : 2 * compressor->sampleCapacity;
+         }
+         compressor->sampleData = realloc(compressor->sampleData, compressor->sampleCapacity);
+      }
+      memcpy(compressor->sampleData + compressor->sampleLength, text.data, text.length);
+      compressor->sampleLength += text.length;
+   }
+   if (--compressor->samples == 0) {
+      buildDictionary(compressor);
+   }
+}
+
+Compressor *createCompressor(size_t samples) {
+   Compressor *compressor = calloc(1, sizeof(Compressor));
+   compressor->samples = samples;
+   compressor->textTable = calloc((size_t) 1 << TEXT_HASH_BITS, sizeof(uint32_t));
+   compressor->base = 1;
+   if (samples == 0) {
+      buildDictionary(compressor);
+   }
+   return compressor;
+}
+
+void deleteCompressor(Compressor *compressor) {
+   free(compressor->sampleData);
+   free(compressor->dictionary);
+   free(compressor->dictionaryTable);
+   free(compressor->textTable);
+   free(compressor->output);
+   free(compressor);
+}
+
+/* Dopisuje do compressor->output sekwencję: literals literałów od literal
+ * i odwołanie o długości match i odległości distance (o ile match > 0).
+ * Zwraca nową długość wyniku. */
+static size_t writeSequence(Compressor *compressor, size_t length, const char *literal, size_t literals,
+                            size_t match, size_t distance) {
+   char *output = compressor->output;
+   length += writeNumber(output + length, literals);
+   memcpy(output + length, literal, literals);
+   length += literals;
+   if (match > 0) {
+      length += writeNumber(output + length, match - MIN_MATCH);
+      length += writeNumber(output + length, distance);
+   }
+   return length;
+}
+
+bool compressText(Compressor *compressor, StringView text, StringView *compressed) {
+   if (!compressor->trained) {
+      addSample(compressor, text);
+      return false;
+   }
+   size_t size = text.length;
+   if (size < MIN_MATCH || size > UINT32_MAX / 2) {
+      return false;
+   }
+   if (size + SEQUENCE_OVERHEAD > compressor->outputCapacity) {
+      compressor->outputCapacity = size + SEQUENCE_OVERHEAD;
+      compressor->output = realloc(compressor->output, compressor->outputCapacity);
+   }
+   if (size >= UINT32_MAX - compressor->base) {
+      memset(compressor->textTable, 0, ((size_t) 1 << TEXT_HASH_BITS) * sizeof(uint32_t));
+      compressor->base = 1;
+   }
+   const char *data = text.data;
+   const char *dictionary = compressor->dictionary;
+   size_t dictionaryLength = compressor->dictionaryLength;
+   uint32_t base = compressor->base;
+   compressor->base += size;
+
+   /* Kompresja jest przerywana, gdy tylko wynik nie byłby krótszy od napisu,
+    * więc w buforze wystarczy zapas na liczby jednej sekwencji. */
+   size_t length = 0, anchor = 0, i = 0;
+   while (i + MIN_MATCH <= size) {
+      size_t best = 0, distance = 0;
+      uint32_t *entry = &compressor->textTable[hashFour(data + i, TEXT_HASH_BITS)];
+      if (*entry >= base) {
+         size_t position = *entry - base;
+         best = matchLength(data + position, data + i, size - i);
+         distance = i - position;
+      }
+      *entry = base + i;
+      uint32_t candidate = compressor->dictionaryTable[hashFour(data + i, DICTIONARY_HASH_BITS)];
+      if (candidate > 0) {
+         size_t position = candidate - 1;
+         size_t limit = (dictionaryLength - position < size - i) ? dictionaryLength - position : size - i;
+         size_t match = matchLength(dictionary + position, data + i, limit);
+         if (match > best) {
+            best = match;
+            distance = i + dictionaryLength - position;
+         }
+      }
+      if (best < MIN_MATCH) {
+         i++;
+         continue;
+      }
+      if (length + (i - anchor) >= size) {
+         return false;
+      }
+      length = writeSequence(compressor, length, data + anchor, i - anchor, best, distance);
+      i += best;
+      anchor = i;
+   }
+   if (length + (size - anchor) >= size) {
+      return false;
+   }
+   length = writeSequence(compressor, length, data + anchor, size - anchor, 0, 0);
+   if (length >= size) {
+      return false;
+   }
+   compressed->data = compressor->output;
+   compressed->length = length;
+   return true;
+}
+
+void decompressText(const Compressor *compressor, StringView compressed, char *text, size_t length) {
+   const char *input = compressed.data;
+   size_t position = 0;
+   while (true) {
+      size_t literals = readNumber(&input);
+      memcpy(text + position, input, literals);
+      input += literals;
+      position += literals;
+      if (position == length) {
+         break;
+      }
+      size_t match = readNumber(&input) + MIN_MATCH;
+      size_t distance = readNumber(&input);
+      if (distance > position) {
+         memcpy(text + position, compressor->dictionary + compressor->dictionaryLength - (distance - position), match);
+      }
+      else if (distance >= match) {
+         memcpy(text + position, text + position - distance, match);
+      }
+      else {
+         // Odwołanie zachodzi na kopiowany fragment (powtórzenie krótkiego wzorca).
+         for (size_t i = 0; i < match; i++) {
+            text[position + i] = text[position + i - distance];
+         }
+      }
+      position += match;
+   }
+}
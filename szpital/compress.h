@@ -0,0 +1,39 @@
+#ifndef COMPRESS_H
+#define COMPRESS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "view.h"
+
+/* Kompresja opisów chorób algorytmem z rodziny LZ77 ze wspólnym słownikiem.
+ * Opisy są zwykle krótkie, więc same w sobie prawie się nie powtarzają,
+ * za to są podobne do siebie nawzajem. Dlatego odwołania mogą wskazywać
+ * nie tylko na wcześniejszy fragment kompresowanego napisu, ale też
+ * na słownik - wybrane fragmenty pierwszych skompresowanych opisów,
+ * które najczęściej powtarzają się w innych.
+ *
+ * Skompresowany napis jest ciągiem sekwencji: liczba literałów, literały,
+ * długość odwołania (minus MIN_MATCH) i jego odległość wstecz (licząc
+ * słownik jako tekst poprzedzający napis). Liczby są zapisywane po 7 bitów
+ * na bajt. Ostatnia sekwencja zawiera tylko literały. */
+typedef struct Compressor Compressor;
+
+// Tworzy kompresor, którego słownik powstanie z pierwszych samples napisów.
+Compressor *createCompressor(size_t samples);
+
+// Zwalnia kompresor.
+void deleteCompressor(Compressor *compressor);
+
+/* Kompresuje napis text. Dopóki słownik nie jest gotowy, zapamiętuje text
+ * jako próbkę do jego budowy i zwraca false, podobnie jak wtedy, gdy
+ * skompresowany napis nie byłby krótszy. W przeciwnym razie zapisuje
+ * w compressed skompresowany napis (ważny do następnego wywołania)
+ * i zwraca true. Ten sam napis zawsze jest kompresowany tak samo. */
+bool compressText(Compressor *compressor, StringView text, StringView *compressed);
+
+/* Zapisuje w text napis o długości length, którego postacią skompresowaną
+ * jest compressed. Nie zmienia kompresora, więc może być wywoływana
+ * z innych wątków niż compressText, o ile compressed jest już im widoczny. */
+void decompressText(const Compressor *compressor, StringView compressed, char *text, size_t length);
+
+#endif // COMPRESS_H
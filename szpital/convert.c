@@ -0,0 +1,165 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "output.h"
+#include "parse.h"
+
+/* Program tłumaczący między protokołem tekstowym i binarnym programu hospital
+ * (patrz readerUseBinaryProtocol w parse.h i ReplyCode w output.h).
+ * Czyta ze standardowego wejścia i pisze na standardowe wyjście.
+ *
+ * Użycie: convert to-binary|to-text|replies
+ *    to-binary  polecenia tekstowe na binarne (niepoprawne wiersze są pomijane),
+ *    to-text    polecenia binarne na tekstowe,
+ *    replies    odpowiedzi binarne (hospital --binary) na tekstowe. */
+
+// Zapisuje value po 7 bitów na bajt, jak długości napisów w protokole binarnym.
+static void writeVarint(size_t value) {
+   while (value >= 0x80) {
+      putchar((int) ((value & 0x7F) | 0x80));
+      value >>= 7;
+   }
+   putchar((int) value);
+}
+
+static void writeString(StringView string) {
+   writeVarint(string.length);
+   fwrite(string.data, 1, string.length, stdout);
+}
+
+static void writeInteger(int number) {
+   uint32_t value = (uint32_t) number;
+   for (int i = 0; i < 4; i++) {
+      putchar((int) ((value >> (8 * i)) & 0xFF));
+   }
+}
+
+static void writeBinaryCommand(ParsedInput *input) {
+   putchar(input->function);
+   switch (input->function) {
+      case NewDiseaseEnterDescription:
+      case NewDiseaseCopyDescription:
+         writeString(input->atr1);
+         writeString(input->atr2);
+         break;
+      case ChangeDescription:
+         writeString(input->atr1);
+         writeInteger(input->n);
+         writeString(input->atr2);
+         break;
+      case PrintDescription:
+         writeString(input->atr1);
+         writeInteger(input->n);
+         break;
+      case DeletePatientData:
+      case SaveSnapshot:
+         writeString(input->atr1);
+         break;
+      case PrintStats:
+         break;
+   }
+}
+
+static void writeTextCommand(ParsedInput *input) {
+   fputs(FUNCTION_NAMES[input->function], stdout);
+   if (input->function != PrintStats) {
+      printf(" %.*s", (int) input->atr1.length, input->atr1.data);
+   }
+   if (input->function == ChangeDescription || input->function == PrintDescription) {
+      printf(" %d", input->n);
+   }
+   if (input->function == NewDiseaseEnterDescription || input->function == NewDiseaseCopyDescription
+       || input->function == ChangeDescription) {
+      printf(" %.*s", (int) input->atr2.length, input->atr2.data);
+   }
+   putchar('\n');
+}
+
+static void convertCommands(bool toBinary) {
+   Reader *reader = createReader(STDIN_FILENO);
+   if (!toBinary) {
+      readerUseBinaryProtocol(reader);
+   }
+   ParsedInput input;
+   while (parseLine(reader, &input)) {
+      if (toBinary) {
+         writeBinaryCommand(&input);
+      }
+      else {
+         writeTextCommand(&input);
+      }
+   }
+   deleteReader(reader);
+}
+
+// Wczytuje liczbę zapisaną przez writeVarint. Zwraca false, jeżeli wejście się urywa.
+static bool readVarint(size_t *value) {
+   *value = 0;
+   for (int shift = 0; shift < 64; shift += 7) {
+      int byte = getchar();
+      if (byte == EOF) {
+         return false;
+      }
+      *value |= (size_t) (byte & 0x7F) << shift;
+      if ((byte & 0x80) == 0) {
+         return true;
+      }
+   }
+   return false;
+}
+
+// Zwraca false, jeżeli odpowiedzi są niepoprawne.
+static bool convertReplies() {
+   int code;
+   while ((code = getchar()) != EOF) {
+      size_t length;
+      switch (code) {
+         case OkReply:
+            puts("OK");
+            break;
+         case IgnoredReply:
+            puts("IGNORED");
+            break;
+         case DescriptionReply:
+         case ReportReply:
+            if (!readVarint(&length)) {
+               return false;
+            }
+            for (size_t i = 0; i < length; i++) {
+               int c = getchar();
+               if (c == EOF) {
+                  return false;
+               }
+               putchar(c);
+            }
+            if (code == DescriptionReply) {
+               putchar('\n');
+            }
+            break;
+         default:
+            return false;
+      }
+   }
+   return true;
+}
+
+int main(int argc, char **argv) {
+   if (argc == 2 && strcmp(argv[1], "to-binary") == 0) {
+      convertCommands(true);
+   }
+   else if (argc == 2 && strcmp(argv[1], "to-text") == 0) {
+      convertCommands(false);
+   }
+   else if (argc == 2 && strcmp(argv[1], "replies") == 0) {
+      if (!convertReplies()) {
+         fprintf(stderr, "%s: invalid reply\n", argv[0]);
+         return 1;
+      }
+   }
+   else {
+      fprintf(stderr, "usage: %s to-binary|to-text|replies\n", argv[0]);
+      return 1;
+   }
+   return 0;
+}
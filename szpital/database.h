@@ -0,0 +1,258 @@
+#ifndef DATABASE_H
+#define DATABASE_H
+
+/* Wewnętrzna reprezentacja struktury danych z structure.h,
+ * wspólna dla structure.c i modułów operujących bezpośrednio na niej
+ * (np. snapshot.c). Pozostałe moduły powinny korzystać z structure.h. */
+
+#include <pthread.h>
+#include <stdint.h>
+#include "blob.h"
+#include "compress.h"
+#include "epoch.h"
+#include "hashmap.h"
+#include "memory.h"
+#include "structure.h"
+
+// Rozmiar bufora na opis błędu struktury (patrz databaseFailure).
+#define FAILURE_SIZE 256
+
+// Początkowa pojemność tablicy historii chorób pacjenta.
+#define INITIAL_HISTORY_CAPACITY 4
+
+/* Treść opisu choroby. W trybie internowania jest współdzielona
+ * przez wszystkie choroby o identycznym opisie. */
+typedef struct Description {
+   int counter; // Liczba chorób, których opisem jest ta treść.
+   uint32_t mark; // Numer nadany przy zapisie migawki (patrz snapshot.c).
+   uint32_t length;
+   /* Długość zawartości text: treści, jej postaci skompresowanej
+    * albo adresu w magazynie. */
+   uint32_t storedLength;
+   /* Numer części struktury, do której należy pamięć opisu i jego chorób
+    * (patrz Database::shards). */
+   uint16_t shard;
+   /* Czy treść jest w magazynie Database::blobs - wtedy text zawiera
+    * tylko jej adres (uint64_t), patrz descriptionText. */
+   bool spilled;
+   // Czy text zawiera treść skompresowaną kompresorem części struktury shard.
+   bool compressed;
+   char text[];
+} Description;
+
+/* Wartość licznika referencji choroby, na którą wskazują historie z różnych
+ * części struktury. Jej referencje liczy wątek wypisujący w kolejności poleceń
+ * (patrz pipeline.c), a części tylko zgłaszają ich zmiany (ReferenceEvent). */
+#define SHARED_DISEASE -1
+
+typedef struct Disease {
+   Description *description;
+   int counter; // Liczba wpisów w historiach wskazujących na chorobę albo SHARED_DISEASE.
+   uint32_t mark; // Numer nadany przy zapisie migawki (patrz snapshot.c).
+} Disease;
+
+/* Uchwyt choroby: numer w tablicy Database::diseases części, do której
+ * należy choroba, przesunięty o Database::shardBits bitów, z numerem tej
+ * części na najmłodszych bitach (patrz diseaseAt). Historie pacjentów
+ * są tablicami uchwytów, dwa razy mniejszymi niż tablice wskaźników. */
+typedef uint32_t DiseaseHandle;
+
+// Uchwyt, który nie wskazuje na żadną chorobę.
+#define NO_DISEASE NO_OBJECT
+
+// Zmiana liczby referencji do choroby o liczniku SHARED_DISEASE.
+typedef struct ReferenceEvent {
+   int command; // Numer polecenia w paczce, które zmieniło liczbę referencji.
+   int delta;
+   DiseaseHandle disease;
+} ReferenceEvent;
+
+typedef struct Patient {
+   const char *name;
+   // Historia chorób: tablica history o rozmiarze diseases i pojemności capacity.
+   DiseaseHandle *history;
+   uint32_t nameLength;
+   int diseases, capacity;
+   /* Jeżeli pacjent został wczytany z migawki i jego historia nie została
+    * jeszcze odtworzona, numery jego chorób w migawce. W przeciwnym razie NULL. */
+   const uint32_t *snapshotHistory;
+} Patient;
+
+// Migawka, z której wczytano strukturę (zdefiniowana w snapshot.c).
+typedef struct Snapshot Snapshot;
+
+// Dziennik zapisu z wyprzedzeniem (zdefiniowany w wal.c).
+typedef struct WriteAheadLog WriteAheadLog;
+
+typedef enum MutationType {
+   EnterDescriptionMutation,
+   CopyDescriptionMutation,
+   ChangeDescriptionMutation,
+   DeletePatientMutation
+} MutationType;
+
+// Wykonane polecenie modyfikujące strukturę, w postaci zapisywanej w dzienniku.
+typedef struct Mutation {
+   MutationType type;
+   int n;
+   StringView atr1, atr2;
+} Mutation;
+
+struct Database {
+   HashMap *patients; // Pacjenci indeksowani nazwiskiem.
+   // Pamięć struktury: zwalniana w całości przez deleteDatabase.
+   Pool *patientPool;
+   ObjectTable *diseases; // Choroby tej części wskazywane uchwytami (DiseaseHandle).
+   Heap *heap; // Opisy i tablice historii.
+   Arena *names; // Nazwiska pacjentów (nigdy nie są usuwane).
+   int descriptions;
+   // Opisy indeksowane treścią. NULL, jeżeli internowanie jest wyłączone.
+   HashMap *descriptionIndex;
+   size_t internHits; // Liczba opisów, dla których znaleziono identyczną treść.
+   size_t savedBytes; // Pamięć zaoszczędzona obecnie dzięki internowaniu.
+   /* Pamięć zajmowana przez opisy oraz suma rozmiarów opisów wskazywanych
+    * przez wpisy historii (opisy i historie jeszcze nieodtworzone z migawki
+    * nie są liczone). Różnica to pamięć oszczędzana przez współdzielenie opisów. */
+   size_t descriptionBytes, historyBytes;
+   size_t historyEntries; // Łączna długość historii pacjentów.
+   /* Magazyn, do którego trafiają treści opisów o długości co najmniej
+    * spillThreshold (NULL, jeżeli wszystkie opisy są w pamięci). */
+   BlobStore *blobs;
+   size_t spillThreshold;
+   /* Kompresor opisów (NULL, jeżeli kompresja jest wyłączona) i bufor,
+    * do którego descriptionText rozpakowuje opisy. */
+   Compressor *compressor;
+   char *decoded;
+   size_t decodedCapacity;
+   // Łączna długość opisów skompresowanych i ich postaci skompresowanych.
+   size_t compressedTextBytes, compressedBytes;
+   Snapshot *snapshot; // NULL, jeżeli struktury nie wczytano z migawki.
+   /* Numer migawki, od której zaczyna się stan struktury (0 dla pustej).
+    * Dziennik zawiera tylko polecenia wykonane od tej migawki. */
+   uint64_t generation;
+   WriteAheadLog *log; // NULL, jeżeli dziennik jest wyłączony.
+   /* Części struktury w trybie z podziałem pacjentów między wątki (NULL
+    * bez podziału). Każda część jest osobną strukturą Database o numerze
+    * shard, a shards[0] jest strukturą zwróconą przez initializeDatabase. */
+   Database **shards;
+   uint32_t shard, shardCount;
+   uint32_t shardBits; // Liczba bitów numeru części w uchwytach chorób.
+   /* Współdzielone choroby tej części, do których nie ma już referencji.
+    * Zwalnia je dopiero ta część (freeRemoteDiseases), bo tylko ona
+    * korzysta ze swoich pul. */
+   pthread_mutex_t remoteMutex;
+   DiseaseHandle *remoteFrees;
+   size_t remoteCount, remoteCapacity;
+   // Zgłoszone zmiany referencji współdzielonych chorób i numer bieżącego polecenia.
+   ReferenceEvent *events;
+   size_t eventCount, eventCapacity;
+   int command;
+   /* Domena czytających bez blokad (NULL, jeżeli nie zostali włączeni
+    * przez enableConcurrentReaders). Jeżeli jest włączona, usunięte choroby,
+    * opisy i tablice historii są zwalniane z opóźnieniem (patrz epoch.h). */
+   EpochDomain *epochs;
+   /* Opis błędu, po którym ta część nie wykonuje już poleceń
+    * (pusty napis, jeżeli go nie było), patrz failDatabase. */
+   char failure[FAILURE_SIZE];
+};
+
+// Wątek czytający strukturę bez blokad (patrz readDescription).
+struct DatabaseReader {
+   Database *database;
+   EpochReader *epoch;
+   // Bufor z treścią ostatnio odczytanego opisu.
+   char *text;
+   size_t length, capacity;
+};
+
+// Zwraca chorobę o uchwycie handle (z dowolnej części struktury database).
+Disease *diseaseAt(DiseaseHandle handle, Database *database);
+
+/* Zapisuje w database błąd operacji operation (z kodem errno error albo 0),
+ * po którym struktura nie może dalej wykonywać poleceń. Zachowuje pierwszy błąd. */
+void failDatabase(Database *database, const char *operation, int error);
+
+/* Tworzy w database chorobę o opisie description i liczniku referencji counter
+ * i zwraca jej uchwyt (liczby opisów database nie zmienia). Jeżeli zabrakło
+ * uchwytów, zgłasza błąd struktury (failDatabase) i zwraca NO_DISEASE. */
+DiseaseHandle newDisease(Description *description, int counter, Database *database);
+
+/* Znajduje i zwraca pacjenta o nazwisku name w database.
+ * Jeżeli nie ma takiego pacjenta, zwraca NULL. */
+Patient *findPatient(StringView name, Database *database);
+
+// Zwraca rozmiar pamięci zajmowanej przez opis o treści długości length.
+size_t descriptionSize(size_t length);
+
+/* Tworzy opis o treści text (z licznikiem referencji 1), przenosząc
+ * długą treść do magazynu database->blobs albo ją kompresując. */
+Description *allocateDescription(StringView text, Database *database);
+
+/* Zwraca treść opisu description. Treść z magazynu jest ważna
+ * do następnej zmiany database, a rozpakowana - do następnego
+ * wywołania dla database. */
+StringView descriptionText(Description *description, Database *database);
+
+// Dodaje opis description do indeksu opisów, jeżeli nie ma w nim identycznego.
+void indexDescription(Description *description, Database *database);
+
+/* Funkcje apply* wykonują polecenie na database bez wypisywania czegokolwiek.
+ * Zwracają false, jeżeli polecenie zostało zignorowane (nic nie zmieniło). */
+
+bool applyNewDiseaseEnterDescription(StringView name, StringView description, Database *database);
+
+bool applyNewDiseaseCopyDescription(StringView name1, StringView name2, Database *database);
+
+bool applyChangeDescription(StringView name, int n, StringView description, Database *database);
+
+bool applyDeletePatientData(StringView name, Database *database);
+
+/* Ustawia *description na opis n-tej choroby pacjenta o nazwisku name
+ * (ważny do następnej zmiany database). */
+bool applyPrintDescription(StringView name, int n, Database *database, StringView *description);
+
+// Zapisuje migawkę database do pliku o nazwie path.
+bool applySaveSnapshot(StringView path, Database *database);
+
+/* Zwraca ostatnią chorobę pacjenta o nazwisku name z dodaną referencją
+ * (albo NO_DISEASE, jeżeli nie ma takiej choroby) - pierwsza połowa polecenia
+ * NEW_DISEASE_COPY_DESCRIPTION, gdy pacjenci należą do różnych części.
+ * Choroba staje się od tej chwili współdzielona (SHARED_DISEASE). */
+DiseaseHandle acquireLastDisease(StringView name, Database *database);
+
+/* Dodaje chorobę disease, zwróconą przez acquireLastDisease w innej części,
+ * do historii pacjenta o nazwisku name (przejmując referencję) - druga połowa
+ * polecenia NEW_DISEASE_COPY_DESCRIPTION. */
+void applyCopiedDisease(StringView name, DiseaseHandle disease, Database *database);
+
+/* Przekazuje współdzieloną chorobę disease, do której nie ma już referencji,
+ * do zwolnienia części, do której należy (database to dowolna część). */
+void freeSharedDisease(DiseaseHandle disease, Database *database);
+
+// Zwalnia współdzielone choroby tej części, do których nie ma już referencji.
+void freeRemoteDiseases(Database *database);
+
+// Dodaje do statistics statystyki części database (bez innych części).
+void addShardStatistics(Database *database, DatabaseStatistics *statistics);
+
+/* Wykonuje polecenie mutation, a jeżeli zostało wykonane i włączony
+ * jest dziennik, dopisuje je do dziennika. */
+bool applyMutation(Mutation *mutation, Database *database);
+
+/* Odtwarza historię pacjenta wczytanego z migawki (patrz snapshot.c). Jeżeli
+ * migawka okaże się uszkodzona, zgłasza błąd struktury (failDatabase), a historia
+ * zawiera tylko choroby odtworzone przed błędem. */
+void materializePatient(Patient *patient, Database *database);
+
+// Zwalnia zasoby migawki, z której wczytano database (patrz snapshot.c).
+void closeSnapshot(Database *database);
+
+/* Dopisuje polecenie mutation do dziennika database->log (patrz wal.c).
+ * Jeżeli nie udało się zapisać dziennika, zgłasza błąd struktury (failDatabase). */
+void appendToLog(Mutation *mutation, Database *database);
+
+/* Zapisuje trwale i zamyka dziennik database, jeżeli jest włączony (patrz wal.c).
+ * Błąd zapisu jest pomijany - polecenia potwierdza syncWriteAheadLog. */
+void closeWriteAheadLog(Database *database);
+
+#endif // DATABASE_H
@@ -0,0 +1,152 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "epoch.h"
+
+// Rozmiar linii pamięci podręcznej: każdy czytający ogłasza epokę w osobnej.
+#define CACHE_LINE 64
+
+// Epoka czytającego, który nie wykonuje odczytu (epoki domeny zaczynają się od 1).
+#define INACTIVE 0
+
+struct EpochReader {
+   uint64_t epoch; // Zmieniana tylko przez czytającego, czytana przez piszącego.
+   EpochReader *next;
+   char padding[CACHE_LINE - sizeof(uint64_t) - sizeof(EpochReader *)];
+};
+
+// Obiekt oddany do zwolnienia w epoce epoch.
+typedef struct RetiredObject {
+   void *object;
+   size_t size;
+   ReclaimFunction reclaim;
+   uint64_t epoch;
+} RetiredObject;
+
+struct EpochDomain {
+   uint64_t epoch; // Zmieniana tylko przez piszącego.
+   void *argument;
+   // Lista czytających (zmieniana pod blokadą readersMutex).
+   pthread_mutex_t readersMutex;
+   EpochReader *readers;
+   // Oddane obiekty w kolejności oddania (więc i nierosnących epok).
+   RetiredObject *retired;
+   size_t retiredCount, retiredCapacity;
+};
+
+EpochDomain *createEpochDomain(void *argument) {
+   EpochDomain *domain = malloc(sizeof(EpochDomain));
+   domain->epoch = INACTIVE + 1;
+   domain->argument = argument;
+   pthread_mutex_init(&domain->readersMutex, NULL);
+   domain->readers = NULL;
+   domain->retired = NULL;
+   domain->retiredCount = 0;
+   domain->retiredCapacity = 0;
+   return domain;
+}
+
+// Zwalnia count pierwszych oddanych obiektów.
+static void reclaimFirst(EpochDomain *domain, size_t count) {
+   for (size_t i = 0; i < count; i++) {
+      RetiredObject *retired = &domain->retired[i];
+      retired->reclaim(retired->object, retired->size, domain->argument);
+   }
+   domain->retiredCount -= count;
+   memmove(domain->retired, domain->retired + count, domain->retiredCount * sizeof(RetiredObject));
+}
+
+void deleteEpochDomain(EpochDomain *domain) {
+   reclaimFirst(domain, domain->retiredCount);
+   free(domain->retired);
+   while (domain->readers != NULL) {
+      EpochReader *next = domain->readers->next;
+      free(domain->readers);
+      domain->readers = next;
+   }
+   pthread_mutex_destroy(&domain->readersMutex);
+   free(domain);
+}
+
+EpochReader *registerEpochReader(EpochDomain *domain) {
+   void *memory;
+   if (posix_memalign(&memory, CACHE_LINE, sizeof(EpochReader)) != 0) {
+      return NULL;
+   }
+   EpochReader *reader = memory;
+   reader->epoch = INACTIVE;
+   pthread_mutex_lock(&domain->readersMutex);
+   reader->next = domain->readers;
+   domain->readers = reader;
+   pthread_mutex_unlock(&domain->readersMutex);
+   return reader;
+}
+
+void unregisterEpochReader(EpochDomain *domain, EpochReader *reader) {
+   pthread_mutex_lock(&domain->readersMutex);
+   EpochReader **link = &domain->readers;
+   while (*link != reader) {
+      link = &(*link)->next;
+   }
+   *link = reader->next;
+   pthread_mutex_unlock(&domain->readersMutex);
+   free(reader);
+}
+
+void enterEpoch(EpochDomain *domain, EpochReader *reader) {
+   __atomic_store_n(&reader->epoch, __atomic_load_n(&domain->epoch, __ATOMIC_ACQUIRE), __ATOMIC_RELAXED);
+   /* Ogłoszenie epoki musi być widoczne dla piszącego, zanim zaczniemy czytać
+    * strukturę: inaczej mógłby zwolnić obiekt, który zaraz odczytamy. */
+   __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+void leaveEpoch(EpochReader *reader) {
+   __atomic_store_n(&reader->epoch, INACTIVE, __ATOMIC_RELEASE);
+}
+
+void retireObject(EpochDomain *domain, void *object, size_t size, ReclaimFunction reclaim) {
+   if (domain->retiredCount == domain->retiredCapacity) {
+      domain->retiredCapacity = (domain->retiredCapacity == 0) ? 64 : 2 * domain->retiredCapacity;
+      domain->retired = realloc(domain->retired, domain->retiredCapacity * sizeof(RetiredObject));
+   }
+   RetiredObject *retired = &domain->retired[domain->retiredCount++];
+   retired->object = object;
+   retired->size = size;
+   retired->reclaim = reclaim;
+   retired->epoch = domain->epoch;
+}
+
+// Czy wszyscy aktywni czytający są w bieżącej epoce.
+static bool readersCaughtUp(EpochDomain *domain) {
+   // Para dla bariery z enterEpoch: obiekty oddane wcześniej nie są już osiągalne.
+   __atomic_thread_fence(__ATOMIC_SEQ_CST);
+   bool caughtUp = true;
+   pthread_mutex_lock(&domain->readersMutex);
+   for (EpochReader *reader = domain->readers; reader != NULL && caughtUp; reader = reader->next) {
+      uint64_t epoch = __atomic_load_n(&reader->epoch, __ATOMIC_ACQUIRE);
+      caughtUp = epoch == INACTIVE || epoch == domain->epoch;
+   }
+   pthread_mutex_unlock(&domain->readersMutex);
+   return caughtUp;
+}
+
+void reclaimObjects(EpochDomain *domain) {
+   if (domain->retiredCount == 0) {
+      return;
+   }
+   if (readersCaughtUp(domain)) {
+      __atomic_store_n(&domain->epoch, domain->epoch + 1, __ATOMIC_RELEASE);
+   }
+   /* Czytający mogą być najwyżej o jedną epokę do tyłu, a obiekt oddany
+    * w epoce e był osiągalny tylko dla odczytów rozpoczętych w epoce e i wcześniej. */
+   size_t count = 0;
+   while (count < domain->retiredCount && domain->retired[count].epoch + 2 <= domain->epoch) {
+      count++;
+   }
+   if (count > 0) {
+      reclaimFirst(domain, count);
+   }
+}
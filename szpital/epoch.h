@@ -0,0 +1,57 @@
+#ifndef EPOCH_H
+#define EPOCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Odroczone zwalnianie pamięci czytanej bez blokad (epoch-based reclamation).
+ * Jeden wątek (piszący) zmienia strukturę, a dowolnie wiele wątków czytających
+ * przegląda ją równocześnie, nie zakładając żadnych blokad. Obiekt usunięty
+ * ze struktury może jednak wciąż być czytany, więc piszący nie zwalnia go od
+ * razu, tylko oddaje (retireObject) z numerem bieżącej epoki.
+ *
+ * Czytający na czas każdego odczytu ogłasza epokę, w której zaczął
+ * (enterEpoch, leaveEpoch). Piszący przechodzi do następnej epoki dopiero
+ * wtedy, gdy wszyscy aktywni czytający są już w bieżącej, więc obiekty oddane
+ * dwie epoki temu nie są osiągalne dla żadnego czytającego i można je zwolnić.
+ * Zwalnia je zawsze wątek piszący, dzięki czemu alokatory nie muszą być
+ * bezpieczne dla wielu wątków. */
+typedef struct EpochDomain EpochDomain;
+
+// Stan wątku czytającego w domenie.
+typedef struct EpochReader EpochReader;
+
+// Zwalnia obiekt object o rozmiarze size (argument jak w createEpochDomain).
+typedef void (*ReclaimFunction)(void *object, size_t size, void *argument);
+
+// Tworzy domenę, której obiekty będą zwalniane z argumentem argument.
+EpochDomain *createEpochDomain(void *argument);
+
+/* Zwalnia wszystkie oddane obiekty i domenę. Wolno ją wywołać dopiero
+ * po wyrejestrowaniu wszystkich czytających. */
+void deleteEpochDomain(EpochDomain *domain);
+
+// Rejestruje wątek czytający (każdy wątek potrzebuje własnego EpochReader).
+EpochReader *registerEpochReader(EpochDomain *domain);
+
+// Wyrejestrowuje czytającego reader spoza odczytu.
+void unregisterEpochReader(EpochDomain *domain, EpochReader *reader);
+
+/* Rozpoczyna odczyt: obiekty osiągalne od tej chwili nie zostaną zwolnione
+ * przed leaveEpoch. Odczyty nie mogą być zagnieżdżone. */
+void enterEpoch(EpochDomain *domain, EpochReader *reader);
+
+// Kończy odczyt rozpoczęty przez enterEpoch.
+void leaveEpoch(EpochReader *reader);
+
+/* Oddaje obiekt object o rozmiarze size, już nieosiągalny ze struktury,
+ * do zwolnienia funkcją reclaim, gdy nie będzie go czytał żaden wątek.
+ * Tylko dla wątku piszącego. */
+void retireObject(EpochDomain *domain, void *object, size_t size, ReclaimFunction reclaim);
+
+/* Przechodzi do następnej epoki, jeżeli to możliwe, i zwalnia obiekty, których
+ * nie może już czytać żaden wątek. Tylko dla wątku piszącego, który powinien
+ * ją wywoływać regularnie (np. po każdym poleceniu). */
+void reclaimObjects(EpochDomain *domain);
+
+#endif // EPOCH_H
@@ -0,0 +1,277 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "parse.h"
+
+/* Generator obciążenia dla programu hospital i programu bench.
+ * Wypisuje na standardowe wyjście ciąg poleceń, w którym:
+ * - pacjenci są wybierani z rozkładu Zipfa (pacjent k z prawdopodobieństwem
+ *   proporcjonalnym do 1 / k^s),
+ * - rodzaje poleceń są losowane z wagami podanymi w opcji -m,
+ * - długości opisów mają rozkład log-jednostajny z przedziału podanego w -l.
+ *
+ * Opcje:
+ * -n LICZBA  liczba poleceń (domyślnie 1 000 000),
+ * -p LICZBA  liczba różnych pacjentów (domyślnie 10 000),
+ * -z S  wykładnik rozkładu Zipfa (domyślnie 1.0, 0 to rozkład jednostajny),
+ * -m E,C,Z,W,U  wagi poleceń NEW_DISEASE_ENTER_DESCRIPTION, NEW_DISEASE_COPY_DESCRIPTION,
+ *    CHANGE_DESCRIPTION, PRINT_DESCRIPTION i DELETE_PATIENT_DATA,
+ * -l MIN,MAX  najkrótszy i najdłuższy opis (najwyżej MAX_DESCRIPTION_LENGTH),
+ * -d LICZBA  liczba różnych opisów, z których losowane są nowe opisy (domyślnie 1000),
+ * -s SCENARIUSZ  domyślne wagi poleceń: mixed, copy (dużo kopiowania)
+ *    albo delete (dużo usuwania),
+ * -r LICZBA  ziarno generatora liczb losowych. */
+
+// Najdłuższy opis, przy którym polecenie mieści się w MAX_LINE_LENGTH.
+#define MAX_DESCRIPTION_LENGTH (MAX_LINE_LENGTH - 100)
+
+// Liczba rodzajów poleceń generowanych w obciążeniu (bez SNAPSHOT).
+#define COMMAND_TYPES 5
+
+typedef struct Scenario {
+   const char *name;
+   int weights[COMMAND_TYPES];
+} Scenario;
+
+static const Scenario SCENARIOS[] = {
+   {"mixed", {40, 15, 10, 30, 5}},
+   {"copy", {15, 60, 5, 15, 5}},
+   {"delete", {40, 10, 5, 15, 30}}
+};
+
+typedef struct Options {
+   size_t commands;
+   size_t patients;
+   double exponent;
+   int weights[COMMAND_TYPES];
+   size_t minLength, maxLength;
+   size_t descriptions;
+   uint64_t seed;
+} Options;
+
+static uint64_t state;
+
+// Generator xorshift64*.
+static uint64_t randomNumber() {
+   state ^= state >> 12;
+   state ^= state << 25;
+   state ^= state >> 27;
+   return state * 0x2545F4914F6CDD1DULL;
+}
+
+// Zwraca liczbę z przedziału [0, 1).
+static double randomFraction() {
+   return (randomNumber() >> 11) * (1.0 / (1ULL << 53));
+}
+
+// Zwraca liczbę z przedziału [0, bound).
+static size_t randomBelow(size_t bound) {
+   return randomNumber() % bound;
+}
+
+/* Zwraca dystrybuantę rozkładu Zipfa o wykładniku exponent na count elementach:
+ * element k jest wybierany, gdy losowa liczba z [0, 1) jest mniejsza od cdf[k]
+ * i nie mniejsza od cdf[k - 1]. */
+static double *zipfDistribution(size_t count, double exponent) {
+   double *cdf = malloc(count * sizeof(double));
+   double sum = 0;
+   for (size_t i = 0; i < count; i++) {
+      sum += 1 / pow(i + 1, exponent);
+      cdf[i] = sum;
+   }
+   for (size_t i = 0; i < count; i++) {
+      cdf[i] /= sum;
+   }
+   return cdf;
+}
+
+static size_t sampleZipf(const double *cdf, size_t count) {
+   double value = randomFraction();
+   size_t low = 0, high = count - 1;
+   while (low < high) {
+      size_t middle = (low + high) / 2;
+      if (cdf[middle] <= value) {
+         low = middle + 1;
+      }
+      else {
+         high = middle;
+      }
+   }
+   return low;
+}
+
+// Zwraca losowy opis o długości z rozkładu log-jednostajnego.
+static char *randomDescription(Options *options) {
+   double low = log(options->minLength), high = log(options->maxLength + 1);
+   size_t length = exp(low + (high - low) * randomFraction());
+   if (length > options->maxLength) {
+      length = options->maxLength;
+   }
+   char *description = malloc(length + 1);
+   for (size_t i = 0; i < length; i++) {
+      // Słowa po kilka liter, żeby opis wyglądał jak tekst i nie kończył się spacją.
+      description[i] = (i % 6 == 5 && i + 1 < length) ? ' ' : 'a' + randomBelow(26);
+   }
+   description[length] = '\0';
+   return description;
+}
+
+// Wczytuje listę count liczb oddzielonych przecinkami. Zwraca false, jeżeli jest niepoprawna.
+static bool parseList(const char *text, size_t *values, int count) {
+   for (int i = 0; i < count; i++) {
+      char *end;
+      values[i] = strtoul(text, &end, 10);
+      if (end == text || (i + 1 < count && *end != ',') || (i + 1 == count && *end != '\0')) {
+         return false;
+      }
+      text = end + 1;
+   }
+   return true;
+}
+
+static bool parseOptions(int argc, char **argv, Options *options) {
+   options->commands = 1000000;
+   options->patients = 10000;
+   options->exponent = 1.0;
+   memcpy(options->weights, SCENARIOS[0].weights, sizeof(options->weights));
+   options->minLength = 5;
+   options->maxLength = 200;
+   options->descriptions = 1000;
+   options->seed = 1;
+
+   // Każda opcja ma wartość.
+   if (argc % 2 == 0) {
+      return false;
+   }
+   for (int i = 1; i < argc; i += 2) {
+      const char *option = argv[i], *value = argv[i + 1];
+      size_t values[COMMAND_TYPES];
+      bool correct = true;
+      if (strcmp("-n", option) == 0) {
+         correct = parseList(value, &options->commands, 1);
+      }
+      else if (strcmp("-p", option) == 0) {
+         correct = parseList(value, &options->patients, 1);
+      }
+      else if (strcmp("-z", option) == 0) {
+         options->exponent = atof(value);
+      }
+      else if (strcmp("-m", option) == 0) {
+         correct = parseList(value, values, COMMAND_TYPES);
+         for (int j = 0; correct && j < COMMAND_TYPES; j++) {
+            options->weights[j] = values[j];
+         }
+      }
+      else if (strcmp("-l", option) == 0) {
+         correct = parseList(value, values, 2);
+         options->minLength = values[0];
+         options->maxLength = values[1];
+      }
+      else if (strcmp("-d", option) == 0) {
+         correct = parseList(value, &options->descriptions, 1);
+      }
+      else if (strcmp("-s", option) == 0) {
+         size_t scenario = 0;
+         while (scenario < sizeof(SCENARIOS) / sizeof(Scenario)
+                && strcmp(SCENARIOS[scenario].name, value) != 0) {
+            scenario++;
+         }
+         correct = scenario < sizeof(SCENARIOS) / sizeof(Scenario);
+         if (correct) {
+            memcpy(options->weights, SCENARIOS[scenario].weights, sizeof(options->weights));
+         }
+      }
+      else if (strcmp("-r", option) == 0) {
+         options->seed = strtoull(value, NULL, 10);
+      }
+      else {
+         correct = false;
+      }
+      if (!correct) {
+         return false;
+      }
+   }
+
+   int totalWeight = 0;
+   for (int i = 0; i < COMMAND_TYPES; i++) {
+      totalWeight += options->weights[i];
+   }
+   return options->patients > 0 && options->descriptions > 0 && totalWeight > 0
+          && options->minLength > 0 && options->minLength <= options->maxLength
+          && options->maxLength <= MAX_DESCRIPTION_LENGTH;
+}
+
+int main(int argc, char **argv) {
+   Options options;
+   if (!parseOptions(argc, argv, &options)) {
+      fprintf(stderr, "usage: %s [-n COMMANDS] [-p PATIENTS] [-z EXPONENT] [-m E,C,Z,W,U] "
+              "[-l MIN,MAX] [-d DESCRIPTIONS] [-s mixed|copy|delete] [-r SEED]\n", argv[0]);
+      return 1;
+   }
+   state = options.seed * 0x9E3779B97F4A7C15ULL + 1;
+
+   double *cdf = zipfDistribution(options.patients, options.exponent);
+   // Liczba chorób w historii każdego pacjenta, żeby numery chorób były zwykle poprawne.
+   int *diseases = calloc(options.patients, sizeof(int));
+   char **descriptions = malloc(options.descriptions * sizeof(char *));
+   for (size_t i = 0; i < options.descriptions; i++) {
+      descriptions[i] = randomDescription(&options);
+   }
+   int totalWeight = 0;
+   for (int i = 0; i < COMMAND_TYPES; i++) {
+      totalWeight += options.weights[i];
+   }
+
+   for (size_t i = 0; i < options.commands; i++) {
+      int choice = randomBelow(totalWeight);
+      FunctionType function = NewDiseaseEnterDescription;
+      while (choice >= options.weights[function]) {
+         choice -= options.weights[function];
+         function++;
+      }
+      size_t patient = sampleZipf(cdf, options.patients);
+      const char *description = descriptions[randomBelow(options.descriptions)];
+      int n = (diseases[patient] == 0) ? 1 : 1 + randomBelow(diseases[patient]);
+
+      switch (function) {
+         case NewDiseaseEnterDescription:
+            printf("NEW_DISEASE_ENTER_DESCRIPTION p%zu %s\n", patient, description);
+            diseases[patient]++;
+            break;
+         case NewDiseaseCopyDescription: {
+            size_t source = sampleZipf(cdf, options.patients);
+            printf("NEW_DISEASE_COPY_DESCRIPTION p%zu p%zu\n", patient, source);
+            if (diseases[source] > 0) {
+               diseases[patient]++;
+            }
+            break;
+         }
+         case ChangeDescription:
+            printf("CHANGE_DESCRIPTION p%zu %d %s\n", patient, n, description);
+            break;
+         case PrintDescription:
+            printf("PRINT_DESCRIPTION p%zu %d\n", patient, n);
+            break;
+         case DeletePatientData:
+            printf("DELETE_PATIENT_DATA p%zu\n", patient);
+            diseases[patient] = 0;
+            break;
+         case SaveSnapshot:
+         case PrintStats:
+            break;
+      }
+   }
+
+   for (size_t i = 0; i < options.descriptions; i++) {
+      free(descriptions[i]);
+   }
+   free(descriptions);
+   free(diseases);
+   free(cdf);
+   return 0;
+}
@@ -0,0 +1,270 @@
+#include <stdlib.h>
+#include <string.h>
+#include "hashmap.h"
+
+// Początkowa liczba pól tablicy (musi być potęgą dwójki).
+#define INITIAL_CAPACITY 64
+
+// Liczba pól starej tablicy przenoszonych przy każdym wstawieniu.
+#define MIGRATION_STEP 16
+
+/* Znacznik pola starej tablicy, którego element został już przeniesiony
+ * albo usunięty. W przeciwieństwie do pustego pola nie przerywa szukania. */
+#define TOMBSTONE ((void *) &tombstoneMarker)
+
+static char tombstoneMarker;
+
+typedef struct Entry {
+   uint64_t hash;
+   void *value; // NULL oznacza puste pole.
+} Entry;
+
+/* Tablica jest alokowana razem ze swoimi polami, więc wątek szukający
+ * bez blokad (hashMapFindConcurrently) odczytuje ją jednym wskaźnikiem. */
+typedef struct Table {
+   size_t capacity; // Potęga dwójki.
+   size_t size;
+   Entry entries[];
+} Table;
+
+struct HashMap {
+   Table *table;
+   /* Tablica, z której trwa przenoszenie elementów do table.
+    * Jeżeli old == NULL, przenoszenie nie trwa. */
+   Table *old;
+   // Elementy z pól old o indeksach mniejszych niż migrated są już przeniesione.
+   size_t migrated;
+   KeyFunction keyOf;
+   // Funkcja zwalniająca tablicę po przeniesieniu elementów (NULL oznacza free).
+   ReleaseFunction release;
+   void *releaseArgument;
+};
+
+static Table *createTable(size_t capacity) {
+   Table *table = calloc(1, sizeof(Table) + capacity * sizeof(Entry));
+   table->capacity = capacity;
+   return table;
+}
+
+/* Wartości pól są zapisywane niepodzielnie, a zapis wartości następuje po zapisie
+ * skrótu, więc wątek szukający bez blokad widzi pole w całości albo puste. */
+static void setValue(Entry *entry, void *value) {
+   __atomic_store_n(&entry->value, value, __ATOMIC_RELEASE);
+}
+
+static bool keyEquals(HashMap *map, Entry *entry, const char *key, size_t length, uint64_t hash) {
+   if (entry->hash != hash) {
+      return false;
+   }
+   size_t entryLength;
+   const char *entryKey = map->keyOf(entry->value, &entryLength);
+   return entryLength == length && memcmp(entryKey, key, length) == 0;
+}
+
+/* Zwraca pole tablicy table z elementem o podanym kluczu.
+ * Jeżeli nie ma takiego elementu, zwraca NULL. */
+static Entry *findInTable(HashMap *map, Table *table, const char *key, size_t length, uint64_t hash) {
+   size_t mask = table->capacity - 1;
+   for (size_t i = hash & mask; table->entries[i].value != NULL; i = (i + 1) & mask) {
+      if (table->entries[i].value != TOMBSTONE && keyEquals(map, &table->entries[i], key, length, hash)) {
+         return &table->entries[i];
+      }
+   }
+   return NULL;
+}
+
+/* Usuwa element z pola entry aktualnej tablicy, przesuwając wstecz
+ * następujące po nim elementy, tak aby nie przerwać ciągów próbkowania. */
+static void removeFromTable(Table *table, Entry *entry) {
+   size_t mask = table->capacity - 1;
+   size_t hole = entry - table->entries;
+   for (size_t i = (hole + 1) & mask; table->entries[i].value != NULL; i = (i + 1) & mask) {
+      size_t home = table->entries[i].hash & mask;
+      // Element z pola i może trafić do dziury, jeżeli home nie leży cyklicznie w (hole, i].
+      if (((i - home) & mask) >= ((i - hole) & mask)) {
+         table->entries[hole].hash = table->entries[i].hash;
+         setValue(&table->entries[hole], table->entries[i].value);
+         hole = i;
+      }
+   }
+   setValue(&table->entries[hole], NULL);
+   table->size--;
+}
+
+static void insertIntoTable(Table *table, void *value, uint64_t hash) {
+   size_t mask = table->capacity - 1;
+   size_t i = hash & mask;
+   while (table->entries[i].value != NULL) {
+      i = (i + 1) & mask;
+   }
+   table->entries[i].hash = hash;
+   setValue(&table->entries[i], value);
+   table->size++;
+}
+
+/* Przenosi co najwyżej steps pól starej tablicy do nowej.
+ * Po przeniesieniu wszystkich zwalnia starą tablicę. */
+static void migrate(HashMap *map, size_t steps) {
+   Table *old = map->old;
+   while (steps > 0 && map->migrated < old->capacity) {
+      Entry *entry = &old->entries[map->migrated];
+      if (entry->value != NULL && entry->value != TOMBSTONE) {
+         // Element jest w nowej tablicy, zanim zniknie ze starej.
+         insertIntoTable(map->table, entry->value, entry->hash);
+         setValue(entry, TOMBSTONE);
+         old->size--;
+      }
+      map->migrated++;
+      steps--;
+   }
+   if (map->migrated == old->capacity) {
+      __atomic_store_n(&map->old, NULL, __ATOMIC_RELEASE);
+      if (map->release != NULL) {
+         map->release(old, map->releaseArgument);
+      }
+      else {
+         free(old);
+      }
+   }
+}
+
+uint64_t hashKey(const char *key, size_t length) {
+   uint64_t hash = 0x9E3779B97F4A7C15ULL ^ length;
+   uint64_t word;
+   while (length >= sizeof(word)) {
+      memcpy(&word, key, sizeof(word));
+      hash = (hash ^ word) * 0xBF58476D1CE4E5B9ULL;
+      hash ^= hash >> 31;
+      key += sizeof(word);
+      length -= sizeof(word);
+   }
+   word = 0;
+   memcpy(&word, key, length);
+   hash = (hash ^ word) * 0x94D049BB133111EBULL;
+   hash ^= hash >> 29;
+   hash *= 0xBF58476D1CE4E5B9ULL;
+   hash ^= hash >> 32;
+   return hash;
+}
+
+HashMap *createHashMap(KeyFunction keyOf) {
+   HashMap *map = malloc(sizeof(HashMap));
+   map->table = createTable(INITIAL_CAPACITY);
+   map->old = NULL;
+   map->migrated = 0;
+   map->keyOf = keyOf;
+   map->release = NULL;
+   map->releaseArgument = NULL;
+   return map;
+}
+
+void deleteHashMap(HashMap *map) {
+   free(map->table);
+   free(map->old);
+   free(map);
+}
+
+void hashMapDeferRelease(HashMap *map, ReleaseFunction release, void *argument) {
+   map->release = release;
+   map->releaseArgument = argument;
+}
+
+size_t hashMapSize(HashMap *map) {
+   return map->table->size + ((map->old == NULL) ? 0 : map->old->size);
+}
+
+void *hashMapFind(HashMap *map, const char *key, size_t length, uint64_t hash) {
+   Entry *entry = findInTable(map, map->table, key, length, hash);
+   if (entry == NULL && map->old != NULL) {
+      entry = findInTable(map, map->old, key, length, hash);
+   }
+   return (entry == NULL) ? NULL : entry->value;
+}
+
+// Jak findInTable, ale dla tablicy zmienianej równocześnie przez inny wątek.
+static void *findConcurrently(HashMap *map, Table *table, const char *key, size_t length, uint64_t hash) {
+   size_t mask = table->capacity - 1;
+   for (size_t i = hash & mask;; i = (i + 1) & mask) {
+      void *value = __atomic_load_n(&table->entries[i].value, __ATOMIC_ACQUIRE);
+      if (value == NULL) {
+         return NULL;
+      }
+      if (value != TOMBSTONE && table->entries[i].hash == hash) {
+         size_t valueLength;
+         const char *valueKey = map->keyOf(value, &valueLength);
+         if (valueLength == length && memcmp(valueKey, key, length) == 0) {
+            return value;
+         }
+      }
+   }
+}
+
+void *hashMapFindConcurrently(HashMap *map, const char *key, size_t length, uint64_t hash) {
+   for (;;) {
+      /* Przenoszony element trafia do nowej tablicy, zanim zniknie ze starej,
+       * więc wystarczy przeszukać starą przed nową. Jeżeli w tym czasie
+       * zaczęło się kolejne przenoszenie, element mógł opuścić table. */
+      Table *table = __atomic_load_n(&map->table, __ATOMIC_ACQUIRE);
+      Table *old = __atomic_load_n(&map->old, __ATOMIC_ACQUIRE);
+      void *value = (old == NULL) ? NULL : findConcurrently(map, old, key, length, hash);
+      if (value == NULL) {
+         value = findConcurrently(map, table, key, length, hash);
+      }
+      if (value != NULL || __atomic_load_n(&map->table, __ATOMIC_ACQUIRE) == table) {
+         return value;
+      }
+   }
+}
+
+void hashMapInsert(HashMap *map, void *value, uint64_t hash) {
+   if (map->old != NULL) {
+      migrate(map, MIGRATION_STEP);
+   }
+   else if (4 * (map->table->size + 1) > 3 * map->table->capacity) {
+      map->migrated = 0;
+      __atomic_store_n(&map->old, map->table, __ATOMIC_RELEASE);
+      __atomic_store_n(&map->table, createTable(2 * map->old->capacity), __ATOMIC_RELEASE);
+   }
+   insertIntoTable(map->table, value, hash);
+}
+
+/* Zwraca pole tablicy table zawierające element value o skrócie hash.
+ * Jeżeli nie ma takiego pola, zwraca NULL. */
+static Entry *findValueInTable(Table *table, void *value, uint64_t hash) {
+   size_t mask = table->capacity - 1;
+   for (size_t i = hash & mask; table->entries[i].value != NULL; i = (i + 1) & mask) {
+      if (table->entries[i].value == value) {
+         return &table->entries[i];
+      }
+   }
+   return NULL;
+}
+
+bool hashMapRemove(HashMap *map, void *value, uint64_t hash) {
+   Entry *entry = findValueInTable(map->table, value, hash);
+   if (entry != NULL) {
+      removeFromTable(map->table, entry);
+      return true;
+   }
+   if (map->old != NULL) {
+      entry = findValueInTable(map->old, value, hash);
+      if (entry != NULL) {
+         setValue(entry, TOMBSTONE);
+         map->old->size--;
+         return true;
+      }
+   }
+   return false;
+}
+
+void hashMapForEach(HashMap *map, VisitFunction visit, void *argument) {
+   Table *tables[] = {map->table, map->old};
+   for (int t = 0; t < 2; t++) {
+      for (size_t i = 0; tables[t] != NULL && i < tables[t]->capacity; i++) {
+         void *value = tables[t]->entries[i].value;
+         if (value != NULL && value != TOMBSTONE) {
+            visit(value, argument);
+         }
+      }
+   }
+}
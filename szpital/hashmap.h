@@ -0,0 +1,69 @@
+#ifndef HASHMAP_H
+#define HASHMAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Tablica mieszająca z adresowaniem otwartym (próbkowanie liniowe).
+ * Przechowuje wskaźniki na elementy, których kluczami są napisy
+ * (wskaźnik na początek i długość, bez wymaganego '\0').
+ *
+ * Gdy tablica zapełni się w 3/4, alokowana jest tablica dwa razy większa,
+ * a elementy przenoszone są do niej stopniowo, po kilka przy każdym
+ * wstawieniu. Dzięki temu żadna pojedyncza operacja nie przepisuje
+ * całej tablicy.
+ *
+ * Tablicę zmienia jeden wątek, ale inne mogą w tym czasie szukać w niej
+ * elementów bez blokad (hashMapFindConcurrently), o ile nic z niej
+ * nie jest usuwane, a stare tablice są zwalniane z opóźnieniem
+ * (hashMapDeferRelease, patrz epoch.h). */
+typedef struct HashMap HashMap;
+
+/* Zwraca klucz elementu value.
+ * Pod adres length zapisuje długość klucza. */
+typedef const char *(*KeyFunction)(const void *value, size_t *length);
+
+// Wywoływana przez hashMapForEach dla każdego elementu tablicy.
+typedef void (*VisitFunction)(void *value, void *argument);
+
+// Zwalnia pamięć memory zaalokowaną przez malloc.
+typedef void (*ReleaseFunction)(void *memory, void *argument);
+
+// Zwraca skrót klucza key o długości length.
+uint64_t hashKey(const char *key, size_t length);
+
+// Alokuje pustą tablicę, której elementy mają klucze zwracane przez keyOf.
+HashMap *createHashMap(KeyFunction keyOf);
+
+// Zwalnia pamięć zajmowaną przez tablicę (ale nie przez jej elementy).
+void deleteHashMap(HashMap *map);
+
+/* Ustawia funkcję, którą tablica będzie zwalniać pamięć starej tablicy
+ * po przeniesieniu z niej elementów (zamiast od razu wywoływać free). */
+void hashMapDeferRelease(HashMap *map, ReleaseFunction release, void *argument);
+
+// Zwraca liczbę elementów w tablicy.
+size_t hashMapSize(HashMap *map);
+
+/* Zwraca element o kluczu key (o długości length i skrócie hash).
+ * Jeżeli nie ma takiego elementu, zwraca NULL. */
+void *hashMapFind(HashMap *map, const char *key, size_t length, uint64_t hash);
+
+/* Jak hashMapFind, ale może być wywoływana przez inny wątek niż ten,
+ * który zmienia tablicę, równocześnie z hashMapInsert (patrz wyżej). */
+void *hashMapFindConcurrently(HashMap *map, const char *key, size_t length, uint64_t hash);
+
+/* Wstawia element value o kluczu ze skrótem hash.
+ * Zakłada, że w tablicy nie ma jeszcze elementu o tym samym kluczu. */
+void hashMapInsert(HashMap *map, void *value, uint64_t hash);
+
+/* Usuwa z tablicy element value, którego klucz ma skrót hash
+ * (elementy są porównywane jako wskaźniki, a nie przez klucze).
+ * Zwraca false, jeżeli value nie było w tablicy. */
+bool hashMapRemove(HashMap *map, void *value, uint64_t hash);
+
+// Wywołuje visit(value, argument) dla każdego elementu tablicy.
+void hashMapForEach(HashMap *map, VisitFunction visit, void *argument);
+
+#endif // HASHMAP_H
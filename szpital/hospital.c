@@ -1,58 +1,278 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include "bulk.h"
+#include "command.h"
+#include "output.h"
 #include "parse.h"
+#include "pipeline.h"
+#include "server.h"
+#include "stats.h"
 #include "structure.h"
 
 const char *ERROR_MESSAGE = "ERROR";
 
+/* Wczytuje z napisu text dodatnią liczbę całkowitą do *number.
+ * Zwraca false, jeżeli text nie jest poprawną liczbą. */
+bool parseNumber(const char *text, size_t *number) {
+   char *end;
+   errno = 0;
+   unsigned long long value = strtoull(text, &end, 10);
+   if (errno != 0 || end == text || *end != '\0' || value == 0 || text[0] == '-') {
+      return false;
+   }
+   *number = value;
+   return true;
+}
+
+// Przed wypisaniem potwierdzeń poleceń zapisuje trwale dziennik database.
+void syncBeforeOutput(void *database) {
+   if (!syncWriteAheadLog(database)) {
+      exitOnFailure(database);
+   }
+}
+
+/* Wypisuje bufory wyjścia, zanim program zacznie czekać na wejście, dzięki
+ * czemu potwierdzenia poleceń (i fsync dziennika) nie czekają na zapełnienie bufora. */
+void flushBeforeRead(void *argument) {
+   outputFlush(standardOutput);
+   outputFlush(errorOutput);
+}
+
+// Wypisuje na stderr raport polecenia STATS (okresowy zrzut statystyk).
+void dumpStatistics(Database *database) {
+   DatabaseStatistics statistics;
+   collectStatistics(database, &statistics);
+   printStatisticsReport(errorOutput, &statistics);
+}
+
+/* Wykonuje polecenia z pliku path (opcja --bulk-load) w threads wątkach,
+ * wypisując odpowiedzi tylko przy printed. Zwraca false, jeżeli pliku
+ * nie da się wczytać. */
+bool loadBulk(const char *path, Database *database, size_t threads, bool printed, bool debug) {
+   // Potwierdzenia poleceń z pliku też wolno wypisać dopiero po zapisaniu dziennika.
+   outputBeforeFlush(standardOutput, syncBeforeOutput, database);
+   bool loaded = bulkLoad(path, database, threads, printed ? standardOutput : NULL, debug);
+   syncBeforeOutput(database);
+   outputFlush(standardOutput);
+   outputFlush(errorOutput);
+   outputBeforeFlush(standardOutput, NULL, NULL);
+   return loaded;
+}
+
+/* Wykonuje polecenia ze standardowego wejścia (opcje jak w main, logging
+ * oznacza włączony dziennik). */
+void processInput(Database *database, bool debug, bool pipelined, bool binary, bool logging,
+                  size_t statsInterval) {
+   bool interactive = isatty(STDIN_FILENO);
+
+   Reader *reader = createReader(STDIN_FILENO);
+   if (binary) {
+      readerUseBinaryProtocol(reader);
+      outputBinaryReplies(standardOutput, true);
+   }
+   if (pipelined) {
+      // Dziennik zapisuje trwale wątek wykonujący, zanim przekaże paczkę do wypisania.
+      runPipeline(reader, database, debug, statsInterval);
+   }
+   else {
+      ParsedInput *input = malloc(sizeof(ParsedInput));
+      if (logging) {
+         outputBeforeFlush(standardOutput, syncBeforeOutput, database);
+         readerBeforeRead(reader, flushBeforeRead, NULL);
+      }
+
+      size_t commands = 0;
+      uint64_t start = startTiming(ParsePhase);
+      while (parseLine(reader, input)) {
+         stopTiming(ParsePhase, start);
+         start = startTiming(ExecutePhase);
+         bool applied = executeCommand(input, database, standardOutput, debug);
+         stopTiming(ExecutePhase, start);
+         countCommand(input->function, applied);
+         if (statsInterval > 0 && ++commands % statsInterval == 0) {
+            dumpStatistics(database);
+         }
+         if (interactive) {
+            outputFlush(standardOutput);
+            outputFlush(errorOutput);
+         }
+         start = startTiming(ParsePhase);
+      }
+
+      free(input);
+   }
+   deleteReader(reader);
+}
+
+/* Opcje programu:
+ * -v  po każdym poleceniu wypisuje na stderr liczbę opisów chorób,
+ * -i  przechowuje opisy o identycznej treści tylko raz,
+ * -s  na koniec wypisuje na stderr statystyki struktury danych,
+ * -p  wczytuje, wykonuje i wypisuje polecenia w trzech osobnych wątkach,
+ * -t LICZBA  jak -p, ale dzieli pacjentów na LICZBA części wykonywanych
+ *    w osobnych wątkach (bez migawek i dziennika),
+ * -b ROZMIAR  ustala rozmiar buforów wyjścia w bajtach,
+ * --load-snapshot PLIK  zaczyna od stanu zapisanego poleceniem SNAPSHOT,
+ * --wal PLIK  zapisuje polecenia modyfikujące do dziennika PLIK przed ich
+ *    potwierdzeniem i na starcie odtwarza stan z dziennika (i migawki PLIK.snapshot),
+ * --wal-limit ROZMIAR  rozmiar dziennika w bajtach, po którym jest kompaktowany,
+ * --stats-interval LICZBA  co LICZBA poleceń wypisuje na stderr raport jak STATS,
+ * --spill PLIK  przenosi długie opisy do pliku tymczasowego PLIK (bez -t),
+ * --spill-threshold ROZMIAR  długość opisu w bajtach, od której jest przenoszony,
+ * --compress  kompresuje opisy w pamięci (rozpakowując je tylko przy wypisaniu),
+ * --dictionary-samples LICZBA  liczba pierwszych opisów, z których powstaje
+ *    słownik kompresji,
+ * --binary  polecenia i odpowiedzi w protokole binarnym (patrz parse.h i output.h),
+ * --server GNIAZDO  zamiast standardowego wejścia obsługuje klientów łączących się
+ *    z gniazdem uniksowym GNIAZDO (patrz server.h), do otrzymania SIGINT albo SIGTERM,
+ * --bulk-load PLIK  przed wczytywaniem wejścia wykonuje polecenia z PLIK
+ *    (w protokole tekstowym), parsując je równolegle (patrz bulk.h; bez -t),
+ * --bulk-threads LICZBA  liczba wątków parsujących PLIK (domyślnie liczba procesorów),
+ * --bulk-output  wypisuje odpowiedzi na polecenia z PLIK (domyślnie są pomijane).
+ * Wyjście jest wypisywane po zapełnieniu bufora, na końcu wejścia
+ * oraz po każdym poleceniu, jeżeli wejście jest terminalem. Z dziennikiem
+ * jest wypisywane również przed każdym oczekiwaniem na wejście, a dziennik
+ * jest zapisywany trwale (jednym fsync dla wielu poleceń) przed wypisaniem. */
 int main(int argc, char **argv) {
    bool debug = false;
+   bool statistics = false;
+   bool pipelined = false;
+   bool binary = false;
+   size_t shards = 1;
+   size_t outputBufferSize = DEFAULT_OUTPUT_BUFFER_SIZE;
+   DatabaseOptions options = {.internDescriptions = false, .shards = 1, .compressDescriptions = false,
+                              .dictionarySamples = DEFAULT_DICTIONARY_SAMPLES};
+   const char *snapshotPath = NULL;
+   const char *logPath = NULL;
+   size_t compactionSize = DEFAULT_LOG_COMPACTION_SIZE;
+   size_t statsInterval = 0;
+   const char *spillPath = NULL;
+   size_t spillThreshold = DEFAULT_SPILL_THRESHOLD;
+   const char *serverPath = NULL;
+   const char *bulkPath = NULL;
+   long processors = sysconf(_SC_NPROCESSORS_ONLN);
+   size_t bulkThreads = (processors > 0 && processors <= MAX_BULK_THREADS) ? processors : 1;
+   bool bulkOutput = false;
 
-   if (argc > 2) {
-      puts(ERROR_MESSAGE);
-      return 1;
-   }
-   else if (argc == 2) {
-      if (strcmp("-v", argv[1]) == 0) {
+   for (int i = 1; i < argc; i++) {
+      if (strcmp("-v", argv[i]) == 0) {
          debug = true;
       }
+      else if (strcmp("-i", argv[i]) == 0) {
+         options.internDescriptions = true;
+      }
+      else if (strcmp("-s", argv[i]) == 0) {
+         statistics = true;
+      }
+      else if (strcmp("-p", argv[i]) == 0) {
+         pipelined = true;
+      }
+      else if (strcmp("-t", argv[i]) == 0 && i + 1 < argc && parseNumber(argv[i + 1], &shards)
+               && shards <= MAX_SHARDS) {
+         pipelined = true;
+         options.shards = shards;
+         i++;
+      }
+      else if (strcmp("-b", argv[i]) == 0 && i + 1 < argc
+               && parseNumber(argv[i + 1], &outputBufferSize)) {
+         i++;
+      }
+      else if (strcmp("--load-snapshot", argv[i]) == 0 && i + 1 < argc) {
+         snapshotPath = argv[++i];
+      }
+      else if (strcmp("--wal", argv[i]) == 0 && i + 1 < argc) {
+         logPath = argv[++i];
+      }
+      else if (strcmp("--wal-limit", argv[i]) == 0 && i + 1 < argc
+               && parseNumber(argv[i + 1], &compactionSize)) {
+         i++;
+      }
+      else if (strcmp("--stats-interval", argv[i]) == 0 && i + 1 < argc
+               && parseNumber(argv[i + 1], &statsInterval)) {
+         i++;
+      }
+      else if (strcmp("--spill", argv[i]) == 0 && i + 1 < argc) {
+         spillPath = argv[++i];
+      }
+      else if (strcmp("--spill-threshold", argv[i]) == 0 && i + 1 < argc
+               && parseNumber(argv[i + 1], &spillThreshold)) {
+         i++;
+      }
+      else if (strcmp("--compress", argv[i]) == 0) {
+         options.compressDescriptions = true;
+      }
+      else if (strcmp("--binary", argv[i]) == 0) {
+         binary = true;
+      }
+      else if (strcmp("--server", argv[i]) == 0 && i + 1 < argc) {
+         serverPath = argv[++i];
+      }
+      else if (strcmp("--bulk-load", argv[i]) == 0 && i + 1 < argc) {
+         bulkPath = argv[++i];
+      }
+      else if (strcmp("--bulk-threads", argv[i]) == 0 && i + 1 < argc
+               && parseNumber(argv[i + 1], &bulkThreads) && bulkThreads <= MAX_BULK_THREADS) {
+         i++;
+      }
+      else if (strcmp("--bulk-output", argv[i]) == 0) {
+         bulkOutput = true;
+      }
+      else if (strcmp("--dictionary-samples", argv[i]) == 0 && i + 1 < argc
+               && parseNumber(argv[i + 1], &options.dictionarySamples)) {
+         i++;
+      }
       else {
          puts(ERROR_MESSAGE);
          return 1;
       }
    }
 
-   Database *database = initializeDatabase();
-
-   ParsedInput *input = malloc(sizeof(ParsedInput));
-   input->atr1 = malloc((MAX_LINE_LENGTH + 1) * sizeof(char));
-   input->atr2 = malloc((MAX_LINE_LENGTH + 1) * sizeof(char));
+   // Stan z dziennika zaczyna się od jego własnej migawki.
+   // Serwer wykonuje polecenia w jednym wątku i tylko w protokole tekstowym.
+   // Odpowiedzi na polecenia z --bulk-load są zawsze w protokole tekstowym.
+   if ((snapshotPath != NULL && logPath != NULL)
+       || (shards > 1 && (snapshotPath != NULL || logPath != NULL || spillPath != NULL || bulkPath != NULL))
+       || (bulkOutput && binary)
+       || (serverPath != NULL && (pipelined || binary))) {
+      puts(ERROR_MESSAGE);
+      return 1;
+   }
 
-   while (parseLine(input)) {
-      switch (input->function) {
-         case NewDiseaseEnterDescription:
-            newDiseaseEnterDescription(input->atr1, input->atr2, database, debug);
-            break;
-         case NewDiseaseCopyDescription:
-            newDiseaseCopyDescription(input->atr1, input->atr2, database, debug);
-            break;
-         case ChangeDescription:
-            changeDescription(input->atr1, input->n, input->atr2, database, debug);
-            break;
-         case PrintDescription:
-            printDescription(input->atr1, input->n, database, debug);
-            break;
-         case DeletePatientData:
-            deletePatientData(input->atr1, database, debug);
-            break;
+   initializeOutput(outputBufferSize);
+   Database *database = initializeDatabase(&options);
+   if ((spillPath != NULL && !spillDescriptions(database, spillPath, spillThreshold))
+       || (snapshotPath != NULL && !loadSnapshot(database, snapshotPath))
+       || (logPath != NULL && !openWriteAheadLog(database, logPath, compactionSize))
+       || (bulkPath != NULL && !loadBulk(bulkPath, database, bulkThreads, bulkOutput, debug))) {
+      puts(ERROR_MESSAGE);
+      deleteDatabase(database);
+      deleteOutput();
+      deleteCommandCounters();
+      return 1;
+   }
+   bool served = true;
+   if (serverPath != NULL) {
+      served = runServer(serverPath, database, debug, statsInterval);
+      if (!served) {
+         puts(ERROR_MESSAGE);
       }
    }
-
-   free(input->atr1);
-   free(input->atr2);
-   free(input);
+   else {
+      processInput(database, debug, pipelined, binary, logPath != NULL, statsInterval);
+   }
+   if (statistics) {
+      printStatistics(database);
+   }
+   outputFlush(standardOutput);
+   outputBeforeFlush(standardOutput, NULL, NULL);
    deleteDatabase(database);
+   deleteOutput();
+   deleteCommandCounters();
 
-   return 0;
+   return served ? 0 : 1;
 }
@@ -0,0 +1,318 @@
+#include <stdlib.h>
+#include <string.h>
+#include "memory.h"
+
+// Rozmiar płyty puli i bloku areny w bajtach.
+#define SLAB_SIZE (64 * 1024)
+
+// Najmniejsza i największa klasa rozmiarów alokatora Heap.
+#define MIN_CLASS_SIZE 16
+#define MAX_CLASS_SIZE 4096
+#define CLASSES 9
+
+/* Liczba obiektów w pierwszym segmencie ObjectTable (potęga dwójki);
+ * kolejne segmenty są dwa razy większe. */
+#define FIRST_SEGMENT_BITS 10
+#define FIRST_SEGMENT_SIZE (1 << FIRST_SEGMENT_BITS)
+
+// Liczba segmentów mieszczących wszystkie 32-bitowe numery.
+#define SEGMENTS (32 - FIRST_SEGMENT_BITS + 1)
+
+__thread MemoryStatistics memoryStatistics;
+
+typedef struct FreeObject {
+   struct FreeObject *next;
+} FreeObject;
+
+struct Pool {
+   size_t objectSize;
+   size_t objectsPerSlab;
+   char **slabs;
+   size_t slabCount, slabCapacity;
+   size_t used; // Liczba obiektów wydanych z ostatniej płyty.
+   FreeObject *freeList;
+};
+
+struct ObjectTable {
+   size_t objectSize;
+   uint32_t limit;
+   // Segmenty są alokowane przy pierwszym użyciu i nigdy nie są przenoszone.
+   char *segments[SEGMENTS];
+   uint32_t used; // Liczba wydanych numerów (również zwolnionych).
+   /* Pierwszy zwolniony numer. Kolejne są zapisane na początku zwolnionych
+    * obiektów, jak w liście wolnych obiektów Pool. */
+   uint32_t freeList;
+};
+
+typedef struct ArenaBlock {
+   struct ArenaBlock *next;
+   size_t used, size;
+   char data[];
+} ArenaBlock;
+
+struct Arena {
+   ArenaBlock *blocks; // Na początku listy jest blok, z którego przydzielamy.
+};
+
+typedef struct LargeObject {
+   struct LargeObject *next, *prev;
+   void *data[];
+} LargeObject;
+
+struct Heap {
+   Pool *classes[CLASSES];
+   LargeObject *large;
+};
+
+void addMemoryStatistics(const MemoryStatistics *statistics) {
+   memoryStatistics.systemAllocations += statistics->systemAllocations;
+   memoryStatistics.systemFrees += statistics->systemFrees;
+   memoryStatistics.poolAllocations += statistics->poolAllocations;
+   memoryStatistics.poolFrees += statistics->poolFrees;
+   memoryStatistics.arenaAllocations += statistics->arenaAllocations;
+}
+
+void *memoryAllocate(size_t size) {
+   memoryStatistics.systemAllocations++;
+   return malloc(size);
+}
+
+void *memoryReallocate(void *pointer, size_t size) {
+   memoryStatistics.systemAllocations++;
+   return realloc(pointer, size);
+}
+
+void memoryFree(void *pointer) {
+   if (pointer != NULL) {
+      memoryStatistics.systemFrees++;
+      free(pointer);
+   }
+}
+
+Pool *createPool(size_t objectSize) {
+   Pool *pool = memoryAllocate(sizeof(Pool));
+   if (objectSize < sizeof(FreeObject)) {
+      objectSize = sizeof(FreeObject);
+   }
+   // Wyrównanie do rozmiaru wskaźnika.
+   pool->objectSize = (objectSize + sizeof(void *) - 1) / sizeof(void *) * sizeof(void *);
+   pool->objectsPerSlab = SLAB_SIZE / pool->objectSize;
+   if (pool->objectsPerSlab == 0) {
+      pool->objectsPerSlab = 1;
+   }
+   pool->slabs = NULL;
+   pool->slabCount = 0;
+   pool->slabCapacity = 0;
+   pool->used = 0;
+   pool->freeList = NULL;
+   return pool;
+}
+
+void deletePool(Pool *pool) {
+   for (size_t i = 0; i < pool->slabCount; i++) {
+      memoryFree(pool->slabs[i]);
+   }
+   memoryFree(pool->slabs);
+   memoryFree(pool);
+}
+
+void *poolAllocate(Pool *pool) {
+   memoryStatistics.poolAllocations++;
+   if (pool->freeList != NULL) {
+      FreeObject *object = pool->freeList;
+      pool->freeList = object->next;
+      return object;
+   }
+   if (pool->slabCount == 0 || pool->used == pool->objectsPerSlab) {
+      if (pool->slabCount == pool->slabCapacity) {
+         pool->slabCapacity = (pool->slabCapacity == 0) ? 16 : 2 * pool->slabCapacity;
+         pool->slabs = memoryReallocate(pool->slabs, pool->slabCapacity * sizeof(char *));
+      }
+      pool->slabs[pool->slabCount++] = memoryAllocate(pool->objectsPerSlab * pool->objectSize);
+      pool->used = 0;
+   }
+   return pool->slabs[pool->slabCount - 1] + pool->objectSize * pool->used++;
+}
+
+void poolFree(Pool *pool, void *object) {
+   memoryStatistics.poolFrees++;
+   FreeObject *freeObject = object;
+   freeObject->next = pool->freeList;
+   pool->freeList = freeObject;
+}
+
+ObjectTable *createObjectTable(size_t objectSize, uint32_t limit) {
+   ObjectTable *table = memoryAllocate(sizeof(ObjectTable));
+   table->objectSize = (objectSize < sizeof(uint32_t)) ? sizeof(uint32_t) : objectSize;
+   table->limit = (limit > NO_OBJECT - 1) ? NO_OBJECT - 1 : limit;
+   memset(table->segments, 0, sizeof(table->segments));
+   table->used = 0;
+   table->freeList = NO_OBJECT;
+   return table;
+}
+
+void deleteObjectTable(ObjectTable *table) {
+   for (int i = 0; i < SEGMENTS; i++) {
+      memoryFree(table->segments[i]);
+   }
+   memoryFree(table);
+}
+
+/* Zapisuje w *offset położenie obiektu index w jego segmencie i zwraca numer
+ * segmentu: segment s zawiera numery od FIRST_SEGMENT_SIZE * (2^s - 1)
+ * do FIRST_SEGMENT_SIZE * (2^(s + 1) - 1) - 1. */
+static int segmentOf(uint32_t index, uint64_t *offset) {
+   uint64_t position = (uint64_t) index + FIRST_SEGMENT_SIZE;
+   int bit = 63 - __builtin_clzll(position);
+   *offset = position - ((uint64_t) 1 << bit);
+   return bit - FIRST_SEGMENT_BITS;
+}
+
+uint32_t tableAllocate(ObjectTable *table) {
+   uint32_t index = table->freeList;
+   if (index != NO_OBJECT) {
+      memcpy(&table->freeList, tableObject(table, index), sizeof(uint32_t));
+   }
+   else {
+      if (table->used == table->limit) {
+         return NO_OBJECT;
+      }
+      index = table->used++;
+      uint64_t offset;
+      int segment = segmentOf(index, &offset);
+      if (offset == 0) {
+         table->segments[segment] = memoryAllocate(((size_t) FIRST_SEGMENT_SIZE << segment) * table->objectSize);
+      }
+   }
+   memoryStatistics.poolAllocations++;
+   return index;
+}
+
+void tableFree(ObjectTable *table, uint32_t index) {
+   memoryStatistics.poolFrees++;
+   memcpy(tableObject(table, index), &table->freeList, sizeof(uint32_t));
+   table->freeList = index;
+}
+
+void *tableObject(const ObjectTable *table, uint32_t index) {
+   uint64_t offset;
+   int segment = segmentOf(index, &offset);
+   return table->segments[segment] + offset * table->objectSize;
+}
+
+Arena *createArena() {
+   Arena *arena = memoryAllocate(sizeof(Arena));
+   arena->blocks = NULL;
+   return arena;
+}
+
+void deleteArena(Arena *arena) {
+   while (arena->blocks != NULL) {
+      ArenaBlock *next = arena->blocks->next;
+      memoryFree(arena->blocks);
+      arena->blocks = next;
+   }
+   memoryFree(arena);
+}
+
+char *arenaAllocate(Arena *arena, size_t size) {
+   memoryStatistics.arenaAllocations++;
+   ArenaBlock *block = arena->blocks;
+   if (block == NULL || block->size - block->used < size) {
+      size_t blockSize = (size > SLAB_SIZE) ? size : SLAB_SIZE;
+      ArenaBlock *newBlock = memoryAllocate(sizeof(ArenaBlock) + blockSize);
+      newBlock->used = 0;
+      newBlock->size = blockSize;
+      if (block != NULL && blockSize > SLAB_SIZE) {
+         // Duży napis dostaje własny blok, a bieżący blok pozostaje na początku listy.
+         newBlock->next = block->next;
+         block->next = newBlock;
+      }
+      else {
+         newBlock->next = block;
+         arena->blocks = newBlock;
+      }
+      block = newBlock;
+   }
+   char *result = block->data + block->used;
+   block->used += size;
+   return result;
+}
+
+// Zwraca indeks najmniejszej klasy rozmiarów mieszczącej size bajtów.
+static int sizeClass(size_t size) {
+   int index = 0;
+   for (size_t classSize = MIN_CLASS_SIZE; classSize < size; classSize *= 2) {
+      index++;
+   }
+   return index;
+}
+
+Heap *createHeap() {
+   Heap *heap = memoryAllocate(sizeof(Heap));
+   for (int i = 0; i < CLASSES; i++) {
+      heap->classes[i] = createPool((size_t) MIN_CLASS_SIZE << i);
+   }
+   heap->large = NULL;
+   return heap;
+}
+
+void deleteHeap(Heap *heap) {
+   for (int i = 0; i < CLASSES; i++) {
+      deletePool(heap->classes[i]);
+   }
+   while (heap->large != NULL) {
+      LargeObject *next = heap->large->next;
+      memoryFree(heap->large);
+      heap->large = next;
+   }
+   memoryFree(heap);
+}
+
+void *heapAllocate(Heap *heap, size_t size) {
+   if (size <= MAX_CLASS_SIZE) {
+      return poolAllocate(heap->classes[sizeClass(size)]);
+   }
+   LargeObject *object = memoryAllocate(sizeof(LargeObject) + size);
+   object->prev = NULL;
+   object->next = heap->large;
+   if (object->next != NULL) {
+      object->next->prev = object;
+   }
+   heap->large = object;
+   return object->data;
+}
+
+void heapFree(Heap *heap, void *object, size_t size) {
+   if (object == NULL) {
+      return;
+   }
+   if (size <= MAX_CLASS_SIZE) {
+      poolFree(heap->classes[sizeClass(size)], object);
+      return;
+   }
+   LargeObject *large = (LargeObject *) ((char *) object - offsetof(LargeObject, data));
+   if (large->prev != NULL) {
+      large->prev->next = large->next;
+   }
+   else {
+      heap->large = large->next;
+   }
+   if (large->next != NULL) {
+      large->next->prev = large->prev;
+   }
+   memoryFree(large);
+}
+
+void *heapReallocate(Heap *heap, void *object, size_t oldSize, size_t newSize) {
+   if (object != NULL && oldSize <= MAX_CLASS_SIZE && newSize <= MAX_CLASS_SIZE
+       && sizeClass(oldSize) == sizeClass(newSize)) {
+      return object;
+   }
+   void *newObject = heapAllocate(heap, newSize);
+   if (object != NULL) {
+      memcpy(newObject, object, (oldSize < newSize) ? oldSize : newSize);
+      heapFree(heap, object, oldSize);
+   }
+   return newObject;
+}
@@ -0,0 +1,105 @@
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Liczniki wywołań malloc/realloc/free wykonanych przez funkcje z tego modułu
+ * oraz liczby obiektów wydanych przez pule. */
+typedef struct MemoryStatistics {
+   size_t systemAllocations; // Wywołania malloc i realloc.
+   size_t systemFrees; // Wywołania free.
+   size_t poolAllocations; // Obiekty wydane przez pule (Pool, Heap i ObjectTable).
+   size_t poolFrees; // Obiekty zwrócone do pul.
+   size_t arenaAllocations; // Napisy zaalokowane w arenach.
+} MemoryStatistics;
+
+/* Aktualne wartości liczników bieżącego wątku (wspólne dla wszystkich pul
+ * i aren, z których korzysta). */
+extern __thread MemoryStatistics memoryStatistics;
+
+// Dodaje statistics do liczników bieżącego wątku (np. liczniki zakończonego wątku).
+void addMemoryStatistics(const MemoryStatistics *statistics);
+
+// malloc, realloc i free zliczane w memoryStatistics.
+void *memoryAllocate(size_t size);
+void *memoryReallocate(void *pointer, size_t size);
+void memoryFree(void *pointer);
+
+/* Pula obiektów o stałym rozmiarze. Obiekty są wydawane z płyt (slabs)
+ * mieszczących wiele obiektów, a zwolnione obiekty trafiają na listę wolnych
+ * i są używane ponownie. Usunięcie puli zwalnia wszystkie płyty naraz. */
+typedef struct Pool Pool;
+
+// Tworzy pulę obiektów o rozmiarze objectSize.
+Pool *createPool(size_t objectSize);
+
+// Zwalnia wszystkie płyty puli (również obiekty, które nie zostały zwrócone).
+void deletePool(Pool *pool);
+
+// Zwraca nowy obiekt z puli.
+void *poolAllocate(Pool *pool);
+
+// Zwraca obiekt object do puli.
+void poolFree(Pool *pool, void *object);
+
+/* Tablica obiektów o stałym rozmiarze, wskazywanych 32-bitowymi numerami
+ * zamiast wskaźników. Obiekty leżą w segmentach, z których każdy kolejny jest
+ * dwa razy większy od poprzedniego, więc tablica rośnie bez przenoszenia
+ * obiektów: adres obiektu nie zmienia się do jego zwolnienia, a obiekt o danym
+ * numerze mogą odczytywać inne wątki równocześnie z dodawaniem nowych.
+ * Numery zwolnionych obiektów są wydawane ponownie. */
+typedef struct ObjectTable ObjectTable;
+
+// Numer, którego tablica nigdy nie wydaje (np. brak obiektu).
+#define NO_OBJECT UINT32_MAX
+
+/* Tworzy tablicę obiektów o rozmiarze objectSize (nie mniejszym niż 4 bajty)
+ * o numerach mniejszych niż limit. */
+ObjectTable *createObjectTable(size_t objectSize, uint32_t limit);
+
+// Zwalnia wszystkie segmenty tablicy.
+void deleteObjectTable(ObjectTable *table);
+
+/* Zwraca numer nowego obiektu z tablicy albo NO_OBJECT,
+ * jeżeli wszystkie numery mniejsze niż limit są zajęte. */
+uint32_t tableAllocate(ObjectTable *table);
+
+// Zwraca obiekt o numerze index do tablicy.
+void tableFree(ObjectTable *table, uint32_t index);
+
+// Zwraca adres obiektu o numerze index.
+void *tableObject(const ObjectTable *table, uint32_t index);
+
+/* Arena: przydziela kolejne fragmenty dużych bloków, przesuwając wskaźnik.
+ * Pojedynczych fragmentów nie da się zwolnić; usunięcie areny zwalnia
+ * wszystkie bloki naraz. */
+typedef struct Arena Arena;
+
+Arena *createArena();
+
+void deleteArena(Arena *arena);
+
+// Zwraca fragment areny o rozmiarze size (bez wyrównania, na napisy).
+char *arenaAllocate(Arena *arena, size_t size);
+
+/* Alokator obiektów o zmiennym rozmiarze: małe obiekty trafiają do pul
+ * klas rozmiarów (potęgi dwójki), większe są alokowane osobno, ale
+ * zapamiętywane na liście, aby usunięcie alokatora mogło je zwolnić. */
+typedef struct Heap Heap;
+
+Heap *createHeap();
+
+// Zwalnia wszystkie pule alokatora oraz wszystkie duże obiekty.
+void deleteHeap(Heap *heap);
+
+// Zwraca obiekt o rozmiarze size.
+void *heapAllocate(Heap *heap, size_t size);
+
+// Zwalnia obiekt object zaalokowany z rozmiarem size.
+void heapFree(Heap *heap, void *object, size_t size);
+
+// Zmienia rozmiar obiektu object z oldSize na newSize, zachowując zawartość.
+void *heapReallocate(Heap *heap, void *object, size_t oldSize, size_t newSize);
+
+#endif // MEMORY_H
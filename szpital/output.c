@@ -0,0 +1,204 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include "output.h"
+#include "stats.h"
+
+// Deskryptor wyjścia do pamięci.
+#define MEMORY_OUTPUT -1
+
+struct Output {
+   int fd; // MEMORY_OUTPUT dla wyjścia do pamięci.
+   char *buffer;
+   size_t size, used;
+   bool binary; // Czy odpowiedzi są wypisywane w protokole binarnym.
+   FlushFunction beforeFlush;
+   void *flushArgument;
+};
+
+Output *standardOutput = NULL;
+Output *errorOutput = NULL;
+
+/* Wypisuje wszystkie bajty z count buforów vector, ponawiając writev po
+ * częściowym zapisie. Przy błędzie zapisu (np. zamknięty potok) porzuca dane. */
+static void writeAll(int fd, struct iovec *vector, int count) {
+   while (count > 0) {
+      ssize_t written = writev(fd, vector, count);
+      if (written < 0) {
+         if (errno == EINTR) {
+            continue;
+         }
+         return;
+      }
+      while (count > 0 && (size_t) written >= vector->iov_len) {
+         written -= vector->iov_len;
+         vector++;
+         count--;
+      }
+      if (count > 0) {
+         vector->iov_base = (char *) vector->iov_base + written;
+         vector->iov_len -= written;
+      }
+   }
+}
+
+// Wypisuje dane z count buforów vector, wywołując wcześniej output->beforeFlush.
+static void writeOutput(Output *output, struct iovec *vector, int count) {
+   if (output->beforeFlush != NULL) {
+      output->beforeFlush(output->flushArgument);
+   }
+   uint64_t start = startTiming(OutputPhase);
+   writeAll(output->fd, vector, count);
+   stopTiming(OutputPhase, start);
+}
+
+void initializeOutput(size_t bufferSize) {
+   standardOutput = createOutput(STDOUT_FILENO, bufferSize);
+   errorOutput = createOutput(STDERR_FILENO, bufferSize);
+}
+
+void deleteOutput() {
+   closeOutput(standardOutput);
+   closeOutput(errorOutput);
+   standardOutput = NULL;
+   errorOutput = NULL;
+}
+
+Output *createOutput(int fd, size_t bufferSize) {
+   Output *output = malloc(sizeof(Output));
+   output->fd = fd;
+   output->size = (bufferSize > 0) ? bufferSize : 1;
+   output->buffer = malloc(output->size);
+   output->used = 0;
+   output->binary = false;
+   output->beforeFlush = NULL;
+   output->flushArgument = NULL;
+   return output;
+}
+
+Output *createMemoryOutput(size_t bufferSize) {
+   return createOutput(MEMORY_OUTPUT, bufferSize);
+}
+
+void closeOutput(Output *output) {
+   outputFlush(output);
+   free(output->buffer);
+   free(output);
+}
+
+void outputBeforeFlush(Output *output, FlushFunction function, void *argument) {
+   output->beforeFlush = function;
+   output->flushArgument = argument;
+}
+
+void outputBinaryReplies(Output *output, bool binary) {
+   output->binary = binary;
+}
+
+const char *outputData(Output *output, size_t *length) {
+   *length = output->used;
+   return output->buffer;
+}
+
+void outputDiscard(Output *output, size_t length) {
+   output->used -= length;
+   memmove(output->buffer, output->buffer + length, output->used);
+}
+
+/* Powiększa bufor wyjścia do pamięci output tak, aby zmieściło się w nim
+ * jeszcze length bajtów. Zwraca false dla zwykłego wyjścia. */
+static bool reserve(Output *output, size_t length) {
+   if (output->fd != MEMORY_OUTPUT) {
+      return false;
+   }
+   while (output->size - output->used < length) {
+      output->size *= 2;
+   }
+   output->buffer = realloc(output->buffer, output->size);
+   return true;
+}
+
+void outputReply(Output *output, ReplyCode code, const char *data, size_t length) {
+   if (!output->binary) {
+      if (code == ReportReply) {
+         outputWrite(output, data, length);
+      }
+      else {
+         outputLine(output, data, length);
+      }
+      return;
+   }
+   char header[16];
+   size_t headerLength = 0;
+   header[headerLength++] = (char) code;
+   if (code == DescriptionReply || code == ReportReply) {
+      size_t value = length;
+      while (value >= 0x80) {
+         header[headerLength++] = (char) (value | 0x80);
+         value >>= 7;
+      }
+      header[headerLength++] = (char) value;
+   }
+   outputWrite(output, header, headerLength);
+   if (code == DescriptionReply || code == ReportReply) {
+      outputWrite(output, data, length);
+   }
+}
+
+void outputWrite(Output *output, const char *data, size_t length) {
+   if (length <= output->size - output->used || reserve(output, length)) {
+      memcpy(output->buffer + output->used, data, length);
+      output->used += length;
+      return;
+   }
+   struct iovec vector[2] = {
+      {.iov_base = output->buffer, .iov_len = output->used},
+      {.iov_base = (char *) data, .iov_len = length}
+   };
+   writeOutput(output, vector, 2);
+   output->used = 0;
+}
+
+void outputLine(Output *output, const char *data, size_t length) {
+   if (length + 1 <= output->size - output->used || reserve(output, length + 1)) {
+      memcpy(output->buffer + output->used, data, length);
+      output->buffer[output->used + length] = '\n';
+      output->used += length + 1;
+      return;
+   }
+   struct iovec vector[3] = {
+      {.iov_base = output->buffer, .iov_len = output->used},
+      {.iov_base = (char *) data, .iov_len = length},
+      {.iov_base = "\n", .iov_len = 1}
+   };
+   writeOutput(output, vector, 3);
+   output->used = 0;
+}
+
+void outputNumberLine(Output *output, const char *label, long long number) {
+   char digits[24];
+   int length = 0;
+   unsigned long long value = (number < 0) ? -(unsigned long long) number : number;
+   do {
+      digits[sizeof(digits) - ++length] = '0' + value % 10;
+      value /= 10;
+   } while (value > 0);
+   if (number < 0) {
+      digits[sizeof(digits) - ++length] = '-';
+   }
+   outputWrite(output, label, strlen(label));
+   outputLine(output, digits + sizeof(digits) - length, length);
+}
+
+void outputFlush(Output *output) {
+   if (output->used > 0 && output->fd != MEMORY_OUTPUT) {
+      struct iovec vector = {.iov_base = output->buffer, .iov_len = output->used};
+      writeOutput(output, &vector, 1);
+      output->used = 0;
+   }
+}
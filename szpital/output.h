@@ -0,0 +1,82 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Domyślny rozmiar bufora wyjścia w bajtach.
+#define DEFAULT_OUTPUT_BUFFER_SIZE (1 << 20)
+
+/* Buforowane wyjście na deskryptor pliku. Krótkie rekordy są kopiowane
+ * do bufora, a bufor jest wypisywany jednym wywołaniem writev, gdy się
+ * zapełni. Rekord, który nie mieści się w buforze, jest wypisywany razem
+ * z zawartością bufora bez kopiowania. */
+typedef struct Output Output;
+
+/* Rodzaje odpowiedzi na polecenia. W protokole binarnym odpowiedź to bajt
+ * o wartości ReplyCode, a po DescriptionReply i ReportReply następuje długość
+ * treści (zapisana jak długości napisów w poleceniach, patrz parse.h) i treść. */
+typedef enum ReplyCode {
+   OkReply,
+   IgnoredReply,
+   DescriptionReply,
+   ReportReply
+} ReplyCode;
+
+// Funkcja wywoływana przed wypisaniem danych z bufora.
+typedef void (*FlushFunction)(void *argument);
+
+// Wyjście standardowe i diagnostyczne programu (tworzone przez initializeOutput).
+extern Output *standardOutput;
+extern Output *errorOutput;
+
+// Tworzy standardOutput i errorOutput z buforami o rozmiarze bufferSize.
+void initializeOutput(size_t bufferSize);
+
+// Wypisuje zawartość buforów i zwalnia standardOutput oraz errorOutput.
+void deleteOutput();
+
+// Tworzy wyjście na deskryptor fd z buforem o rozmiarze bufferSize.
+Output *createOutput(int fd, size_t bufferSize);
+
+/* Tworzy wyjście do pamięci z początkowym buforem o rozmiarze bufferSize.
+ * Jego bufor nigdy nie jest wypisywany, tylko rośnie, a zgromadzone dane
+ * odbiera się przez outputData i outputDiscard (np. aby wysłać je do gniazda
+ * bez blokowania). outputFlush nic dla niego nie robi. */
+Output *createMemoryOutput(size_t bufferSize);
+
+// Wypisuje zawartość bufora output i zwalnia go.
+void closeOutput(Output *output);
+
+/* Zwraca początek danych zgromadzonych w wyjściu do pamięci output,
+ * a pod adres length zapisuje ich długość. */
+const char *outputData(Output *output, size_t *length);
+
+// Usuwa length bajtów z początku danych wyjścia do pamięci output.
+void outputDiscard(Output *output, size_t length);
+
+/* Ustala funkcję wywoływaną z argumentem argument przed każdym wypisaniem
+ * danych z output (NULL ją wyłącza). */
+void outputBeforeFlush(Output *output, FlushFunction function, void *argument);
+
+// Przełącza odpowiedzi wypisywane przez outputReply na protokół binarny.
+void outputBinaryReplies(Output *output, bool binary);
+
+/* Dopisuje do output odpowiedź code z treścią data o długości length.
+ * W protokole tekstowym wypisuje treść, a w wierszu (z wyjątkiem raportu,
+ * który składa się z pełnych wierszy) - komunikat OK/IGNORED albo opis. */
+void outputReply(Output *output, ReplyCode code, const char *data, size_t length);
+
+// Dopisuje do output length bajtów z data.
+void outputWrite(Output *output, const char *data, size_t length);
+
+// Dopisuje do output length bajtów z data oraz znak nowej linii.
+void outputLine(Output *output, const char *data, size_t length);
+
+// Dopisuje do output napis label, liczbę number i znak nowej linii.
+void outputNumberLine(Output *output, const char *label, long long number);
+
+// Wypisuje zawartość bufora output.
+void outputFlush(Output *output);
+
+#endif // OUTPUT_H
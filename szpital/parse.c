@@ -1,43 +1,360 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <limits.h>
 #include <stdbool.h>
-#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include "parse.h"
 
-#define TO_STRING(x) #x
-#define STR(x) TO_STRING(x)
-#define LINE_LIMIT STR(MAX_LINE_LENGTH)
+// Rozmiar bloku wczytywanego jednym wywołaniem read.
+#define READ_BLOCK_SIZE (1 << 20)
+
+const char *FUNCTION_NAMES[FUNCTION_TYPES] = {
+   "NEW_DISEASE_ENTER_DESCRIPTION",
+   "NEW_DISEASE_COPY_DESCRIPTION",
+   "CHANGE_DESCRIPTION",
+   "PRINT_DESCRIPTION",
+   "DELETE_PATIENT_DATA",
+   "SNAPSHOT",
+   "STATS"
+};
+
+struct Reader {
+   int fd;
+   char *buffer;
+   size_t capacity;
+   size_t begin; // Początek pierwszego nieprzetworzonego wiersza.
+   size_t end; // Koniec wczytanych danych.
+   size_t scanned; // W buforze [begin, scanned) nie ma znaku nowej linii.
+   bool eof;
+   bool binary; // Czy wejście jest w protokole binarnym.
+   WaitFunction beforeRead;
+   void *readArgument;
+};
+
+// Zgodnie z %s w scanf białymi znakami są ' ', '\t', '\n', '\v', '\f', '\r'.
+static bool isBlank(char c) {
+   return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+// Pomija białe znaki z [*position, end).
+static void skipBlanks(const char **position, const char *end) {
+   while (*position < end && isBlank(**position)) {
+      (*position)++;
+   }
+}
+
+/* Wczytuje słowo (ciąg znaków niebędących białymi) zaczynające się
+ * po białych znakach od *position. Zwraca false, jeżeli go nie ma. */
+static bool readWord(const char **position, const char *end, StringView *word) {
+   skipBlanks(position, end);
+   word->data = *position;
+   while (*position < end && !isBlank(**position)) {
+      (*position)++;
+   }
+   word->length = *position - word->data;
+   return word->length > 0;
+}
+
+// Wczytuje liczbę całkowitą jak %d w scanf (wartości spoza int są obcinane).
+static bool readNumber(const char **position, const char *end, int *number) {
+   skipBlanks(position, end);
+   const char *digit = *position;
+   bool negative = false;
+   if (digit < end && (*digit == '-' || *digit == '+')) {
+      negative = (*digit == '-');
+      digit++;
+   }
+   if (digit == end || *digit < '0' || *digit > '9') {
+      return false;
+   }
+   long long value = 0;
+   for (; digit < end && *digit >= '0' && *digit <= '9'; digit++) {
+      if (value <= INT_MAX) {
+         value = 10 * value + (*digit - '0');
+      }
+   }
+   if (negative) {
+      value = -value;
+   }
+   *number = (value > INT_MAX) ? INT_MAX : (value < INT_MIN) ? INT_MIN : (int) value;
+   *position = digit;
+   return true;
+}
+
+// Wczytuje resztę wiersza po białych znakach (jak " %[^\n]" w scanf).
+static bool readRest(const char **position, const char *end, StringView *rest) {
+   skipBlanks(position, end);
+   rest->data = *position;
+   rest->length = end - *position;
+   *position = end;
+   return rest->length > 0;
+}
+
+static bool wordEquals(StringView word, const char *keyword) {
+   return word.length == strlen(keyword) && memcmp(word.data, keyword, word.length) == 0;
+}
+
+/* Przesuwa nieprzetworzone dane na początek bufora czytnika i doczytuje
+ * kolejne (jeżeli wejście się skończyło, ustawia reader->eof). */
+static void readMore(Reader *reader) {
+   if (reader->begin > 0) {
+      memmove(reader->buffer, reader->buffer + reader->begin, reader->end - reader->begin);
+      reader->end -= reader->begin;
+      reader->scanned -= reader->begin;
+      reader->begin = 0;
+   }
+   if (reader->end == reader->capacity) {
+      reader->capacity *= 2;
+      reader->buffer = realloc(reader->buffer, reader->capacity);
+   }
+
+   if (reader->beforeRead != NULL) {
+      reader->beforeRead(reader->readArgument);
+   }
+   ssize_t bytes;
+   do {
+      bytes = read(reader->fd, reader->buffer + reader->end, reader->capacity - reader->end);
+   } while (bytes < 0 && errno == EINTR);
+   if (bytes <= 0) {
+      reader->eof = true;
+   }
+   else {
+      reader->end += bytes;
+   }
+}
+
+/* Zwraca kolejny wiersz z bufora czytnika (bez znaku nowej linii),
+ * w razie potrzeby doczytując dane. Zwraca false, jeżeli skończyło się wejście. */
+static bool readLine(Reader *reader, StringView *line) {
+   while (true) {
+      char *newline = memchr(reader->buffer + reader->scanned, '\n', reader->end - reader->scanned);
+      if (newline != NULL) {
+         line->data = reader->buffer + reader->begin;
+         line->length = newline - line->data;
+         reader->begin = reader->scanned = newline - reader->buffer + 1;
+         return true;
+      }
+      reader->scanned = reader->end;
+
+      if (reader->eof) {
+         if (reader->begin == reader->end) {
+            return false;
+         }
+         // Ostatni wiersz bez znaku nowej linii.
+         line->data = reader->buffer + reader->begin;
+         line->length = reader->end - reader->begin;
+         reader->begin = reader->scanned = reader->end;
+         return true;
+      }
+      readMore(reader);
+   }
+}
+
+/* Wynik dekodowania polecenia binarnego (lub jego argumentu). Wyniki są
+ * uporządkowane od najlepszego, a wynikiem polecenia jest najgorszy
+ * z wyników jego argumentów. */
+typedef enum BinaryStatus {
+   CompleteCommand,
+   InvalidCommand, // Polecenie o znanej długości, ale z niepoprawnymi argumentami.
+   IncompleteCommand, // Polecenie urywa się na końcu danych.
+   CorruptInput // Nieznany kod polecenia albo zbyt długi argument.
+} BinaryStatus;
+
+/* Wczytuje liczbę zapisaną po 7 bitów na bajt (od najmniej znaczących,
+ * najstarszy bit oznacza, że liczba ma kolejne bajty). */
+static BinaryStatus readVarint(const char **position, const char *end, size_t *value) {
+   *value = 0;
+   for (int shift = 0; shift < 64; shift += 7) {
+      if (*position == end) {
+         return IncompleteCommand;
+      }
+      unsigned char byte = (unsigned char) *(*position)++;
+      *value |= (size_t) (byte & 0x7F) << shift;
+      if ((byte & 0x80) == 0) {
+         return CompleteCommand;
+      }
+   }
+   return CorruptInput;
+}
+
+// Wczytuje napis poprzedzony długością. Pusty napis jest niepoprawnym argumentem.
+static BinaryStatus readString(const char **position, const char *end, StringView *string) {
+   size_t length;
+   BinaryStatus status = readVarint(position, end, &length);
+   if (status != CompleteCommand) {
+      return status;
+   }
+   if (length > MAX_LINE_LENGTH) {
+      return CorruptInput;
+   }
+   if ((size_t) (end - *position) < length) {
+      return IncompleteCommand;
+   }
+   string->data = *position;
+   string->length = length;
+   *position += length;
+   return (length > 0) ? CompleteCommand : InvalidCommand;
+}
 
-/* Długość nazwy funkcji na wejściu (np. NEW_DISEASE_ENTER_DESCRIPTION)
- * nie będzie dłuższa niż 50. */
-#define MAX_FUNCTION_NAME_LENGTH 50
+// Wczytuje liczbę int zapisaną na 4 bajtach (od najmniej znaczącego).
+static BinaryStatus readInteger(const char **position, const char *end, int *number) {
+   if (end - *position < 4) {
+      return IncompleteCommand;
+   }
+   const unsigned char *bytes = (const unsigned char *) *position;
+   uint32_t value = bytes[0] | (uint32_t) bytes[1] << 8 | (uint32_t) bytes[2] << 16 | (uint32_t) bytes[3] << 24;
+   *number = (value <= INT_MAX) ? (int) value : (int) (value - INT_MAX - 1) + INT_MIN;
+   *position += 4;
+   return CompleteCommand;
+}
 
-bool parseLine(ParsedInput *input) {
-   char functionName[MAX_FUNCTION_NAME_LENGTH + 1];
+static BinaryStatus worseStatus(BinaryStatus a, BinaryStatus b) {
+   return (a > b) ? a : b;
+}
 
-   if (scanf("%" STR(MAX_FUNCTION_NAME_LENGTH) "s", functionName) == EOF) {
+/* Dekoduje polecenie binarne z początku data o długości length. Jeżeli jego
+ * długość jest znana (również dla niepoprawnego polecenia), zapisuje ją
+ * w consumed. Argumenty, których polecenie nie ma, są puste. */
+static BinaryStatus decodeBinaryCommand(const char *data, size_t length, ParsedInput *input, size_t *consumed) {
+   if (length == 0) {
+      return IncompleteCommand;
+   }
+   if ((unsigned char) data[0] >= FUNCTION_TYPES) {
+      return CorruptInput;
+   }
+   const char *position = data + 1;
+   const char *end = data + length;
+   input->function = (FunctionType) data[0];
+   input->n = 0;
+   input->atr1 = input->atr2 = (StringView) {.data = position, .length = 0};
+
+   FunctionType function = input->function;
+   BinaryStatus status = CompleteCommand;
+   if (function != PrintStats) {
+      status = readString(&position, end, &input->atr1);
+   }
+   if ((function == ChangeDescription || function == PrintDescription) && status < IncompleteCommand) {
+      status = worseStatus(status, readInteger(&position, end, &input->n));
+   }
+   if ((function == NewDiseaseEnterDescription || function == NewDiseaseCopyDescription
+        || function == ChangeDescription) && status < IncompleteCommand) {
+      status = worseStatus(status, readString(&position, end, &input->atr2));
+   }
+   *consumed = position - data;
+   return status;
+}
+
+/* Wczytuje kolejne poprawne polecenie w protokole binarnym. Zwraca false
+ * na końcu wejścia, również gdy urywa się ono w środku polecenia albo
+ * zawiera nieznany kod (od którego nie da się odnaleźć granic poleceń). */
+static bool parseBinary(Reader *reader, ParsedInput *input) {
+   while (true) {
+      size_t length = 0;
+      BinaryStatus status = decodeBinaryCommand(reader->buffer + reader->begin, reader->end - reader->begin,
+                                                input, &length);
+      if (status == CompleteCommand || status == InvalidCommand) {
+         reader->begin += length;
+         reader->scanned = reader->begin;
+         if (status == CompleteCommand) {
+            return true;
+         }
+      }
+      else if (status == CorruptInput || reader->eof) {
+         return false;
+      }
+      else {
+         readMore(reader);
+      }
+   }
+}
+
+Reader *createReader(int fd) {
+   Reader *reader = malloc(sizeof(Reader));
+   reader->fd = fd;
+   // Bufor mieści zawsze cały wiersz i jeszcze jeden blok.
+   reader->capacity = READ_BLOCK_SIZE + MAX_LINE_LENGTH + 1;
+   reader->buffer = malloc(reader->capacity);
+   reader->begin = 0;
+   reader->end = 0;
+   reader->scanned = 0;
+   reader->eof = false;
+   reader->binary = false;
+   reader->beforeRead = NULL;
+   reader->readArgument = NULL;
+   return reader;
+}
+
+void readerBeforeRead(Reader *reader, WaitFunction function, void *argument) {
+   reader->beforeRead = function;
+   reader->readArgument = argument;
+}
+
+void readerUseBinaryProtocol(Reader *reader) {
+   reader->binary = true;
+}
+
+void deleteReader(Reader *reader) {
+   free(reader->buffer);
+   free(reader);
+}
+
+bool parseCommand(const char *line, size_t length, ParsedInput *input) {
+   const char *position = line;
+   const char *end = line + length;
+   StringView functionName;
+
+   if (!readWord(&position, end, &functionName)) {
       return false;
    }
 
-   if (strcmp(functionName, "NEW_DISEASE_ENTER_DESCRIPTION") == 0) {
+   if (wordEquals(functionName, "NEW_DISEASE_ENTER_DESCRIPTION")) {
       input->function = NewDiseaseEnterDescription;
-      scanf(" %" LINE_LIMIT "s %" LINE_LIMIT "[^\n]s", input->atr1, input->atr2);
+      return readWord(&position, end, &input->atr1) && readRest(&position, end, &input->atr2);
    }
-   else if (strcmp(functionName, "NEW_DISEASE_COPY_DESCRIPTION") == 0) {
+   else if (wordEquals(functionName, "NEW_DISEASE_COPY_DESCRIPTION")) {
       input->function = NewDiseaseCopyDescription;
-      scanf(" %" LINE_LIMIT "s %" LINE_LIMIT "s", input->atr1, input->atr2);
+      return readWord(&position, end, &input->atr1) && readWord(&position, end, &input->atr2);
    }
-   else if (strcmp(functionName, "CHANGE_DESCRIPTION") == 0) {
+   else if (wordEquals(functionName, "CHANGE_DESCRIPTION")) {
       input->function = ChangeDescription;
-      scanf(" %" LINE_LIMIT "s %d %" LINE_LIMIT "[^\n]s", input->atr1, &input->n, input->atr2);
+      return readWord(&position, end, &input->atr1) && readNumber(&position, end, &input->n)
+             && readRest(&position, end, &input->atr2);
    }
-   else if (strcmp(functionName, "PRINT_DESCRIPTION") == 0) {
+   else if (wordEquals(functionName, "PRINT_DESCRIPTION")) {
       input->function = PrintDescription;
-      scanf(" %" LINE_LIMIT "s %d", input->atr1, &input->n);
+      return readWord(&position, end, &input->atr1) && readNumber(&position, end, &input->n);
    }
-   else if (strcmp(functionName, "DELETE_PATIENT_DATA") == 0) {
+   else if (wordEquals(functionName, "DELETE_PATIENT_DATA")) {
       input->function = DeletePatientData;
-      scanf(" %" LINE_LIMIT "s", input->atr1);
+      return readWord(&position, end, &input->atr1);
+   }
+   else if (wordEquals(functionName, "SNAPSHOT")) {
+      input->function = SaveSnapshot;
+      return readWord(&position, end, &input->atr1);
+   }
+   else if (wordEquals(functionName, "STATS")) {
+      input->function = PrintStats;
+      input->n = 0;
+      input->atr1 = (StringView) {.data = position, .length = 0};
+      return true;
    }
 
-   return true;
+   return false;
+}
+
+bool parseLine(Reader *reader, ParsedInput *input) {
+   if (reader->binary) {
+      return parseBinary(reader, input);
+   }
+   StringView line;
+   while (readLine(reader, &line)) {
+      if (parseCommand(line.data, line.length, input)) {
+         return true;
+      }
+   }
+   return false;
 }
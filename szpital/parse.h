@@ -2,6 +2,7 @@
 #define PARSE_H
 
 #include <stdbool.h>
+#include "view.h"
 
 // Długośc linii na wejściu jest nie dłuższa niż 100 000.
 #define MAX_LINE_LENGTH 100000
@@ -11,18 +12,60 @@ typedef enum FunctionType {
    NewDiseaseCopyDescription,
    ChangeDescription,
    PrintDescription,
-   DeletePatientData
+   DeletePatientData,
+   SaveSnapshot,
+   PrintStats
 } FunctionType;
 
+// Liczba rodzajów poleceń.
+#define FUNCTION_TYPES (PrintStats + 1)
+
+// Nazwy poleceń w kolejności FunctionType.
+extern const char *FUNCTION_NAMES[FUNCTION_TYPES];
+
+/* Argumenty atr1 i atr2 wskazują na bufor, z którego wczytano polecenie,
+ * i są ważne do następnego wczytania. */
 typedef struct ParsedInput {
    FunctionType function;
    int n;
-   char *atr1, *atr2;
+   StringView atr1, atr2;
 } ParsedInput;
 
+/* Czytnik wejścia: wczytuje z deskryptora pliku duże bloki do bufora
+ * i wydziela z nich kolejne wiersze bez kopiowania. */
+typedef struct Reader Reader;
+
+// Funkcja wywoływana przed doczytaniem danych.
+typedef void (*WaitFunction)(void *argument);
+
+// Tworzy czytnik danych z deskryptora pliku fd.
+Reader *createReader(int fd);
+
+/* Ustala funkcję wywoływaną z argumentem argument przed każdym doczytaniem
+ * danych, czyli zanim czytnik może czekać na wejście (NULL ją wyłącza). */
+void readerBeforeRead(Reader *reader, WaitFunction function, void *argument);
+
+/* Przełącza czytnik na protokół binarny. Każde polecenie zaczyna się
+ * bajtem o wartości FunctionType, po którym następują jego argumenty
+ * w kolejności jak w protokole tekstowym: napisy poprzedzone długością
+ * zapisaną po 7 bitów na bajt (od najmniej znaczących, najstarszy bit
+ * oznacza kolejny bajt), a liczba n na 4 bajtach (od najmniej znaczącego). */
+void readerUseBinaryProtocol(Reader *reader);
+
+// Zwalnia pamięć zajmowaną przez czytnik (nie zamyka deskryptora).
+void deleteReader(Reader *reader);
+
+/* Parsuje polecenie z wiersza line o długości length (bez znaku nowej linii).
+ * Zwraca false, jeżeli wiersz nie zawiera poprawnego polecenia. */
+bool parseCommand(const char *line, size_t length, ParsedInput *input);
+
 /* Zwraca false, jeżeli wczytano EOF.
- * W przeciwnym przypadku zwraca true, parsuje jeden wiersz z wejścia i
- * umieszcza wczytane informacje w strukturze input. */
-bool parseLine(ParsedInput *input);
+ * W przeciwnym przypadku zwraca true, parsuje jeden wiersz z wejścia
+ * (albo jedno polecenie w protokole binarnym) i umieszcza wczytane
+ * informacje w strukturze input. Wiersze puste i niezawierające poprawnego
+ * polecenia są pomijane, podobnie jak polecenia binarne z pustym napisem.
+ * Polecenie binarne o nieznanym kodzie, napisie dłuższym niż MAX_LINE_LENGTH
+ * albo urwane kończy wejście. */
+bool parseLine(Reader *reader, ParsedInput *input);
 
 #endif // PARSE_H
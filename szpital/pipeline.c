@@ -0,0 +1,577 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include "command.h"
+#include "database.h"
+#include "hashmap.h"
+#include "output.h"
+#include "pipeline.h"
+#include "stats.h"
+
+// Największa liczba poleceń w jednej paczce.
+#define BATCH_SIZE 1024
+
+// Paczka jest przekazywana dalej, gdy argumenty jej poleceń zajmą tyle bajtów.
+#define BATCH_TEXT_LIMIT (256 * 1024)
+
+// Liczba paczek krążących między wątkami.
+#define BATCHES 8
+
+// Pojemność kolejki (potęga dwójki, nie mniejsza niż BATCHES, więc kolejka nigdy się nie zapełnia).
+#define RING_SIZE 8
+
+// Liczba prób pobrania paczki z kolejki przed zaśnięciem wątku.
+#define SPIN_LIMIT 256
+
+// Rozmiar linii pamięci podręcznej, na których leżą osobno indeksy kolejki.
+#define CACHE_LINE_SIZE 64
+
+/* Polecenie w paczce. Argumenty są zapisane w tekście paczki
+ * (jako przesunięcia, bo tekst może zostać powiększony). */
+typedef struct Command {
+   FunctionType function;
+   int n; // Dla STATS: 1, jeżeli to okresowy raport (na stderr) dodany przez wątek wczytujący.
+   size_t atr1, atr1Length;
+   size_t atr2, atr2Length;
+   uint32_t shard; // Część, do której należy pacjent atr1 (wykonująca polecenie).
+   uint32_t sourceShard; // Część, do której należy pacjent atr2 w NEW_DISEASE_COPY_DESCRIPTION.
+} Command;
+
+typedef enum ResultType {
+   OkResult,
+   IgnoredResult,
+   TextResult,
+   StatsResult // Raport z batch->statistics.
+} ResultType;
+
+/* Wynik polecenia: komunikat albo opis choroby zapisany w wyjściu paczki
+ * części, która wykonała polecenie. */
+typedef struct Result {
+   ResultType type;
+   size_t text, length;
+   /* Zmiana licznika opisów części wykonującej polecenie (bez chorób
+    * współdzielonych, które liczy wątek wypisujący). Wątek wypisujący
+    * zamienia ją na liczbę wszystkich opisów po wykonaniu polecenia. */
+   int descriptions;
+   /* Choroba skopiowana przez NEW_DISEASE_COPY_DESCRIPTION z innej części
+    * i znacznik, że część źródłowa już ją tu wpisała. */
+   DiseaseHandle transfer;
+   int ready;
+} Result;
+
+typedef struct Buffer {
+   char *data;
+   size_t used, size;
+} Buffer;
+
+/* Paczka poleceń. Paczki krążą między wątkami: wczytujący wypełnia commands
+ * i text, wykonujące - results i swoje bufory outputs, a wypisujący oddaje
+ * pustą paczkę wczytującemu. */
+typedef struct Batch {
+   Command commands[BATCH_SIZE];
+   Result results[BATCH_SIZE];
+   int count;
+   bool last; // Czy to ostatnia paczka (po niej nie ma już poleceń).
+   Buffer text;
+   Buffer *outputs; // Opisy wypisywane przez polecenia, osobno dla każdej części.
+   Buffer *events; // Zmiany referencji chorób współdzielonych (ReferenceEvent) z każdej części.
+   /* Statystyki każdej części dla polecenia STATS, które zawsze kończy paczkę,
+    * żeby części zebrały je po tym samym poleceniu. */
+   DatabaseStatistics *statistics;
+} Batch;
+
+/* Kolejka paczek z jednym producentem i jednym konsumentem. Przekazanie paczki
+ * nie wymaga blokady; konsument zasypia na zmiennej warunkowej dopiero wtedy,
+ * gdy kolejka jest pusta przez SPIN_LIMIT prób. */
+typedef struct Ring {
+   Batch *slots[RING_SIZE];
+   size_t head; // Zmieniane tylko przez konsumenta.
+   char padding[CACHE_LINE_SIZE];
+   size_t tail; // Zmieniane tylko przez producenta.
+   char padding2[CACHE_LINE_SIZE];
+   int waiting; // Czy konsument czeka na zmiennej warunkowej.
+   pthread_mutex_t mutex;
+   pthread_cond_t condition;
+} Ring;
+
+// Wątek wykonujący polecenia pacjentów jednej części struktury.
+typedef struct Worker {
+   Database *database;
+   uint32_t shard;
+   Ring input, output;
+   pthread_t thread;
+   MemoryStatistics statistics; // Liczniki pamięci wątku po jego zakończeniu.
+} Worker;
+
+/* Liczba referencji do choroby współdzielonej przez części, zmieniana
+ * przez wątek wypisujący w kolejności poleceń. Dzięki temu opis przestaje
+ * być liczony przy tym samym poleceniu, co przy wykonaniu w jednym wątku,
+ * niezależnie od tego, która część pierwsza usunie swoje wpisy. */
+typedef struct SharedDisease {
+   DiseaseHandle disease;
+   int references;
+} SharedDisease;
+
+typedef struct Pipeline {
+   Ring empty;
+   Worker workers[MAX_SHARDS];
+   uint32_t shards;
+   Batch *current; // Paczka wypełniana przez wątek wczytujący.
+   int descriptions; // Liczba opisów przed wykonaniem pierwszego polecenia.
+   HashMap *sharedDiseases;
+   int sharedRemoved; // Liczba usuniętych opisów chorób współdzielonych.
+   bool debug;
+   size_t statsInterval, commands;
+} Pipeline;
+
+static void initializeRing(Ring *ring) {
+   ring->head = 0;
+   ring->tail = 0;
+   ring->waiting = 0;
+   pthread_mutex_init(&ring->mutex, NULL);
+   pthread_cond_init(&ring->condition, NULL);
+}
+
+static void destroyRing(Ring *ring) {
+   pthread_mutex_destroy(&ring->mutex);
+   pthread_cond_destroy(&ring->condition);
+}
+
+static void ringPush(Ring *ring, Batch *batch) {
+   size_t tail = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+   ring->slots[tail % RING_SIZE] = batch;
+   __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+   // Bariera parą do bariery w ringPop: konsument zobaczy paczkę albo my zobaczymy, że czeka.
+   __atomic_thread_fence(__ATOMIC_SEQ_CST);
+   if (__atomic_load_n(&ring->waiting, __ATOMIC_RELAXED)) {
+      pthread_mutex_lock(&ring->mutex);
+      pthread_cond_signal(&ring->condition);
+      pthread_mutex_unlock(&ring->mutex);
+   }
+}
+
+// Zwraca pierwszą paczkę z kolejki albo NULL, jeżeli kolejka jest pusta.
+static Batch *ringTryPop(Ring *ring) {
+   size_t head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+   if (head == __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE)) {
+      return NULL;
+   }
+   Batch *batch = ring->slots[head % RING_SIZE];
+   __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+   return batch;
+}
+
+// Zwraca pierwszą paczkę z kolejki, czekając na nią, jeżeli kolejka jest pusta.
+static Batch *ringPop(Ring *ring) {
+   Batch *batch;
+   for (int i = 0; i < SPIN_LIMIT; i++) {
+      if ((batch = ringTryPop(ring)) != NULL) {
+         return batch;
+      }
+      sched_yield();
+   }
+   pthread_mutex_lock(&ring->mutex);
+   __atomic_store_n(&ring->waiting, 1, __ATOMIC_RELAXED);
+   __atomic_thread_fence(__ATOMIC_SEQ_CST);
+   while ((batch = ringTryPop(ring)) == NULL) {
+      pthread_cond_wait(&ring->condition, &ring->mutex);
+   }
+   __atomic_store_n(&ring->waiting, 0, __ATOMIC_RELAXED);
+   pthread_mutex_unlock(&ring->mutex);
+   return batch;
+}
+
+static Batch *createBatch(uint32_t shards) {
+   Batch *batch = malloc(sizeof(Batch));
+   batch->count = 0;
+   batch->last = false;
+   batch->text.size = BATCH_TEXT_LIMIT;
+   batch->text.data = malloc(batch->text.size);
+   batch->text.used = 0;
+   batch->outputs = malloc(shards * sizeof(Buffer));
+   batch->events = malloc(shards * sizeof(Buffer));
+   batch->statistics = malloc(shards * sizeof(DatabaseStatistics));
+   for (uint32_t i = 0; i < shards; i++) {
+      batch->outputs[i].size = BATCH_TEXT_LIMIT / shards;
+      batch->outputs[i].data = malloc(batch->outputs[i].size);
+      batch->outputs[i].used = 0;
+      batch->events[i].size = 64 * sizeof(ReferenceEvent);
+      batch->events[i].data = malloc(batch->events[i].size);
+      batch->events[i].used = 0;
+   }
+   return batch;
+}
+
+static void deleteBatch(Batch *batch, uint32_t shards) {
+   free(batch->text.data);
+   for (uint32_t i = 0; i < shards; i++) {
+      free(batch->outputs[i].data);
+      free(batch->events[i].data);
+   }
+   free(batch->outputs);
+   free(batch->events);
+   free(batch->statistics);
+   free(batch);
+}
+
+// Dopisuje length bajtów z data do bufora, powiększając go w razie potrzeby.
+static size_t appendText(Buffer *buffer, const char *data, size_t length) {
+   if (buffer->size - buffer->used < length) {
+      while (buffer->size - buffer->used < length) {
+         buffer->size *= 2;
+      }
+      buffer->data = realloc(buffer->data, buffer->size);
+   }
+   size_t offset = buffer->used;
+   memcpy(buffer->data + offset, data, length);
+   buffer->used += length;
+   return offset;
+}
+
+static StringView textView(Batch *batch, size_t offset, size_t length) {
+   return (StringView) {.data = batch->text.data + offset, .length = length};
+}
+
+// Zwraca część, do której należy pacjent o nazwisku name.
+static uint32_t shardOf(StringView name, uint32_t shards) {
+   if (shards == 1) {
+      return 0;
+   }
+   // Górne bity skrótu, bo dolne wybierają pole w tablicy pacjentów części.
+   return (hashKey(name.data, name.length) >> 32) % shards;
+}
+
+// Wątek wczytujący przekazuje wypełnianą paczkę do wykonania i bierze następną.
+static void publishBatch(Pipeline *pipeline, bool last) {
+   pipeline->current->last = last;
+   for (uint32_t i = 0; i < pipeline->shards; i++) {
+      ringPush(&pipeline->workers[i].input, pipeline->current);
+   }
+   pipeline->current = last ? NULL : ringPop(&pipeline->empty);
+}
+
+// Przed czekaniem na wejście przekazuje dalej zebrane polecenia, żeby nie czekały na nowe.
+static void publishBeforeRead(void *argument) {
+   Pipeline *pipeline = argument;
+   if (pipeline->current->count > 0) {
+      publishBatch(pipeline, false);
+   }
+}
+
+static void addCommand(Pipeline *pipeline, ParsedInput *input) {
+   Batch *batch = pipeline->current;
+   Result *result = &batch->results[batch->count];
+   Command *command = &batch->commands[batch->count++];
+   command->function = input->function;
+   command->n = input->n;
+   command->atr1Length = input->atr1.length;
+   command->atr1 = appendText(&batch->text, input->atr1.data, input->atr1.length);
+   command->atr2Length = 0;
+   command->atr2 = 0;
+   if (input->function == NewDiseaseEnterDescription || input->function == NewDiseaseCopyDescription
+       || input->function == ChangeDescription) {
+      command->atr2Length = input->atr2.length;
+      command->atr2 = appendText(&batch->text, input->atr2.data, input->atr2.length);
+   }
+   command->shard = shardOf(input->atr1, pipeline->shards);
+   command->sourceShard = command->shard;
+   if (input->function == NewDiseaseCopyDescription) {
+      command->sourceShard = shardOf(input->atr2, pipeline->shards);
+   }
+   result->ready = 0;
+
+   if (batch->count == BATCH_SIZE || batch->text.used >= BATCH_TEXT_LIMIT
+       || input->function == PrintStats) {
+      publishBatch(pipeline, false);
+   }
+   if (input->function != PrintStats || input->n == 0) {
+      pipeline->commands++;
+      if (pipeline->statsInterval > 0 && pipeline->commands % pipeline->statsInterval == 0) {
+         ParsedInput dump = {.function = PrintStats, .n = 1, .atr1 = input->atr1};
+         dump.atr1.length = 0;
+         addCommand(pipeline, &dump);
+      }
+   }
+}
+
+static ResultType executeBatchCommand(Batch *batch, Command *command, Result *result, Database *database) {
+   StringView atr1 = textView(batch, command->atr1, command->atr1Length);
+   StringView atr2 = textView(batch, command->atr2, command->atr2Length);
+   Mutation mutation = {.n = command->n, .atr1 = atr1, .atr2 = atr2};
+   StringView description;
+
+   switch (command->function) {
+      case NewDiseaseEnterDescription:
+         mutation.type = EnterDescriptionMutation;
+         break;
+      case NewDiseaseCopyDescription:
+         if (command->sourceShard != command->shard) {
+            // Chorobę odczytuje część pacjenta atr2, gdy dojdzie do tego polecenia.
+            while (!__atomic_load_n(&result->ready, __ATOMIC_ACQUIRE)) {
+               sched_yield();
+            }
+            if (result->transfer == NO_DISEASE) {
+               return IgnoredResult;
+            }
+            applyCopiedDisease(atr1, result->transfer, database);
+            return OkResult;
+         }
+         mutation.type = CopyDescriptionMutation;
+         break;
+      case ChangeDescription:
+         mutation.type = ChangeDescriptionMutation;
+         break;
+      case DeletePatientData:
+         mutation.type = DeletePatientMutation;
+         break;
+      case PrintDescription:
+         if (!applyPrintDescription(atr1, command->n, database, &description)) {
+            return IgnoredResult;
+         }
+         // Opis może zostać zmieniony przez następne polecenia, więc jest kopiowany.
+         result->length = description.length;
+         result->text = appendText(&batch->outputs[command->shard], description.data, description.length);
+         return TextResult;
+      case SaveSnapshot:
+         return applySaveSnapshot(atr1, database) ? OkResult : IgnoredResult;
+      case PrintStats:
+         // Statystyki zbiera każda część w executeBatches.
+         return StatsResult;
+   }
+   return applyMutation(&mutation, database) ? OkResult : IgnoredResult;
+}
+
+/* Wykonuje polecenia pacjentów części worker->shard z kolejnych paczek,
+ * a dla poleceń NEW_DISEASE_COPY_DESCRIPTION innych części odczytuje
+ * chorobę kopiowaną od pacjenta tej części. */
+static void *executeBatches(void *argument) {
+   Worker *worker = argument;
+   Database *database = worker->database;
+   bool last = false;
+   while (!last) {
+      Batch *batch = ringPop(&worker->input);
+      freeRemoteDiseases(database);
+      batch->outputs[worker->shard].used = 0;
+      for (int i = 0; i < batch->count; i++) {
+         Command *command = &batch->commands[i];
+         Result *result = &batch->results[i];
+         database->command = i;
+         if (command->function == PrintStats) {
+            memset(&batch->statistics[worker->shard], 0, sizeof(DatabaseStatistics));
+            addShardStatistics(database, &batch->statistics[worker->shard]);
+         }
+         if (command->sourceShard == worker->shard && command->shard != worker->shard) {
+            result->transfer = acquireLastDisease(textView(batch, command->atr2, command->atr2Length), database);
+            __atomic_store_n(&result->ready, 1, __ATOMIC_RELEASE);
+         }
+         if (command->shard == worker->shard) {
+            int descriptions = database->descriptions;
+            uint64_t start = startTiming(ExecutePhase);
+            result->type = executeBatchCommand(batch, command, result, database);
+            stopTiming(ExecutePhase, start);
+            result->descriptions = database->descriptions - descriptions;
+         }
+      }
+      Buffer *events = &batch->events[worker->shard];
+      events->used = 0;
+      if (database->eventCount > 0) {
+         appendText(events, (const char *) database->events, database->eventCount * sizeof(ReferenceEvent));
+         database->eventCount = 0;
+      }
+      /* Potwierdzenia z paczki zostaną wypisane dopiero po zapisaniu trwale dziennika.
+       * Po błędzie struktury paczka nie jest wypisywana wcale. */
+      if (!syncWriteAheadLog(database)) {
+         exitOnFailure(database);
+      }
+      last = batch->last;
+      ringPush(&worker->output, batch);
+   }
+   worker->statistics = memoryStatistics;
+   return NULL;
+}
+
+// Zwraca paczkę z kolejki ring, wypisując bufory wyjścia, zanim zacznie na nią czekać.
+static Batch *popFlushing(Ring *ring) {
+   Batch *batch = ringTryPop(ring);
+   if (batch == NULL) {
+      outputFlush(standardOutput);
+      outputFlush(errorOutput);
+      batch = ringPop(ring);
+   }
+   return batch;
+}
+
+static const char *sharedDiseaseKey(const void *value, size_t *length) {
+   const SharedDisease *shared = value;
+   *length = sizeof(DiseaseHandle);
+   return (const char *) &shared->disease;
+}
+
+/* Uwzględnia zmiany referencji chorób współdzielonych zgłoszone przez
+ * polecenie command paczki batch, a choroby bez referencji oddaje do
+ * zwolnienia ich częściom. Zwraca zmianę liczby opisów. Zdarzenia każdej
+ * części są uporządkowane według poleceń, a positions wskazuje pierwsze
+ * jeszcze nieuwzględnione. */
+static int applyReferences(Pipeline *pipeline, Batch *batch, int command, size_t *positions) {
+   int descriptions = 0;
+   for (uint32_t i = 0; i < pipeline->shards; i++) {
+      ReferenceEvent *events = (ReferenceEvent *) batch->events[i].data;
+      size_t count = batch->events[i].used / sizeof(ReferenceEvent);
+      for (; positions[i] < count && events[positions[i]].command == command; positions[i]++) {
+         ReferenceEvent *event = &events[positions[i]];
+         uint64_t hash = hashKey((const char *) &event->disease, sizeof(DiseaseHandle));
+         SharedDisease *shared = hashMapFind(pipeline->sharedDiseases, (const char *) &event->disease,
+                                             sizeof(DiseaseHandle), hash);
+         if (shared == NULL) {
+            shared = malloc(sizeof(SharedDisease));
+            shared->disease = event->disease;
+            shared->references = 0;
+            hashMapInsert(pipeline->sharedDiseases, shared, hash);
+         }
+         shared->references += event->delta;
+         if (shared->references == 0) {
+            hashMapRemove(pipeline->sharedDiseases, shared, hash);
+            freeSharedDisease(shared->disease, pipeline->workers[0].database);
+            free(shared);
+            descriptions--;
+         }
+      }
+   }
+   return descriptions;
+}
+
+static void freeSharedEntry(void *value, void *argument) {
+   free(value);
+}
+
+/* Wypisuje raport polecenia STATS z batch, w którym liczba opisów
+ * (descriptions) uwzględnia choroby współdzielone. Pamięć opisów chorób
+ * współdzielonych jest odejmowana dopiero wtedy, gdy zwolni je ich część
+ * (na początku następnej paczki), więc może być chwilowo większa niż
+ * przy wykonaniu w jednym wątku. */
+static void printStatsResult(Pipeline *pipeline, Batch *batch, Output *output, int descriptions) {
+   DatabaseStatistics statistics;
+   memset(&statistics, 0, sizeof(DatabaseStatistics));
+   for (uint32_t i = 0; i < pipeline->shards; i++) {
+      statistics.patients += batch->statistics[i].patients;
+      statistics.descriptionBytes += batch->statistics[i].descriptionBytes;
+      statistics.sharedBytes += batch->statistics[i].sharedBytes;
+      statistics.spilledBytes += batch->statistics[i].spilledBytes;
+      statistics.compressedTextBytes += batch->statistics[i].compressedTextBytes;
+      statistics.compressedBytes += batch->statistics[i].compressedBytes;
+      statistics.historyEntries += batch->statistics[i].historyEntries;
+   }
+   statistics.descriptions = descriptions;
+   printStatisticsReport(output, &statistics);
+}
+
+static void *printBatches(void *argument) {
+   Pipeline *pipeline = argument;
+   int descriptions = pipeline->descriptions;
+   bool last = false;
+   while (!last) {
+      // Paczka jest gotowa, gdy skończą ją wszystkie części.
+      Batch *batch = NULL;
+      for (uint32_t i = 0; i < pipeline->shards; i++) {
+         batch = popFlushing(&pipeline->workers[i].output);
+      }
+      size_t positions[MAX_SHARDS] = {0};
+      for (int i = 0; i < batch->count; i++) {
+         Result *result = &batch->results[i];
+         int removed = applyReferences(pipeline, batch, i, positions);
+         pipeline->sharedRemoved -= removed;
+         descriptions += removed;
+         Command *command = &batch->commands[i];
+         descriptions += result->descriptions;
+         if (result->type == StatsResult && command->n == 1) {
+            printStatsResult(pipeline, batch, errorOutput, descriptions);
+            continue;
+         }
+         if (result->type == TextResult) {
+            Buffer *output = &batch->outputs[command->shard];
+            outputReply(standardOutput, DescriptionReply, output->data + result->text, result->length);
+         }
+         else if (result->type == StatsResult) {
+            printStatsResult(pipeline, batch, standardOutput, descriptions);
+         }
+         else {
+            printAcknowledgement(standardOutput, result->type == OkResult);
+         }
+         if (pipeline->debug) {
+            outputNumberLine(errorOutput, "DESCRIPTIONS: ", descriptions);
+         }
+         countCommand(command->function, result->type != IgnoredResult);
+      }
+      batch->count = 0;
+      batch->text.used = 0;
+      last = batch->last;
+      ringPush(&pipeline->empty, batch);
+   }
+   return NULL;
+}
+
+void runPipeline(Reader *reader, Database *database, bool debug, size_t statsInterval) {
+   Pipeline *pipeline = malloc(sizeof(Pipeline));
+   pipeline->shards = (database->shards == NULL) ? 1 : database->shardCount;
+   pipeline->debug = debug;
+   pipeline->statsInterval = statsInterval;
+   pipeline->commands = 0;
+   pipeline->descriptions = 0;
+   pipeline->sharedDiseases = createHashMap(sharedDiseaseKey);
+   pipeline->sharedRemoved = 0;
+   initializeRing(&pipeline->empty);
+   for (uint32_t i = 0; i < pipeline->shards; i++) {
+      Worker *worker = &pipeline->workers[i];
+      worker->database = (database->shards == NULL) ? database : database->shards[i];
+      worker->shard = i;
+      initializeRing(&worker->input);
+      initializeRing(&worker->output);
+      pipeline->descriptions += worker->database->descriptions;
+   }
+   Batch *batches[BATCHES];
+   for (int i = 0; i < BATCHES; i++) {
+      batches[i] = createBatch(pipeline->shards);
+      ringPush(&pipeline->empty, batches[i]);
+   }
+
+   pthread_t printer;
+   for (uint32_t i = 0; i < pipeline->shards; i++) {
+      pthread_create(&pipeline->workers[i].thread, NULL, executeBatches, &pipeline->workers[i]);
+   }
+   pthread_create(&printer, NULL, printBatches, pipeline);
+
+   pipeline->current = ringPop(&pipeline->empty);
+   readerBeforeRead(reader, publishBeforeRead, pipeline);
+   ParsedInput input;
+   uint64_t start = startTiming(ParsePhase);
+   while (parseLine(reader, &input)) {
+      addCommand(pipeline, &input);
+      stopTiming(ParsePhase, start);
+      start = startTiming(ParsePhase);
+   }
+   readerBeforeRead(reader, NULL, NULL);
+   publishBatch(pipeline, true);
+
+   for (uint32_t i = 0; i < pipeline->shards; i++) {
+      Worker *worker = &pipeline->workers[i];
+      pthread_join(worker->thread, NULL);
+      addMemoryStatistics(&worker->statistics);
+   }
+   pthread_join(printer, NULL);
+   // Liczniki części nie uwzględniają usuniętych chorób współdzielonych.
+   pipeline->workers[0].database->descriptions -= pipeline->sharedRemoved;
+   hashMapForEach(pipeline->sharedDiseases, freeSharedEntry, NULL);
+   deleteHashMap(pipeline->sharedDiseases);
+   for (uint32_t i = 0; i < pipeline->shards; i++) {
+      destroyRing(&pipeline->workers[i].input);
+      destroyRing(&pipeline->workers[i].output);
+   }
+   for (int i = 0; i < BATCHES; i++) {
+      deleteBatch(batches[i], pipeline->shards);
+   }
+   destroyRing(&pipeline->empty);
+   free(pipeline);
+}
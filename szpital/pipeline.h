@@ -0,0 +1,19 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stdbool.h>
+#include "parse.h"
+#include "structure.h"
+
+// Największa liczba części struktury danych w runPipeline.
+#define MAX_SHARDS 64
+
+/* Wykonuje polecenia z reader na database w osobnych wątkach: wczytywania,
+ * wykonywania i wypisywania poleceń, połączonych kolejkami paczek poleceń.
+ * Jeżeli database jest podzielona na części, polecenia każdej części wykonuje
+ * osobny wątek. Wyjście jest identyczne z wykonaniem poleceń po kolei
+ * w jednym wątku. Jeżeli statsInterval > 0, co statsInterval poleceń
+ * wypisuje na stderr raport jak polecenie STATS. */
+void runPipeline(Reader *reader, Database *database, bool debug, size_t statsInterval);
+
+#endif // PIPELINE_H
@@ -0,0 +1,231 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "parse.h"
+#include "stats.h"
+#include "structure.h"
+
+/* Program mierzący wydajność odczytów bez blokad (readDescription w structure.h).
+ * Wczytuje polecenia z pliku podanego w argumencie (np. wygenerowanego programem
+ * generate) i wykonuje je raz, budując strukturę. Następnie dla 1, 2, 4, ...,
+ * READERS wątków czytających mierzy przez SECONDS sekund, ile opisów z poleceń
+ * PRINT_DESCRIPTION odczytują, podczas gdy jeden wątek piszący w kółko wykonuje
+ * polecenia modyfikujące z pliku. Na standardowe wyjście wypisuje przepustowość
+ * odczytów (łącznie i na wątek) i zapisów.
+ *
+ * Użycie: reader_bench [-i] [--compress] [-r READERS] [-s SECONDS] PLIK
+ * (domyślnie 4 wątki czytające i 1 sekunda). */
+
+// Polecenie z pliku z argumentami skopiowanymi z bufora czytnika.
+typedef struct Command {
+   FunctionType function;
+   int n;
+   StringView atr1, atr2;
+} Command;
+
+typedef struct Workload {
+   Command *commands;
+   size_t count, capacity;
+   Command *reads; // Polecenia PRINT_DESCRIPTION z commands.
+   size_t readCount;
+} Workload;
+
+// Stan pomiaru wspólny dla wątków.
+typedef struct Run {
+   Database *database;
+   Workload *workload;
+   int stop; // Zmieniane niepodzielnie: 1 kończy pomiar.
+} Run;
+
+typedef struct ReaderThread {
+   Run *run;
+   pthread_t thread;
+   size_t first; // Numer pierwszego odczytu (wątki zaczynają w różnych miejscach).
+   uint64_t reads;
+} ReaderThread;
+
+static StringView copyView(StringView view) {
+   char *data = malloc(view.length + 1);
+   if (view.length > 0) {
+      memcpy(data, view.data, view.length);
+   }
+   return (StringView) {.data = data, .length = view.length};
+}
+
+static void loadWorkload(int input, Workload *workload) {
+   Reader *reader = createReader(input);
+   ParsedInput parsed;
+   while (parseLine(reader, &parsed)) {
+      if (workload->count == workload->capacity) {
+         workload->capacity = (workload->capacity == 0) ? 1024 : 2 * workload->capacity;
+         workload->commands = realloc(workload->commands, workload->capacity * sizeof(Command));
+      }
+      Command *command = &workload->commands[workload->count++];
+      command->function = parsed.function;
+      command->n = parsed.n;
+      command->atr1 = copyView(parsed.atr1);
+      command->atr2 = copyView(parsed.atr2);
+   }
+   deleteReader(reader);
+
+   workload->reads = malloc(workload->count * sizeof(Command));
+   workload->readCount = 0;
+   for (size_t i = 0; i < workload->count; i++) {
+      if (workload->commands[i].function == PrintDescription) {
+         workload->reads[workload->readCount++] = workload->commands[i];
+      }
+   }
+}
+
+static void deleteWorkload(Workload *workload) {
+   for (size_t i = 0; i < workload->count; i++) {
+      free((char *) workload->commands[i].atr1.data);
+      free((char *) workload->commands[i].atr2.data);
+   }
+   free(workload->commands);
+   free(workload->reads);
+}
+
+// Wykonuje polecenie modyfikujące (pozostałe pomija). Zwraca false, jeżeli je pominięto.
+static bool applyCommand(Command *command, Database *database) {
+   switch (command->function) {
+      case NewDiseaseEnterDescription:
+         newDiseaseEnterDescription(command->atr1, command->atr2, database);
+         return true;
+      case NewDiseaseCopyDescription:
+         newDiseaseCopyDescription(command->atr1, command->atr2, database);
+         return true;
+      case ChangeDescription:
+         changeDescription(command->atr1, command->n, command->atr2, database);
+         return true;
+      case DeletePatientData:
+         deletePatientData(command->atr1, database);
+         return true;
+      default:
+         return false;
+   }
+}
+
+static bool stopped(Run *run) {
+   return __atomic_load_n(&run->stop, __ATOMIC_RELAXED) != 0;
+}
+
+static void *readerMain(void *argument) {
+   ReaderThread *thread = argument;
+   Workload *workload = thread->run->workload;
+   DatabaseReader *reader = createDatabaseReader(thread->run->database);
+   size_t next = thread->first;
+   StringView description;
+   while (!stopped(thread->run)) {
+      Command *command = &workload->reads[next];
+      readDescription(reader, command->atr1, command->n, &description);
+      thread->reads++;
+      next = (next + 1 == workload->readCount) ? 0 : next + 1;
+   }
+   deleteDatabaseReader(reader);
+   return NULL;
+}
+
+static uint64_t now() {
+   struct timespec time;
+   clock_gettime(CLOCK_MONOTONIC, &time);
+   return (uint64_t) time.tv_sec * 1000000000 + time.tv_nsec;
+}
+
+// Mierzy odczyty readers wątków przy jednym piszącym (bieżący wątek).
+static void measure(Run *run, int readers, double seconds, FILE *report) {
+   ReaderThread *threads = calloc(readers, sizeof(ReaderThread));
+   run->stop = 0;
+   for (int i = 0; i < readers; i++) {
+      threads[i].run = run;
+      threads[i].first = run->workload->readCount * i / readers;
+      pthread_create(&threads[i].thread, NULL, readerMain, &threads[i]);
+   }
+
+   uint64_t start = now(), deadline = start + (uint64_t) (seconds * 1e9);
+   uint64_t writes = 0;
+   size_t next = 0;
+   while (now() < deadline) {
+      // Sprawdzamy czas co kilkadziesiąt poleceń.
+      for (int i = 0; i < 64; i++) {
+         writes += applyCommand(&run->workload->commands[next], run->database);
+         next = (next + 1 == run->workload->count) ? 0 : next + 1;
+      }
+   }
+   __atomic_store_n(&run->stop, 1, __ATOMIC_RELAXED);
+   uint64_t reads = 0;
+   for (int i = 0; i < readers; i++) {
+      pthread_join(threads[i].thread, NULL);
+      reads += threads[i].reads;
+   }
+   double elapsed = (now() - start) / 1e9;
+   fprintf(report, "%10d %15.0f %15.0f %15.0f\n", readers, reads / elapsed, reads / elapsed / readers,
+           writes / elapsed);
+   free(threads);
+}
+
+int main(int argc, char **argv) {
+   DatabaseOptions options = {.internDescriptions = false, .shards = 1, .compressDescriptions = false,
+                              .dictionarySamples = DEFAULT_DICTIONARY_SAMPLES};
+   const char *path = NULL;
+   int readers = 4;
+   double seconds = 1;
+   bool correct = true;
+   for (int i = 1; i < argc && correct; i++) {
+      if (strcmp("-i", argv[i]) == 0) {
+         options.internDescriptions = true;
+      }
+      else if (strcmp("--compress", argv[i]) == 0) {
+         options.compressDescriptions = true;
+      }
+      else if (strcmp("-r", argv[i]) == 0 && i + 1 < argc) {
+         readers = atoi(argv[++i]);
+         correct = readers > 0;
+      }
+      else if (strcmp("-s", argv[i]) == 0 && i + 1 < argc) {
+         seconds = atof(argv[++i]);
+         correct = seconds > 0;
+      }
+      else {
+         path = argv[i];
+      }
+   }
+   int input = (path == NULL || !correct) ? -1 : open(path, O_RDONLY);
+   if (input < 0) {
+      fprintf(stderr, "usage: %s [-i] [--compress] [-r READERS] [-s SECONDS] WORKLOAD\n", argv[0]);
+      return 1;
+   }
+
+   Workload workload = {NULL, 0, 0, NULL, 0};
+   loadWorkload(input, &workload);
+   close(input);
+   if (workload.readCount == 0) {
+      fprintf(stderr, "%s: no PRINT_DESCRIPTION commands in %s\n", argv[0], path);
+      deleteWorkload(&workload);
+      return 1;
+   }
+
+   Database *database = initializeDatabase(&options);
+   enableConcurrentReaders(database);
+   for (size_t i = 0; i < workload.count; i++) {
+      applyCommand(&workload.commands[i], database);
+   }
+
+   Run run = {.database = database, .workload = &workload};
+   printf("%10s %15s %15s %15s\n", "readers", "reads/s", "reads/s/thread", "writes/s");
+   for (int count = 1; count <= readers; count = (count < readers && 2 * count > readers) ? readers : 2 * count) {
+      measure(&run, count, seconds, stdout);
+   }
+
+   deleteDatabase(database);
+   deleteWorkload(&workload);
+   deleteCommandCounters();
+   return 0;
+}
@@ -0,0 +1,328 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "command.h"
+#include "output.h"
+#include "parse.h"
+#include "server.h"
+#include "stats.h"
+
+// Największa liczba zdarzeń odbieranych jednym epoll_pwait.
+#define MAX_EVENTS 64
+
+// Liczba bajtów wczytywanych jednym odczytem z połączenia.
+#define READ_SIZE (1 << 16)
+
+// Początkowy rozmiar bufora odpowiedzi połączenia.
+#define CONNECTION_OUTPUT_SIZE (1 << 12)
+
+/* Liczba niewysłanych bajtów odpowiedzi, powyżej której serwer przestaje
+ * czytać polecenia klienta, dopóki ten nie odbierze odpowiedzi. */
+#define MAX_PENDING_OUTPUT (1 << 22)
+
+typedef struct Connection {
+   int fd;
+   // Wczytane, jeszcze niewykonane dane (niepełny ostatni wiersz).
+   char *input;
+   size_t used, capacity;
+   Output *output; // Odpowiedzi czekające na wysłanie.
+   uint32_t events; // Zdarzenia, na które czeka epoll.
+   bool closing; // Klient zakończył wysyłanie: zamykamy po wysłaniu odpowiedzi.
+   bool failed; // Błąd połączenia: zamykamy bez wysyłania.
+   // Połączenia z nowymi odpowiedziami w bieżącym obiegu pętli.
+   bool dirty;
+   struct Connection *nextDirty;
+   // Lista wszystkich połączeń.
+   struct Connection *prev, *next;
+} Connection;
+
+typedef struct Server {
+   int epoll, listener;
+   Database *database;
+   bool debug;
+   size_t statsInterval, commands;
+   Connection *connections;
+   Connection *dirty;
+} Server;
+
+// Ustawiana przez obsługę SIGINT i SIGTERM.
+static volatile sig_atomic_t stopping = 0;
+
+static void stopServer(int signal) {
+   stopping = 1;
+}
+
+static bool setNonBlocking(int fd) {
+   int flags = fcntl(fd, F_GETFL);
+   return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+/* Tworzy gniazdo nasłuchujące path. Plik gniazda pozostawiony przez serwer,
+ * który już nie działa, jest zastępowany. Zwraca -1, jeżeli się nie udało. */
+static int listenOn(const char *path) {
+   struct sockaddr_un address;
+   if (strlen(path) >= sizeof(address.sun_path)) {
+      return -1;
+   }
+   memset(&address, 0, sizeof(address));
+   address.sun_family = AF_UNIX;
+   strcpy(address.sun_path, path);
+
+   int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+   if (fd < 0) {
+      return -1;
+   }
+   bool bound = bind(fd, (struct sockaddr *) &address, sizeof(address)) == 0;
+   if (!bound && errno == EADDRINUSE) {
+      int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+      bool stale = probe >= 0 && connect(probe, (struct sockaddr *) &address, sizeof(address)) != 0
+                   && errno == ECONNREFUSED;
+      if (probe >= 0) {
+         close(probe);
+      }
+      bound = stale && unlink(path) == 0 && bind(fd, (struct sockaddr *) &address, sizeof(address)) == 0;
+   }
+   if (!bound || listen(fd, SOMAXCONN) != 0 || !setNonBlocking(fd)) {
+      close(fd);
+      return -1;
+   }
+   return fd;
+}
+
+static void markDirty(Server *server, Connection *connection) {
+   if (!connection->dirty) {
+      connection->dirty = true;
+      connection->nextDirty = server->dirty;
+      server->dirty = connection;
+   }
+}
+
+static void acceptConnections(Server *server) {
+   int fd;
+   while ((fd = accept(server->listener, NULL, NULL)) >= 0) {
+      Connection *connection = calloc(1, sizeof(Connection));
+      connection->fd = fd;
+      connection->output = createMemoryOutput(CONNECTION_OUTPUT_SIZE);
+      connection->events = EPOLLIN;
+      struct epoll_event event = {.events = connection->events, .data.ptr = connection};
+      if (!setNonBlocking(fd) || epoll_ctl(server->epoll, EPOLL_CTL_ADD, fd, &event) != 0) {
+         closeOutput(connection->output);
+         free(connection);
+         close(fd);
+         continue;
+      }
+      connection->next = server->connections;
+      if (server->connections != NULL) {
+         server->connections->prev = connection;
+      }
+      server->connections = connection;
+   }
+}
+
+static void closeConnection(Server *server, Connection *connection) {
+   epoll_ctl(server->epoll, EPOLL_CTL_DEL, connection->fd, NULL);
+   close(connection->fd);
+   if (connection->prev != NULL) {
+      connection->prev->next = connection->next;
+   }
+   else {
+      server->connections = connection->next;
+   }
+   if (connection->next != NULL) {
+      connection->next->prev = connection->prev;
+   }
+   closeOutput(connection->output);
+   free(connection->input);
+   free(connection);
+}
+
+// Wykonuje polecenie z wiersza line o długości length, dopisując odpowiedź do connection.
+static void executeLine(Server *server, Connection *connection, const char *line, size_t length) {
+   ParsedInput input;
+   uint64_t start = startTiming(ParsePhase);
+   bool parsed = parseCommand(line, length, &input);
+   stopTiming(ParsePhase, start);
+   if (!parsed) {
+      return;
+   }
+   start = startTiming(ExecutePhase);
+   bool applied = executeCommand(&input, server->database, connection->output, server->debug);
+   stopTiming(ExecutePhase, start);
+   countCommand(input.function, applied);
+   if (server->statsInterval > 0 && ++server->commands % server->statsInterval == 0) {
+      DatabaseStatistics statistics;
+      collectStatistics(server->database, &statistics);
+      printStatisticsReport(errorOutput, &statistics);
+   }
+}
+
+/* Wykonuje wszystkie pełne wiersze z wejścia połączenia, a jeżeli klient
+ * zakończył wysyłanie, również ostatni wiersz bez znaku nowej linii. */
+static void executeInput(Server *server, Connection *connection) {
+   size_t begin = 0;
+   char *newline;
+   while ((newline = memchr(connection->input + begin, '\n', connection->used - begin)) != NULL) {
+      executeLine(server, connection, connection->input + begin, newline - (connection->input + begin));
+      begin = newline - connection->input + 1;
+   }
+   if (connection->closing && begin < connection->used) {
+      executeLine(server, connection, connection->input + begin, connection->used - begin);
+      begin = connection->used;
+   }
+   connection->used -= begin;
+   memmove(connection->input, connection->input + begin, connection->used);
+   // Wiersz dłuższy niż dopuszcza protokół: klient nie mówi protokołem hospital.
+   if (connection->used > MAX_LINE_LENGTH) {
+      connection->failed = true;
+   }
+}
+
+static void readInput(Server *server, Connection *connection) {
+   if (connection->capacity - connection->used < READ_SIZE) {
+      connection->capacity = connection->used + READ_SIZE;
+      connection->input = realloc(connection->input, connection->capacity);
+   }
+   ssize_t length = read(connection->fd, connection->input + connection->used, READ_SIZE);
+   if (length < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+         connection->failed = true;
+         markDirty(server, connection);
+      }
+      return;
+   }
+   if (length == 0) {
+      connection->closing = true;
+   }
+   connection->used += length;
+   executeInput(server, connection);
+   markDirty(server, connection);
+}
+
+/* Wysyła jak najwięcej odpowiedzi połączenia i ustala zdarzenia, na które
+ * czeka. Zwraca false, jeżeli połączenie należy zamknąć. */
+static bool sendOutput(Server *server, Connection *connection) {
+   size_t length;
+   const char *data = outputData(connection->output, &length);
+   uint64_t start = startTiming(OutputPhase);
+   while (length > 0 && !connection->failed) {
+      ssize_t sent = send(connection->fd, data, length, MSG_NOSIGNAL);
+      if (sent < 0) {
+         if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            break;
+         }
+         connection->failed = errno != EINTR;
+         continue;
+      }
+      outputDiscard(connection->output, sent);
+      data = outputData(connection->output, &length);
+   }
+   stopTiming(OutputPhase, start);
+   if (connection->failed || (connection->closing && length == 0)) {
+      return false;
+   }
+
+   uint32_t events = ((connection->closing || length >= MAX_PENDING_OUTPUT) ? 0 : EPOLLIN)
+                     | ((length > 0) ? EPOLLOUT : 0);
+   if (events != connection->events) {
+      struct epoll_event event = {.events = events, .data.ptr = connection};
+      epoll_ctl(server->epoll, EPOLL_CTL_MOD, connection->fd, &event);
+      connection->events = events;
+   }
+   return true;
+}
+
+// Wysyła odpowiedzi połączeń, które zmieniły się w bieżącym obiegu pętli.
+static void flushConnections(Server *server) {
+   if (server->dirty == NULL) {
+      return;
+   }
+   // Zmiany potwierdzone w odpowiedziach muszą być już trwale zapisane w dzienniku.
+   if (!syncWriteAheadLog(server->database)) {
+      exitOnFailure(server->database);
+   }
+   while (server->dirty != NULL) {
+      Connection *connection = server->dirty;
+      server->dirty = connection->nextDirty;
+      connection->dirty = false;
+      if (!sendOutput(server, connection)) {
+         closeConnection(server, connection);
+      }
+   }
+   outputFlush(errorOutput);
+}
+
+bool runServer(const char *path, Database *database, bool debug, size_t statsInterval) {
+   Server server = {.database = database, .debug = debug, .statsInterval = statsInterval, .commands = 0,
+                    .connections = NULL, .dirty = NULL};
+   server.listener = listenOn(path);
+   if (server.listener < 0) {
+      return false;
+   }
+   server.epoll = epoll_create1(0);
+   struct epoll_event listenerEvent = {.events = EPOLLIN, .data.ptr = NULL};
+   if (server.epoll < 0 || epoll_ctl(server.epoll, EPOLL_CTL_ADD, server.listener, &listenerEvent) != 0) {
+      if (server.epoll >= 0) {
+         close(server.epoll);
+      }
+      close(server.listener);
+      unlink(path);
+      return false;
+   }
+
+   /* SIGINT i SIGTERM są zablokowane poza epoll_pwait, który odblokowuje je
+    * atomowo na czas czekania - sygnał odebrany między sprawdzeniem stopping
+    * a czekaniem nie zostanie zgubiony, tylko przerwie najbliższe czekanie. */
+   sigset_t stopSignals, waitMask, previousMask;
+   sigemptyset(&stopSignals);
+   sigaddset(&stopSignals, SIGINT);
+   sigaddset(&stopSignals, SIGTERM);
+   sigprocmask(SIG_BLOCK, &stopSignals, &previousMask);
+   waitMask = previousMask;
+   sigdelset(&waitMask, SIGINT);
+   sigdelset(&waitMask, SIGTERM);
+
+   // Bez SA_RESTART, aby sygnał przerwał epoll_pwait.
+   struct sigaction action;
+   memset(&action, 0, sizeof(action));
+   action.sa_handler = stopServer;
+   sigemptyset(&action.sa_mask);
+   sigaction(SIGINT, &action, NULL);
+   sigaction(SIGTERM, &action, NULL);
+
+   struct epoll_event events[MAX_EVENTS];
+   while (!stopping) {
+      int count = epoll_pwait(server.epoll, events, MAX_EVENTS, -1, &waitMask);
+      for (int i = 0; i < count; i++) {
+         Connection *connection = events[i].data.ptr;
+         if (connection == NULL) {
+            acceptConnections(&server);
+         }
+         else if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+            // Po EPOLLHUP read zwróci koniec danych albo błąd.
+            readInput(&server, connection);
+         }
+         else {
+            markDirty(&server, connection);
+         }
+      }
+      flushConnections(&server);
+   }
+
+   sigprocmask(SIG_SETMASK, &previousMask, NULL);
+
+   while (server.connections != NULL) {
+      closeConnection(&server, server.connections);
+   }
+   close(server.epoll);
+   close(server.listener);
+   unlink(path);
+   return true;
+}
@@ -0,0 +1,21 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "structure.h"
+
+/* Obsługuje klientów łączących się z gniazdem uniksowym path, dopóki program
+ * nie otrzyma sygnału SIGINT albo SIGTERM. Każde połączenie mówi protokołem
+ * tekstowym jak standardowe wejście i wyjście programu hospital: klient może
+ * wysłać wiele poleceń naraz, a odpowiedzi dostaje w tej samej kolejności.
+ *
+ * Polecenia wszystkich klientów są wykonywane po kolei przez jeden wątek
+ * (pętla epoll) na wspólnej database. Odpowiedzi na wszystkie polecenia
+ * z jednego odczytu są wysyłane razem, a z dziennikiem - dopiero po jego
+ * trwałym zapisie (jednym fsync dla poleceń wszystkich klientów).
+ * Parametry debug i statsInterval jak w runPipeline (pipeline.h).
+ * Zwraca false, jeżeli nie udało się utworzyć gniazda. */
+bool runServer(const char *path, Database *database, bool debug, size_t statsInterval);
+
+#endif // SERVER_H
@@ -0,0 +1,419 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "database.h"
+
+/* Format pliku migawki (liczby w kolejności bajtów maszyny, wszystkie sekcje
+ * wyrównane do 8 bajtów, przesunięcia liczone od początku pliku):
+ *    SnapshotHeader,
+ *    PatientRecord[patients],
+ *    TextRecord[texts],
+ *    DiseaseRecord[diseases],
+ *    uint32_t[historyEntries] - numery chorób z historii kolejnych pacjentów,
+ *    nazwiska i treści opisów (bez znaków '\0').
+ * Każda treść jest zapisana raz, razem z liczbą chorób, które ją współdzielą,
+ * a każda choroba raz, razem z liczbą wpisów w historiach, które na nią wskazują. */
+
+#define SNAPSHOT_MAGIC "HOSPSNAP"
+#define SNAPSHOT_VERSION 2
+#define SNAPSHOT_BYTE_ORDER 0x01020304
+
+// Rozmiar bufora pliku przy zapisie migawki.
+#define WRITE_BUFFER_SIZE (1 << 20)
+
+typedef struct SnapshotHeader {
+   char magic[8];
+   uint32_t version;
+   uint32_t byteOrder;
+   int64_t descriptions; // Wartość licznika database->descriptions.
+   uint64_t patients, texts, diseases, historyEntries;
+   uint64_t patientOffset, textOffset, diseaseOffset, historyOffset;
+   uint64_t fileSize;
+   // Pamięć, którą oszczędza współdzielenie treści przez choroby (jak savedBytes).
+   uint64_t sharedBytes;
+   uint64_t generation; // Wartość database->generation.
+} SnapshotHeader;
+
+typedef struct PatientRecord {
+   uint64_t nameOffset;
+   uint32_t nameLength;
+   uint32_t diseases;
+   uint64_t history; // Numer pierwszego wpisu historii pacjenta.
+} PatientRecord;
+
+typedef struct TextRecord {
+   uint64_t offset;
+   uint32_t length;
+   int32_t counter;
+} TextRecord;
+
+typedef struct DiseaseRecord {
+   uint32_t text;
+   int32_t counter;
+} DiseaseRecord;
+
+struct Snapshot {
+   const char *data;
+   size_t size;
+   const SnapshotHeader *header;
+   /* Choroby (NO_DISEASE dla jeszcze nieodtworzonych) i treści (NULL)
+    * odtworzone z migawki. Każda jest odtwarzana raz, z licznikiem referencji
+    * zapisanym w migawce, bo ten uwzględnia również wpisy z nieodtworzonych
+    * jeszcze historii. */
+   DiseaseHandle *diseases;
+   Description **texts;
+};
+
+/* Ponumerowane obiekty zapisywanej migawki. Numer obiektu jest pamiętany
+ * w jego polu mark i jest ważny, jeżeli wskazuje na ten obiekt w tablicy,
+ * więc pól mark nie trzeba zerować między kolejnymi zapisami. */
+typedef struct SnapshotWriter {
+   Patient **patients;
+   size_t patientCount;
+   Disease **diseases;
+   size_t diseaseCount, diseaseCapacity;
+   Description **texts;
+   size_t textCount, textCapacity;
+   uint64_t historyEntries;
+   uint64_t bytes; // Łączna długość nazwisk i treści.
+   uint64_t sharedBytes;
+} SnapshotWriter;
+
+static size_t alignSize(size_t size) {
+   return (size + 7) / 8 * 8;
+}
+
+// Dodaje pacjenta do zapisywanej migawki, odtwarzając wcześniej jego historię.
+static void collectPatient(void *value, void *argument) {
+   Patient *patient = value;
+   SnapshotWriter *writer = ((void **) argument)[0];
+   Database *database = ((void **) argument)[1];
+   if (patient->snapshotHistory != NULL) {
+      materializePatient(patient, database);
+   }
+   writer->patients[writer->patientCount++] = patient;
+}
+
+// Zwraca numer treści description w migawce, nadając go przy pierwszym użyciu.
+static uint32_t textNumber(SnapshotWriter *writer, Description *description) {
+   if (description->mark < writer->textCount && writer->texts[description->mark] == description) {
+      return description->mark;
+   }
+   if (writer->textCount == writer->textCapacity) {
+      writer->textCapacity = (writer->textCapacity == 0) ? 64 : 2 * writer->textCapacity;
+      writer->texts = realloc(writer->texts, writer->textCapacity * sizeof(Description *));
+   }
+   description->mark = writer->textCount;
+   writer->texts[writer->textCount++] = description;
+   writer->bytes += description->length;
+   writer->sharedBytes += (description->counter - 1) * descriptionSize(description->length);
+   return description->mark;
+}
+
+// Zwraca numer choroby disease w migawce, nadając go przy pierwszym użyciu.
+static uint32_t diseaseNumber(SnapshotWriter *writer, Disease *disease) {
+   if (disease->mark < writer->diseaseCount && writer->diseases[disease->mark] == disease) {
+      return disease->mark;
+   }
+   if (writer->diseaseCount == writer->diseaseCapacity) {
+      writer->diseaseCapacity = (writer->diseaseCapacity == 0) ? 64 : 2 * writer->diseaseCapacity;
+      writer->diseases = realloc(writer->diseases, writer->diseaseCapacity * sizeof(Disease *));
+   }
+   disease->mark = writer->diseaseCount;
+   writer->diseases[writer->diseaseCount++] = disease;
+   textNumber(writer, disease->description);
+   return disease->mark;
+}
+
+static bool writeSnapshot(FILE *file, SnapshotWriter *writer, Database *database) {
+   SnapshotHeader header;
+   memset(&header, 0, sizeof(SnapshotHeader));
+   memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+   header.version = SNAPSHOT_VERSION;
+   header.byteOrder = SNAPSHOT_BYTE_ORDER;
+   header.descriptions = database->descriptions;
+   header.patients = writer->patientCount;
+   header.texts = writer->textCount;
+   header.diseases = writer->diseaseCount;
+   header.historyEntries = writer->historyEntries;
+   header.patientOffset = sizeof(SnapshotHeader);
+   header.textOffset = header.patientOffset + header.patients * sizeof(PatientRecord);
+   header.diseaseOffset = header.textOffset + header.texts * sizeof(TextRecord);
+   header.historyOffset = header.diseaseOffset + header.diseases * sizeof(DiseaseRecord);
+   uint64_t bytesOffset = header.historyOffset + alignSize(header.historyEntries * sizeof(uint32_t));
+   header.fileSize = bytesOffset + writer->bytes;
+   header.sharedBytes = writer->sharedBytes;
+   header.generation = database->generation;
+
+   bool ok = fwrite(&header, sizeof(SnapshotHeader), 1, file) == 1;
+
+   // Nazwiska, a po nich treści, zajmują kolejne bajty od bytesOffset.
+   uint64_t offset = bytesOffset;
+   uint64_t history = 0;
+   for (size_t i = 0; ok && i < writer->patientCount; i++) {
+      Patient *patient = writer->patients[i];
+      PatientRecord record = {.nameOffset = offset, .nameLength = patient->nameLength,
+                              .diseases = patient->diseases, .history = history};
+      ok = fwrite(&record, sizeof(PatientRecord), 1, file) == 1;
+      offset += patient->nameLength;
+      history += patient->diseases;
+   }
+   for (size_t i = 0; ok && i < writer->textCount; i++) {
+      TextRecord record = {.offset = offset, .length = writer->texts[i]->length,
+                           .counter = writer->texts[i]->counter};
+      ok = fwrite(&record, sizeof(TextRecord), 1, file) == 1;
+      offset += writer->texts[i]->length;
+   }
+   for (size_t i = 0; ok && i < writer->diseaseCount; i++) {
+      DiseaseRecord record = {.text = writer->diseases[i]->description->mark,
+                              .counter = writer->diseases[i]->counter};
+      ok = fwrite(&record, sizeof(DiseaseRecord), 1, file) == 1;
+   }
+   for (size_t i = 0; ok && i < writer->patientCount; i++) {
+      Patient *patient = writer->patients[i];
+      for (int j = 0; ok && j < patient->diseases; j++) {
+         uint32_t number = diseaseAt(patient->history[j], database)->mark;
+         ok = fwrite(&number, sizeof(uint32_t), 1, file) == 1;
+      }
+   }
+   if (ok && header.historyEntries % 2 == 1) {
+      uint32_t padding = 0;
+      ok = fwrite(&padding, sizeof(uint32_t), 1, file) == 1;
+   }
+   for (size_t i = 0; ok && i < writer->patientCount; i++) {
+      ok = fwrite(writer->patients[i]->name, 1, writer->patients[i]->nameLength, file)
+           == writer->patients[i]->nameLength;
+   }
+   for (size_t i = 0; ok && i < writer->textCount; i++) {
+      StringView text = descriptionText(writer->texts[i], database);
+      ok = fwrite(text.data, 1, text.length, file) == text.length;
+   }
+   return ok;
+}
+
+bool saveSnapshot(Database *database, const char *path) {
+   SnapshotWriter writer;
+   memset(&writer, 0, sizeof(SnapshotWriter));
+   writer.patients = malloc((hashMapSize(database->patients) + 1) * sizeof(Patient *));
+   void *arguments[] = {&writer, database};
+   hashMapForEach(database->patients, collectPatient, arguments);
+   if (database->failure[0] != '\0') {
+      free(writer.patients);
+      return false;
+   }
+
+   for (size_t i = 0; i < writer.patientCount; i++) {
+      Patient *patient = writer.patients[i];
+      writer.bytes += patient->nameLength;
+      writer.historyEntries += patient->diseases;
+      for (int j = 0; j < patient->diseases; j++) {
+         diseaseNumber(&writer, diseaseAt(patient->history[j], database));
+      }
+   }
+
+   // Migawka jest zapisywana do pliku tymczasowego i podmieniana w całości.
+   size_t pathLength = strlen(path);
+   char *temporaryPath = malloc(pathLength + 5);
+   memcpy(temporaryPath, path, pathLength);
+   memcpy(temporaryPath + pathLength, ".tmp", 5);
+
+   bool ok = false;
+   FILE *file = fopen(temporaryPath, "wb");
+   if (file != NULL) {
+      char *buffer = malloc(WRITE_BUFFER_SIZE);
+      setvbuf(file, buffer, _IOFBF, WRITE_BUFFER_SIZE);
+      ok = writeSnapshot(file, &writer, database);
+      ok = (fflush(file) == 0) && ok;
+      ok = ok && fsync(fileno(file)) == 0;
+      ok = (fclose(file) == 0) && ok;
+      free(buffer);
+      ok = ok && rename(temporaryPath, path) == 0;
+      if (!ok) {
+         remove(temporaryPath);
+      }
+   }
+
+   free(temporaryPath);
+   free(writer.patients);
+   free(writer.diseases);
+   free(writer.texts);
+   return ok;
+}
+
+// Sprawdza, czy count rekordów rozmiaru size od offset mieści się w pliku.
+static bool sectionFits(Snapshot *snapshot, uint64_t offset, uint64_t count, size_t size) {
+   return offset % 8 == 0 && offset <= snapshot->size && count <= (snapshot->size - offset) / size;
+}
+
+static bool validHeader(Snapshot *snapshot) {
+   const SnapshotHeader *header = snapshot->header;
+   return snapshot->size >= sizeof(SnapshotHeader)
+          && memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) == 0
+          && header->version == SNAPSHOT_VERSION
+          && header->byteOrder == SNAPSHOT_BYTE_ORDER
+          && header->fileSize == snapshot->size
+          && header->descriptions >= 0 && header->descriptions <= INT32_MAX
+          && header->diseases <= UINT32_MAX && header->texts <= UINT32_MAX
+          && sectionFits(snapshot, header->patientOffset, header->patients, sizeof(PatientRecord))
+          && sectionFits(snapshot, header->textOffset, header->texts, sizeof(TextRecord))
+          && sectionFits(snapshot, header->diseaseOffset, header->diseases, sizeof(DiseaseRecord))
+          && sectionFits(snapshot, header->historyOffset, header->historyEntries, sizeof(uint32_t));
+}
+
+// Zwraca treść o numerze number, odtwarzając ją przy pierwszym użyciu (NULL, jeżeli migawka jest uszkodzona).
+static Description *loadText(uint32_t number, Database *database) {
+   Snapshot *snapshot = database->snapshot;
+   if (number >= snapshot->header->texts) {
+      failDatabase(database, "corrupt snapshot", 0);
+      return NULL;
+   }
+   if (snapshot->texts[number] != NULL) {
+      return snapshot->texts[number];
+   }
+
+   const TextRecord *record = (const TextRecord *) (snapshot->data + snapshot->header->textOffset) + number;
+   if (record->counter <= 0 || record->offset > snapshot->size
+       || record->length > snapshot->size - record->offset) {
+      failDatabase(database, "corrupt snapshot", 0);
+      return NULL;
+   }
+   StringView text = {.data = snapshot->data + record->offset, .length = record->length};
+   Description *description = allocateDescription(text, database);
+   description->counter = record->counter;
+   if (database->descriptionIndex != NULL) {
+      indexDescription(description, database);
+   }
+   snapshot->texts[number] = description;
+   return description;
+}
+
+/* Zwraca uchwyt choroby o numerze number, odtwarzając ją przy pierwszym użyciu
+ * (NO_DISEASE, jeżeli migawka jest uszkodzona albo zabrakło uchwytów). */
+static DiseaseHandle loadDisease(uint32_t number, Database *database) {
+   Snapshot *snapshot = database->snapshot;
+   if (number >= snapshot->header->diseases) {
+      failDatabase(database, "corrupt snapshot", 0);
+      return NO_DISEASE;
+   }
+   if (snapshot->diseases[number] != NO_DISEASE) {
+      return snapshot->diseases[number];
+   }
+
+   const DiseaseRecord *record =
+         (const DiseaseRecord *) (snapshot->data + snapshot->header->diseaseOffset) + number;
+   if (record->counter <= 0) {
+      failDatabase(database, "corrupt snapshot", 0);
+      return NO_DISEASE;
+   }
+   Description *text = loadText(record->text, database);
+   if (text == NULL) {
+      return NO_DISEASE;
+   }
+   DiseaseHandle disease = newDisease(text, record->counter, database);
+   snapshot->diseases[number] = disease;
+   return disease;
+}
+
+void materializePatient(Patient *patient, Database *database) {
+   const uint32_t *numbers = patient->snapshotHistory;
+   patient->snapshotHistory = NULL;
+   patient->capacity = patient->diseases;
+   patient->history = heapAllocate(database->heap, patient->capacity * sizeof(DiseaseHandle));
+   for (int i = 0; i < patient->diseases; i++) {
+      patient->history[i] = loadDisease(numbers[i], database);
+      if (patient->history[i] == NO_DISEASE) {
+         // Struktura nie wykonuje już poleceń, historia musi tylko dać się usunąć.
+         database->historyEntries -= patient->diseases - i;
+         patient->diseases = i;
+         return;
+      }
+      database->historyBytes += descriptionSize(diseaseAt(patient->history[i], database)->description->length);
+   }
+}
+
+bool loadSnapshot(Database *database, const char *path) {
+   int fd = open(path, O_RDONLY);
+   if (fd < 0) {
+      return false;
+   }
+   struct stat status;
+   if (fstat(fd, &status) != 0 || (size_t) status.st_size < sizeof(SnapshotHeader)) {
+      close(fd);
+      return false;
+   }
+   void *data = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+   close(fd);
+   if (data == MAP_FAILED) {
+      return false;
+   }
+
+   Snapshot *snapshot = malloc(sizeof(Snapshot));
+   snapshot->data = data;
+   snapshot->size = status.st_size;
+   snapshot->header = data;
+   snapshot->diseases = NULL;
+   snapshot->texts = NULL;
+   database->snapshot = snapshot;
+   if (!validHeader(snapshot)) {
+      return false;
+   }
+   const SnapshotHeader *header = snapshot->header;
+   snapshot->diseases = malloc((header->diseases + 1) * sizeof(DiseaseHandle));
+   for (uint64_t i = 0; i < header->diseases; i++) {
+      snapshot->diseases[i] = NO_DISEASE;
+   }
+   snapshot->texts = calloc(header->texts + 1, sizeof(Description *));
+
+   // Tworzymy tylko pacjentów - ich historie są odtwarzane przy pierwszym odwołaniu.
+   const PatientRecord *records = (const PatientRecord *) (snapshot->data + header->patientOffset);
+   const uint32_t *history = (const uint32_t *) (snapshot->data + header->historyOffset);
+   for (uint64_t i = 0; i < header->patients; i++) {
+      const PatientRecord *record = &records[i];
+      if (record->nameLength == 0 || record->nameOffset > snapshot->size
+          || record->nameLength > snapshot->size - record->nameOffset
+          || record->diseases > INT32_MAX || record->history > header->historyEntries
+          || record->diseases > header->historyEntries - record->history) {
+         return false;
+      }
+      const char *name = snapshot->data + record->nameOffset;
+      uint64_t hash = hashKey(name, record->nameLength);
+      if (hashMapFind(database->patients, name, record->nameLength, hash) != NULL) {
+         return false;
+      }
+
+      Patient *patient = poolAllocate(database->patientPool);
+      patient->name = name;
+      patient->nameLength = record->nameLength;
+      patient->history = NULL;
+      patient->diseases = record->diseases;
+      patient->capacity = 0;
+      patient->snapshotHistory = (record->diseases > 0) ? history + record->history : NULL;
+      hashMapInsert(database->patients, patient, hash);
+      database->historyEntries += record->diseases;
+   }
+
+   database->descriptions = header->descriptions;
+   database->generation = header->generation;
+   if (database->descriptionIndex != NULL) {
+      database->savedBytes = header->sharedBytes;
+   }
+   return true;
+}
+
+void closeSnapshot(Database *database) {
+   Snapshot *snapshot = database->snapshot;
+   if (snapshot == NULL) {
+      return;
+   }
+   munmap((void *) snapshot->data, snapshot->size);
+   free(snapshot->diseases);
+   free(snapshot->texts);
+   free(snapshot);
+   database->snapshot = NULL;
+}
@@ -0,0 +1,94 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "stats.h"
+
+// Liczniki wątku na liście liczników wszystkich wątków.
+typedef struct ThreadCounters {
+   CommandCounters counters;
+   struct ThreadCounters *next;
+} ThreadCounters;
+
+// Co który pomiar etapu jest wykonywany.
+static const uint64_t SAMPLING[TIMED_PHASES] = {TIMING_SAMPLE, TIMING_SAMPLE, 1, TIMING_SAMPLE};
+
+static pthread_mutex_t countersMutex = PTHREAD_MUTEX_INITIALIZER;
+static ThreadCounters *allCounters = NULL;
+static __thread ThreadCounters *threadCounters = NULL;
+
+// Zwraca liczniki bieżącego wątku, tworząc je przy pierwszym użyciu.
+static ThreadCounters *currentCounters() {
+   if (threadCounters == NULL) {
+      threadCounters = calloc(1, sizeof(ThreadCounters));
+      pthread_mutex_lock(&countersMutex);
+      threadCounters->next = allCounters;
+      allCounters = threadCounters;
+      pthread_mutex_unlock(&countersMutex);
+   }
+   return threadCounters;
+}
+
+/* Zwiększa licznik o value. Licznik zmienia tylko jeden wątek, więc wystarczy
+ * niepodzielny zapis (bez kosztownego niepodzielnego dodawania). */
+static void addToCounter(uint64_t *counter, uint64_t value) {
+   __atomic_store_n(counter, *counter + value, __ATOMIC_RELAXED);
+}
+
+static uint64_t clockTime() {
+   struct timespec time;
+   clock_gettime(CLOCK_MONOTONIC, &time);
+   return (uint64_t) time.tv_sec * 1000000000 + time.tv_nsec;
+}
+
+void countCommand(FunctionType function, bool applied) {
+   CommandCounters *counters = &currentCounters()->counters;
+   addToCounter(&counters->commands[function], 1);
+   if (!applied) {
+      addToCounter(&counters->ignored[function], 1);
+   }
+}
+
+uint64_t startTiming(TimedPhase phase) {
+   CommandCounters *counters = &currentCounters()->counters;
+   addToCounter(&counters->runs[phase], 1);
+   if (counters->runs[phase] % SAMPLING[phase] != 0) {
+      return 0;
+   }
+   return clockTime();
+}
+
+void stopTiming(TimedPhase phase, uint64_t start) {
+   if (start != 0) {
+      addToCounter(&currentCounters()->counters.time[phase], (clockTime() - start) * SAMPLING[phase]);
+   }
+}
+
+void sumCommandCounters(CommandCounters *total) {
+   memset(total, 0, sizeof(CommandCounters));
+   pthread_mutex_lock(&countersMutex);
+   for (ThreadCounters *thread = allCounters; thread != NULL; thread = thread->next) {
+      for (int i = 0; i < FUNCTION_TYPES; i++) {
+         total->commands[i] += __atomic_load_n(&thread->counters.commands[i], __ATOMIC_RELAXED);
+         total->ignored[i] += __atomic_load_n(&thread->counters.ignored[i], __ATOMIC_RELAXED);
+      }
+      for (int i = 0; i < TIMED_PHASES; i++) {
+         total->time[i] += __atomic_load_n(&thread->counters.time[i], __ATOMIC_RELAXED);
+         total->runs[i] += __atomic_load_n(&thread->counters.runs[i], __ATOMIC_RELAXED);
+      }
+   }
+   pthread_mutex_unlock(&countersMutex);
+}
+
+void deleteCommandCounters() {
+   pthread_mutex_lock(&countersMutex);
+   while (allCounters != NULL) {
+      ThreadCounters *next = allCounters->next;
+      free(allCounters);
+      allCounters = next;
+   }
+   pthread_mutex_unlock(&countersMutex);
+   threadCounters = NULL;
+}
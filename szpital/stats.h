@@ -0,0 +1,49 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "parse.h"
+
+/* Liczniki poleceń i czasu pracy programu dla polecenia STATS.
+ * Każdy wątek ma własne liczniki, zmieniane bez synchronizacji (tylko przez
+ * ten wątek), a sumowane dopiero przy odczycie, więc liczenie kosztuje
+ * tyle, co zwiększenie zmiennej. Czas wczytywania i wykonywania poleceń
+ * oraz rozpakowywania opisów jest mierzony co TIMING_SAMPLE-ty raz
+ * i odpowiednio mnożony, a czas wypisywania - przy każdym wypisaniu bufora. */
+
+// Co który raz jest mierzony czas wczytania i wykonania polecenia oraz rozpakowania opisu.
+#define TIMING_SAMPLE 16
+
+typedef enum TimedPhase {
+   ParsePhase,
+   ExecutePhase,
+   OutputPhase,
+   DecompressPhase,
+   TIMED_PHASES
+} TimedPhase;
+
+typedef struct CommandCounters {
+   uint64_t commands[FUNCTION_TYPES];
+   uint64_t ignored[FUNCTION_TYPES]; // Polecenia, na które odpowiedzią było IGNORED.
+   uint64_t time[TIMED_PHASES]; // W nanosekundach.
+   uint64_t runs[TIMED_PHASES]; // Liczba wykonań etapu (również niemierzonych).
+} CommandCounters;
+
+// Zlicza polecenie function wykonane przez bieżący wątek (applied == false dla IGNORED).
+void countCommand(FunctionType function, bool applied);
+
+/* Zaczyna pomiar czasu etapu phase w bieżącym wątku. Zwraca 0, jeżeli
+ * ten pomiar jest pomijany; wynik należy przekazać do stopTiming. */
+uint64_t startTiming(TimedPhase phase);
+
+// Kończy pomiar czasu etapu phase zaczęty przez startTiming, które zwróciło start.
+void stopTiming(TimedPhase phase, uint64_t start);
+
+// Zapisuje w total sumę liczników wszystkich wątków (również zakończonych).
+void sumCommandCounters(CommandCounters *total);
+
+// Zwalnia liczniki wszystkich wątków (na końcu programu).
+void deleteCommandCounters();
+
+#endif // STATS_H
@@ -1,270 +1,888 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "database.h"
+#include "epoch.h"
+#include "stats.h"
 #include "structure.h"
 
-typedef struct Disease {
-   char *description;
-   int counter;
-} Disease;
-
-typedef struct DiseaseList {
-   Disease *disease;
-   struct DiseaseList *next;
-} DiseaseList;
-
-typedef struct Patient {
-   char *name;
-   DiseaseList *diseaseList, *lastDiseaseList;
-   struct Patient *next;
-} Patient;
-
-typedef struct Database {
-   Patient *patientList;
-   int descriptions;
-} Database;
-
-const char *OK_MESSAGE = "OK";
-const char *IGNORED_MESSAGE = "IGNORED";
-
-/* Znajduje i zwraca pacjenta o nazwisku name w patientList.
- * Jeżeli nie ma takiego pacjenta, zwraca NULL. */
-Patient *findPatient(Patient *patientList, char *name) {
-   while (patientList != NULL) {
-      if (strcmp(name, patientList->name) == 0) {
-         return patientList;
-      }
-      patientList = patientList->next;
+// Zwraca nazwisko pacjenta patient jako klucz w database->patients.
+const char *patientKey(const void *patient, size_t *length) {
+   *length = ((const Patient *) patient)->nameLength;
+   return ((const Patient *) patient)->name;
+}
+
+/* Zwraca zawartość opisu description jako klucz w database->descriptionIndex
+ * (skompresowany opis jest indeksowany swoją postacią skompresowaną). */
+const char *descriptionKey(const void *description, size_t *length) {
+   *length = ((const Description *) description)->storedLength;
+   return ((const Description *) description)->text;
+}
+
+Patient *findPatient(StringView name, Database *database) {
+   Patient *patient = hashMapFind(database->patients, name.data, name.length,
+                                  hashKey(name.data, name.length));
+   if (patient != NULL && patient->snapshotHistory != NULL) {
+      materializePatient(patient, database);
    }
-   return NULL;
+   return patient;
+}
+
+// Zwalnia obiekt database->heap oddany przez releaseHeapObject.
+void reclaimHeapObject(void *object, size_t size, void *database) {
+   heapFree(((Database *) database)->heap, object, size);
+}
+
+Disease *diseaseAt(DiseaseHandle handle, Database *database) {
+   Database *owner = database;
+   if (database->shards != NULL) {
+      owner = database->shards[handle & ((1u << database->shardBits) - 1)];
+   }
+   return tableObject(owner->diseases, handle >> database->shardBits);
+}
+
+void failDatabase(Database *database, const char *operation, int error) {
+   if (database->failure[0] != '\0') {
+      return;
+   }
+   if (error != 0) {
+      snprintf(database->failure, FAILURE_SIZE, "%s: %s", operation, strerror(error));
+   }
+   else {
+      snprintf(database->failure, FAILURE_SIZE, "%s", operation);
+   }
+}
+
+DiseaseHandle newDisease(Description *description, int counter, Database *database) {
+   uint32_t index = tableAllocate(database->diseases);
+   if (index == NO_OBJECT) {
+      failDatabase(database, "too many diseases", 0);
+      return NO_DISEASE;
+   }
+   Disease *disease = tableObject(database->diseases, index);
+   disease->description = description;
+   disease->counter = counter;
+   return index << database->shardBits | database->shard;
+}
+
+// Zwraca do tablicy chorób database chorobę o uchwycie handle, należącą do database.
+void freeDisease(DiseaseHandle handle, Database *database) {
+   tableFree(database->diseases, handle >> database->shardBits);
+}
+
+/* Zwalnia chorobę oddaną przez releaseDisease (obiektem jest choroba,
+ * a zamiast rozmiaru przekazywany jest jej uchwyt). */
+void reclaimDisease(void *disease, size_t handle, void *database) {
+   freeDisease(handle, database);
+}
+
+// Zwalnia starą tablicę database->patients oddaną przez retireTable.
+void reclaimTable(void *table, size_t size, void *database) {
+   free(table);
 }
 
-// Dodaje pacjenta newPatient na koniec database->patientList.
-void pushPatient(Patient *newPatient, Database *database) {
-   if (database->patientList == NULL) {
-      database->patientList = newPatient;
+// Oddaje starą tablicę database->patients do zwolnienia przez database->epochs.
+void retireTable(void *table, void *database) {
+   retireObject(((Database *) database)->epochs, table, 0, reclaimTable);
+}
+
+/* Zwalnia obiekt object o rozmiarze size z database->heap. Jeżeli strukturę
+ * mogą czytać inne wątki, zwalnia go dopiero wtedy, gdy nikt go nie czyta. */
+void releaseHeapObject(void *object, size_t size, Database *database) {
+   if (database->epochs != NULL && object != NULL) {
+      retireObject(database->epochs, object, size, reclaimHeapObject);
+   }
+   else {
+      heapFree(database->heap, object, size);
+   }
+}
+
+// Zwalnia chorobę o uchwycie handle (jak releaseHeapObject).
+void releaseDisease(DiseaseHandle handle, Database *database) {
+   if (database->epochs != NULL) {
+      retireObject(database->epochs, diseaseAt(handle, database), handle, reclaimDisease);
    }
    else {
-      Patient *lastPatient = database->patientList;
-      while (lastPatient->next != NULL) {
-         lastPatient = lastPatient->next;
+      freeDisease(handle, database);
+   }
+}
+
+/* Tworzy pacjenta o nazwisku name z pustą historią chorób
+ * i dodaje go do database. */
+Patient *addPatient(StringView name, Database *database) {
+   Patient *patient = poolAllocate(database->patientPool);
+   char *patientName = arenaAllocate(database->names, name.length);
+   memcpy(patientName, name.data, name.length);
+   patient->name = patientName;
+   patient->nameLength = name.length;
+   patient->history = NULL;
+   patient->diseases = 0;
+   patient->capacity = 0;
+   patient->snapshotHistory = NULL;
+
+   hashMapInsert(database->patients, patient, hashKey(name.data, name.length));
+   return patient;
+}
+
+/* Dopisuje chorobę disease na koniec historii pacjenta patient (bez zmiany
+ * jej licznika referencji). Gdy tablica historii jest pełna, zwiększa jej
+ * pojemność dwukrotnie.
+ *
+ * Historię mogą równocześnie czytać inne wątki (readDescription), więc
+ * nowa tablica jest publikowana przed zwiększeniem liczby chorób, a stara
+ * zwalniana z opóźnieniem. */
+void appendDisease(DiseaseHandle disease, Patient *patient, Database *database) {
+   if (patient->diseases == patient->capacity) {
+      int capacity = (patient->capacity == 0) ? INITIAL_HISTORY_CAPACITY : 2 * patient->capacity;
+      DiseaseHandle *history = patient->history;
+      if (database->epochs != NULL) {
+         history = heapAllocate(database->heap, capacity * sizeof(DiseaseHandle));
+         if (patient->diseases > 0) {
+            memcpy(history, patient->history, patient->diseases * sizeof(DiseaseHandle));
+         }
+         releaseHeapObject(patient->history, patient->capacity * sizeof(DiseaseHandle), database);
+      }
+      else {
+         history = heapReallocate(database->heap, history, patient->capacity * sizeof(DiseaseHandle),
+                                  capacity * sizeof(DiseaseHandle));
       }
-      lastPatient->next = newPatient;
+      __atomic_store_n(&patient->history, history, __ATOMIC_RELEASE);
+      patient->capacity = capacity;
    }
+   __atomic_store_n(&patient->history[patient->diseases], disease, __ATOMIC_RELEASE);
+   __atomic_store_n(&patient->diseases, patient->diseases + 1, __ATOMIC_RELEASE);
+   database->historyEntries++;
+   database->historyBytes += descriptionSize(diseaseAt(disease, database)->description->length);
 }
 
-// Dodaje chorobę disease na koniec patient->diseaseList.
-void pushDisease(Disease *disease, Patient *patient) {
-   disease->counter++;
-   if (patient->diseaseList == NULL) {
-      patient->diseaseList = malloc(sizeof(DiseaseList));
-      patient->diseaseList->disease = disease;
-      patient->diseaseList->next = NULL;
-      patient->lastDiseaseList = patient->diseaseList;
+// Zgłasza zmianę o delta liczby referencji do współdzielonej choroby disease.
+void recordReference(DiseaseHandle disease, int delta, Database *database) {
+   if (database->eventCount == database->eventCapacity) {
+      database->eventCapacity = (database->eventCapacity == 0) ? 64 : 2 * database->eventCapacity;
+      database->events = realloc(database->events, database->eventCapacity * sizeof(ReferenceEvent));
+   }
+   ReferenceEvent *event = &database->events[database->eventCount++];
+   event->command = database->command;
+   event->delta = delta;
+   event->disease = disease;
+}
+
+// Dodaje chorobę disease na koniec historii pacjenta patient.
+void pushDisease(DiseaseHandle disease, Patient *patient, Database *database) {
+   Disease *entry = diseaseAt(disease, database);
+   if (entry->counter == SHARED_DISEASE) {
+      recordReference(disease, 1, database);
    }
    else {
-      DiseaseList *newDiseaseList = malloc(sizeof(DiseaseList));
-      newDiseaseList->disease = disease;
-      newDiseaseList->next = NULL;
-      patient->lastDiseaseList->next = newDiseaseList;
-      patient->lastDiseaseList = newDiseaseList;
+      entry->counter++;
    }
+   appendDisease(disease, patient, database);
 }
 
 /* Zwraca ostatnią chorobę pacjetna patient.
- * Jeżeli historia chorób jest pusta, zwraca NULL. */
-Disease *getLastDisease(Patient *patient) {
-   if (patient->diseaseList == NULL) {
-      return NULL;
+ * Jeżeli historia chorób jest pusta, zwraca NO_DISEASE. */
+DiseaseHandle getLastDisease(Patient *patient) {
+   if (patient->diseases == 0) {
+      return NO_DISEASE;
    }
-   DiseaseList *lastDisease = patient->diseaseList;
-   if (lastDisease == NULL) {
+   return patient->history[patient->diseases - 1];
+}
+
+/* Zwraca wskaźnik na n-tą (numerując od 1) chorobę w historii pacjenta patient.
+ * Dla n < 1 zwraca pierwszą chorobę. Jeżeli nie ma takiej choroby, zwraca NULL. */
+DiseaseHandle *getDisease(Patient *patient, int n) {
+   int index = (n > 1) ? n - 1 : 0;
+   if (index >= patient->diseases) {
       return NULL;
    }
-   while (lastDisease->next != NULL) {
-      lastDisease = lastDisease->next;
+   return &patient->history[index];
+}
+
+size_t descriptionSize(size_t length) {
+   return sizeof(Description) + length + 1;
+}
+
+// Czy opis o treści długości length trafi do magazynu database->blobs.
+bool spillable(size_t length, Database *database) {
+   return database->blobs != NULL && length >= database->spillThreshold;
+}
+
+// Zwraca rozmiar pamięci zajmowanej przez opis description.
+size_t residentSize(Description *description) {
+   return descriptionSize(description->storedLength);
+}
+
+// Zwraca część struktury, do której należy opis description.
+Database *descriptionOwner(Description *description, Database *database) {
+   return (database->shards == NULL) ? database : database->shards[description->shard];
+}
+
+/* Zapisuje w stored postać, w jakiej będzie przechowywana treść text
+ * (długie treści trafiające do magazynu nie są kompresowane). Zwraca true,
+ * jeżeli jest to postać skompresowana (ważna do następnej kompresji). */
+bool encodeDescription(StringView text, Database *database, StringView *stored) {
+   *stored = text;
+   if (database->compressor == NULL || spillable(text.length, database)) {
+      return false;
+   }
+   return compressText(database->compressor, text, stored);
+}
+
+// Zapisuje w opisie owner nowy adres jego treści w magazynie.
+void moveDescription(void *owner, uint64_t offset) {
+   memcpy(((Description *) owner)->text, &offset, sizeof(uint64_t));
+}
+
+/* Tworzy opis o treści długości length przechowywanej w postaci stored
+ * (skompresowanej, jeżeli compressed), patrz encodeDescription. */
+Description *allocateStored(size_t length, StringView stored, bool compressed, Database *database) {
+   Description *description = NULL;
+   if (spillable(length, database)) {
+      description = heapAllocate(database->heap, descriptionSize(sizeof(uint64_t)));
+      uint64_t offset = blobAppend(database->blobs, stored.data, length, description);
+      if (offset != NO_BLOB) {
+         description->spilled = true;
+         description->compressed = false;
+         description->storedLength = sizeof(uint64_t);
+         moveDescription(description, offset);
+      }
+      else {
+         // Gdy opis nie mieści się w segmencie magazynu albo zabraknie miejsca na dysku, zostaje w pamięci.
+         heapFree(database->heap, description, descriptionSize(sizeof(uint64_t)));
+         description = NULL;
+      }
+   }
+   if (description == NULL) {
+      description = heapAllocate(database->heap, descriptionSize(stored.length));
+      description->spilled = false;
+      description->compressed = compressed;
+      description->storedLength = stored.length;
+      memcpy(description->text, stored.data, stored.length);
+      description->text[stored.length] = '\0';
+      if (compressed) {
+         database->compressedTextBytes += length;
+         database->compressedBytes += stored.length;
+      }
+   }
+   description->counter = 1;
+   description->length = length;
+   description->shard = database->shard;
+   database->descriptionBytes += descriptionSize(length);
+   return description;
+}
+
+Description *allocateDescription(StringView text, Database *database) {
+   StringView stored;
+   bool compressed = encodeDescription(text, database, &stored);
+   return allocateStored(text.length, stored, compressed, database);
+}
+
+// Rozpakowuje skompresowaną treść opisu description do bufora text.
+void decompressDescription(Description *description, Database *database, char *text) {
+   // Opis współdzielonej choroby mógł skompresować kompresor innej części.
+   Compressor *compressor = descriptionOwner(description, database)->compressor;
+   uint64_t start = startTiming(DecompressPhase);
+   decompressText(compressor, (StringView) {.data = description->text, .length = description->storedLength},
+                  text, description->length);
+   stopTiming(DecompressPhase, start);
+}
+
+StringView descriptionText(Description *description, Database *database) {
+   if (description->spilled) {
+      uint64_t offset;
+      memcpy(&offset, description->text, sizeof(uint64_t));
+      return (StringView) {.data = blobData(database->blobs, offset), .length = description->length};
+   }
+   if (description->compressed) {
+      if (database->decodedCapacity < description->length) {
+         database->decodedCapacity = description->length;
+         database->decoded = realloc(database->decoded, database->decodedCapacity);
+      }
+      decompressDescription(description, database, database->decoded);
+      return (StringView) {.data = database->decoded, .length = description->length};
+   }
+   return (StringView) {.data = description->text, .length = description->length};
+}
+
+void indexDescription(Description *description, Database *database) {
+   if (description->spilled) {
+      return;
+   }
+   uint64_t hash = hashKey(description->text, description->storedLength);
+   if (hashMapFind(database->descriptionIndex, description->text, description->storedLength, hash) == NULL) {
+      hashMapInsert(database->descriptionIndex, description, hash);
+   }
+}
+
+/* Zwraca opis o treści text. W trybie internowania, jeżeli istnieje już
+ * opis o takiej treści, zwiększa jego licznik referencji i go zwraca
+ * (opisy przenoszone do magazynu nie są internowane). Ta sama treść
+ * jest zawsze tak samo kompresowana, więc opisy są wyszukiwane
+ * po postaci, w jakiej są przechowywane. */
+Description *storeDescription(StringView text, Database *database) {
+   size_t length = text.length;
+   size_t size = descriptionSize(length);
+   uint64_t hash = 0;
+   bool indexed = database->descriptionIndex != NULL && !spillable(length, database);
+   StringView stored;
+   bool compressed = encodeDescription(text, database, &stored);
+
+   if (indexed) {
+      hash = hashKey(stored.data, stored.length);
+      Description *description = hashMapFind(database->descriptionIndex, stored.data, stored.length, hash);
+      // Zawartość nieskompresowanego opisu może przypadkiem być postacią skompresowaną innego.
+      if (description != NULL && description->compressed == compressed) {
+         description->counter++;
+         database->internHits++;
+         database->savedBytes += size;
+         return description;
+      }
+   }
+
+   Description *description = allocateStored(length, stored, compressed, database);
+   if (indexed) {
+      hashMapInsert(database->descriptionIndex, description, hash);
+   }
+   return description;
+}
+
+/* Zmniejsza licznik referencji do opisu description,
+ * a jeżeli wynosi 0, usuwa go z pamięci. */
+void releaseDescription(Description *description, Database *database) {
+   description->counter--;
+   if (description->counter > 0) {
+      if (database->descriptionIndex != NULL) {
+         database->savedBytes -= descriptionSize(description->length);
+      }
+      return;
+   }
+   if (database->descriptionIndex != NULL && !description->spilled) {
+      hashMapRemove(database->descriptionIndex, description,
+                    hashKey(description->text, description->storedLength));
+   }
+   if (description->compressed) {
+      database->compressedTextBytes -= description->length;
+      database->compressedBytes -= description->storedLength;
    }
-   return lastDisease->disease;
+   if (description->spilled) {
+      uint64_t offset;
+      memcpy(&offset, description->text, sizeof(uint64_t));
+      blobFree(database->blobs, offset);
+   }
+   database->descriptionBytes -= descriptionSize(description->length);
+   releaseHeapObject(description, residentSize(description), database);
 }
 
-/* Zmniejsza licznik referencji do choroby disease,
+/* Tworzy chorobę o opisie description z zerowym licznikiem referencji.
+ * Zwraca NO_DISEASE, jeżeli zabrakło uchwytów (patrz newDisease). */
+DiseaseHandle createDisease(StringView description, Database *database) {
+   Description *stored = storeDescription(description, database);
+   DiseaseHandle disease = newDisease(stored, 0, database);
+   if (disease == NO_DISEASE) {
+      releaseDescription(stored, database);
+      return NO_DISEASE;
+   }
+   database->descriptions++;
+   return disease;
+}
+
+/* Zmniejsza licznik referencji do choroby o uchwycie handle,
  * a jeżeli wynosi 0, usuwa ją z pamięci. */
-void removeDisease(Disease *disease, Database *database) {
+void removeDisease(DiseaseHandle handle, Database *database) {
+   Disease *disease = diseaseAt(handle, database);
+   if (disease->counter == SHARED_DISEASE) {
+      recordReference(handle, -1, database);
+      return;
+   }
    disease->counter--;
    if (disease->counter == 0) {
       database->descriptions--;
-      free(disease->description);
-      free(disease);
+      releaseDescription(disease->description, database);
+      releaseDisease(handle, database);
    }
 }
 
-/* Usuwa wszystkie elementy z diseaseList
- * i na każdym z nich wywołuje removeDisease. */
-void removeDiseaseList(DiseaseList *diseaseList, Database *database) {
-   if (diseaseList == NULL) {
-      return;
+/* Wywołuje removeDisease na wszystkich chorobach z historii pacjenta patient
+ * i zwalnia tablicę historii. */
+void removeHistory(Patient *patient, Database *database) {
+   DiseaseHandle *history = patient->history;
+   int diseases = patient->diseases;
+   // Czytający, który zobaczy starą tablicę, zobaczy też zerową liczbę chorób.
+   __atomic_store_n(&patient->diseases, 0, __ATOMIC_RELEASE);
+   __atomic_store_n(&patient->history, NULL, __ATOMIC_RELEASE);
+   for (int i = diseases - 1; i >= 0; i--) {
+      database->historyBytes -= descriptionSize(diseaseAt(history[i], database)->description->length);
+      removeDisease(history[i], database);
    }
-   removeDiseaseList(diseaseList->next, database);
-   removeDisease(diseaseList->disease, database);
-   free(diseaseList);
+   database->historyEntries -= diseases;
+   releaseHeapObject(history, patient->capacity * sizeof(DiseaseHandle), database);
+   patient->capacity = 0;
 }
 
-// Usuwa z pamięci wszystkich pacjentów z patientList oraz ich choroby.
-void removePatientList(Patient *patientList, Database *database) {
-   if (patientList == NULL) {
-      return;
+bool applyNewDiseaseEnterDescription(StringView name, StringView description, Database *database) {
+   Patient *patient = findPatient(name, database);
+
+   DiseaseHandle disease = createDisease(description, database);
+   if (disease == NO_DISEASE) {
+      return false;
+   }
+   if (patient == NULL) {
+      patient = addPatient(name, database);
+   }
+
+   pushDisease(disease, patient, database);
+   return true;
+}
+
+bool applyNewDiseaseCopyDescription(StringView name1, StringView name2, Database *database) {
+   Patient *patient = findPatient(name1, database);
+   Patient *oldPatient = findPatient(name2, database);
+   if (oldPatient == NULL || oldPatient->diseases == 0) {
+      return false;
    }
-   removePatientList(patientList->next, database);
-   removeDiseaseList(patientList->diseaseList, database);
-   free(patientList->name);
-   free(patientList);
+
+   if (patient == NULL) {
+      patient = addPatient(name1, database);
+   }
+
+   pushDisease(getLastDisease(oldPatient), patient, database);
+   return true;
 }
 
-// Wypisuje komunikat DESCRIPTIONS na stderr jeżeli debug == true.
-void printDebug(Database *database, bool debug) {
-   if (debug) {
-      fprintf(stderr, "DESCRIPTIONS: %d\n", database->descriptions);
+bool applyChangeDescription(StringView name, int n, StringView description, Database *database) {
+   Patient *patient = findPatient(name, database);
+   if (patient == NULL) {
+      return false;
+   }
+
+   DiseaseHandle *disease = getDisease(patient, n);
+   if (disease == NULL) {
+      return false;
    }
+
+   DiseaseHandle changed = createDisease(description, database);
+   if (changed == NO_DISEASE) {
+      return false;
+   }
+   diseaseAt(changed, database)->counter = 1;
+
+   database->historyBytes += descriptionSize(description.length);
+   database->historyBytes -= descriptionSize(diseaseAt(*disease, database)->description->length);
+   DiseaseHandle oldDisease = *disease;
+   __atomic_store_n(disease, changed, __ATOMIC_RELEASE);
+   removeDisease(oldDisease, database);
+   return true;
 }
 
-// Funkcje poniżej tego komentarza są opisane w structure.h.
+bool applyDeletePatientData(StringView name, Database *database) {
+   Patient *patient = findPatient(name, database);
+   if (patient == NULL) {
+      return false;
+   }
 
-Database *initializeDatabase() {
-   Database *database = malloc(sizeof(Database));
-   database->patientList = NULL;
-   database->descriptions = 0;
-   return database;
+   removeHistory(patient, database);
+   return true;
 }
 
-void deleteDatabase(Database *database) {
-   removePatientList(database->patientList, database);
-   free(database);
+DiseaseHandle acquireLastDisease(StringView name, Database *database) {
+   Patient *patient = findPatient(name, database);
+   if (patient == NULL || patient->diseases == 0) {
+      return NO_DISEASE;
+   }
+   DiseaseHandle handle = getLastDisease(patient);
+   Disease *disease = diseaseAt(handle, database);
+   if (disease->counter == SHARED_DISEASE) {
+      recordReference(handle, 1, database);
+   }
+   else {
+      /* Dotąd wskazywały na nią tylko historie tej części, więc jej licznik
+       * jest zgodny z kolejnością poleceń i staje się początkową liczbą referencji. */
+      recordReference(handle, disease->counter + 1, database);
+      disease->counter = SHARED_DISEASE;
+   }
+   return handle;
+}
+
+void applyCopiedDisease(StringView name, DiseaseHandle disease, Database *database) {
+   Patient *patient = findPatient(name, database);
+   if (patient == NULL) {
+      patient = addPatient(name, database);
+   }
+   appendDisease(disease, patient, database);
+}
+
+void freeSharedDisease(DiseaseHandle disease, Database *database) {
+   Database *owner = database->shards[disease & ((1u << database->shardBits) - 1)];
+   pthread_mutex_lock(&owner->remoteMutex);
+   if (owner->remoteCount == owner->remoteCapacity) {
+      owner->remoteCapacity = (owner->remoteCapacity == 0) ? 64 : 2 * owner->remoteCapacity;
+      owner->remoteFrees = realloc(owner->remoteFrees, owner->remoteCapacity * sizeof(DiseaseHandle));
+   }
+   owner->remoteFrees[owner->remoteCount++] = disease;
+   pthread_mutex_unlock(&owner->remoteMutex);
 }
 
-void newDiseaseEnterDescription(char *name, char *description, Database *database, bool debug) {
-   Patient *patient = findPatient(database->patientList, name);
+void freeRemoteDiseases(Database *database) {
+   pthread_mutex_lock(&database->remoteMutex);
+   for (size_t i = 0; i < database->remoteCount; i++) {
+      releaseDescription(diseaseAt(database->remoteFrees[i], database)->description, database);
+      freeDisease(database->remoteFrees[i], database);
+   }
+   database->remoteCount = 0;
+   pthread_mutex_unlock(&database->remoteMutex);
+}
 
+bool applyPrintDescription(StringView name, int n, Database *database, StringView *description) {
+   Patient *patient = findPatient(name, database);
    if (patient == NULL) {
-      patient = malloc(sizeof(Patient));
-      patient->name = malloc((strlen(name) + 1) * sizeof(char));
-      strcpy(patient->name, name);
-      patient->diseaseList = NULL;
-      patient->next = NULL;
+      return false;
+   }
 
-      pushPatient(patient, database);
+   DiseaseHandle *disease = getDisease(patient, n);
+   if (disease == NULL) {
+      return false;
    }
 
-   Disease *newDisease = malloc(sizeof(Disease));
-   newDisease->description = malloc((strlen(description) + 1) * sizeof(char));
-   strcpy(newDisease->description, description);
-   newDisease->counter = 0;
-   pushDisease(newDisease, patient);
-   database->descriptions++;
+   *description = descriptionText(diseaseAt(*disease, database)->description, database);
+   return true;
+}
 
-   puts(OK_MESSAGE);
-   printDebug(database, debug);
+bool applySaveSnapshot(StringView path, Database *database) {
+   // Części struktury zmieniają się w osobnych wątkach, więc nie mają wspólnego stanu do zapisania.
+   if (database->shards != NULL) {
+      return false;
+   }
+   char *fileName = malloc(path.length + 1);
+   memcpy(fileName, path.data, path.length);
+   fileName[path.length] = '\0';
+   bool saved = saveSnapshot(database, fileName);
+   free(fileName);
+   return saved;
 }
 
-void newDiseaseCopyDescription(char *name1, char *name2, Database *database, bool debug) {
-   Patient *patient = findPatient(database->patientList, name1);
-   Patient *oldPatient = findPatient(database->patientList, name2);
-   if (oldPatient == NULL || oldPatient->diseaseList == NULL) {
-      puts(IGNORED_MESSAGE);
-      printDebug(database, debug);
-      return;
+bool applyMutation(Mutation *mutation, Database *database) {
+   bool applied = false;
+   switch (mutation->type) {
+      case EnterDescriptionMutation:
+         applied = applyNewDiseaseEnterDescription(mutation->atr1, mutation->atr2, database);
+         break;
+      case CopyDescriptionMutation:
+         applied = applyNewDiseaseCopyDescription(mutation->atr1, mutation->atr2, database);
+         break;
+      case ChangeDescriptionMutation:
+         applied = applyChangeDescription(mutation->atr1, mutation->n, mutation->atr2, database);
+         break;
+      case DeletePatientMutation:
+         applied = applyDeletePatientData(mutation->atr1, database);
+         break;
+   }
+   // Po błędzie struktury dziennik nie jest już zapisywany.
+   if (applied && database->log != NULL && database->failure[0] == '\0') {
+      appendToLog(mutation, database);
    }
+   if (database->epochs != NULL) {
+      reclaimObjects(database->epochs);
+   }
+   return applied;
+}
 
-   if (patient == NULL) {
-      patient = malloc(sizeof(Patient));
-      patient->name = malloc((strlen(name1) + 1) * sizeof(char));
-      strcpy(patient->name, name1);
-      patient->diseaseList = NULL;
-      patient->next = NULL;
+/* Zwraca wynik polecenia, które zostało wykonane (applied) albo zignorowane,
+ * chyba że w jego trakcie wystąpił błąd struktury database. */
+CommandStatus commandStatus(bool applied, Database *database) {
+   if (databaseFailure(database) != NULL) {
+      return FailedStatus;
+   }
+   return applied ? OkStatus : IgnoredStatus;
+}
+
+void addShardStatistics(Database *database, DatabaseStatistics *statistics) {
+   statistics->patients += hashMapSize(database->patients);
+   statistics->descriptions += database->descriptions;
+   statistics->descriptionBytes += database->descriptionBytes;
+   statistics->sharedBytes += database->historyBytes - database->descriptionBytes;
+   statistics->historyEntries += database->historyEntries;
+   if (database->blobs != NULL) {
+      statistics->spilledBytes += blobLiveBytes(database->blobs);
+   }
+   statistics->compressedTextBytes += database->compressedTextBytes;
+   statistics->compressedBytes += database->compressedBytes;
+   if (database->descriptionIndex != NULL) {
+      statistics->interning = true;
+      statistics->internedDescriptions += hashMapSize(database->descriptionIndex);
+   }
+   statistics->internHits += database->internHits;
+   statistics->internSavedBytes += database->savedBytes;
+}
+
+// Tworzy pustą część struktury (całą strukturę, jeżeli nie jest dzielona).
+Database *createShard(DatabaseOptions *options) {
+   Database *database = malloc(sizeof(Database));
+   database->patients = createHashMap(patientKey);
+   database->patientPool = createPool(sizeof(Patient));
+   // Numer części zajmuje najmłodsze bity uchwytów chorób.
+   database->shardBits = 0;
+   while ((1 << database->shardBits) < options->shards) {
+      database->shardBits++;
+   }
+   database->diseases = createObjectTable(sizeof(Disease), (uint32_t) ((1ULL << (32 - database->shardBits)) - 1));
+   database->heap = createHeap();
+   database->names = createArena();
+   database->descriptions = 0;
+   database->descriptionIndex = NULL;
+   if (options->internDescriptions) {
+      database->descriptionIndex = createHashMap(descriptionKey);
+   }
+   database->internHits = 0;
+   database->savedBytes = 0;
+   database->descriptionBytes = 0;
+   database->historyEntries = 0;
+   database->historyBytes = 0;
+   database->blobs = NULL;
+   database->spillThreshold = 0;
+   database->compressor = NULL;
+   if (options->compressDescriptions) {
+      database->compressor = createCompressor(options->dictionarySamples);
+   }
+   database->decoded = NULL;
+   database->decodedCapacity = 0;
+   database->compressedTextBytes = 0;
+   database->compressedBytes = 0;
+   database->snapshot = NULL;
+   database->generation = 0;
+   database->log = NULL;
+   database->shards = NULL;
+   database->shard = 0;
+   database->shardCount = 1;
+   pthread_mutex_init(&database->remoteMutex, NULL);
+   database->remoteFrees = NULL;
+   database->remoteCount = 0;
+   database->remoteCapacity = 0;
+   database->events = NULL;
+   database->eventCount = 0;
+   database->eventCapacity = 0;
+   database->command = 0;
+   database->epochs = NULL;
+   database->failure[0] = '\0';
+   return database;
+}
+
+// Zwalnia pamięć zajmowaną przez część struktury database.
+void deleteShard(Database *database) {
+   // Pacjenci, choroby i opisy leżą w pulach i tablicach, więc nie trzeba ich usuwać pojedynczo.
+   closeWriteAheadLog(database);
+   if (database->epochs != NULL) {
+      deleteEpochDomain(database->epochs);
+   }
+   closeSnapshot(database);
+   if (database->blobs != NULL) {
+      closeBlobStore(database->blobs);
+   }
+   if (database->compressor != NULL) {
+      deleteCompressor(database->compressor);
+   }
+   free(database->decoded);
+   deleteHashMap(database->patients);
+   deletePool(database->patientPool);
+   deleteObjectTable(database->diseases);
+   deleteHeap(database->heap);
+   deleteArena(database->names);
+   if (database->descriptionIndex != NULL) {
+      deleteHashMap(database->descriptionIndex);
+   }
+   pthread_mutex_destroy(&database->remoteMutex);
+   free(database->remoteFrees);
+   free(database->events);
+   free(database);
+}
+
+// Funkcje poniżej tego komentarza są opisane w structure.h.
 
-      pushPatient(patient, database);
+Database *initializeDatabase(DatabaseOptions *options) {
+   Database *database = createShard(options);
+   if (options->shards > 1) {
+      Database **shards = malloc(options->shards * sizeof(Database *));
+      shards[0] = database;
+      for (int i = 1; i < options->shards; i++) {
+         shards[i] = createShard(options);
+      }
+      for (int i = 0; i < options->shards; i++) {
+         shards[i]->shards = shards;
+         shards[i]->shard = i;
+         shards[i]->shardCount = options->shards;
+      }
    }
+   return database;
+}
 
-   pushDisease(getLastDisease(oldPatient), patient);
+void deleteDatabase(Database *database) {
+   Database **shards = database->shards;
+   for (uint32_t i = 1; shards != NULL && i < database->shardCount; i++) {
+      deleteShard(shards[i]);
+   }
+   free(shards);
+   deleteShard(database);
+}
 
-   puts(OK_MESSAGE);
-   printDebug(database, debug);
+bool spillDescriptions(Database *database, const char *path, size_t threshold) {
+   database->blobs = openBlobStore(path, moveDescription);
+   database->spillThreshold = threshold;
+   return database->blobs != NULL;
 }
 
-void changeDescription(char *name, int n, char *description, Database *database, bool debug) {
-   Patient *patient = findPatient(database->patientList, name);
-   if (patient == NULL) {
-      puts(IGNORED_MESSAGE);
-      printDebug(database, debug);
-      return;
+// Odtwarza historię pacjenta patient, jeżeli jeszcze nie została odtworzona z migawki.
+void materializeVisited(void *patient, void *database) {
+   if (((Patient *) patient)->snapshotHistory != NULL) {
+      materializePatient(patient, database);
    }
+}
 
-   DiseaseList *diseaseList = patient->diseaseList;
-   for (int i = 1; i < n; i++) {
-      if (diseaseList == NULL) {
-         puts(IGNORED_MESSAGE);
-         printDebug(database, debug);
-         return;
+bool enableConcurrentReaders(Database *database) {
+   if (database->shards != NULL || database->blobs != NULL) {
+      return false;
+   }
+   if (database->epochs == NULL) {
+      // Czytający nie mogą odtwarzać historii z migawki, więc robimy to od razu.
+      hashMapForEach(database->patients, materializeVisited, database);
+      if (database->failure[0] != '\0') {
+         return false;
       }
-      diseaseList = diseaseList->next;
+      database->epochs = createEpochDomain(database);
+      hashMapDeferRelease(database->patients, retireTable, database);
    }
-   if (diseaseList == NULL) {
-      puts(IGNORED_MESSAGE);
-      printDebug(database, debug);
-      return;
+   return true;
+}
+
+DatabaseReader *createDatabaseReader(Database *database) {
+   if (database->epochs == NULL) {
+      return NULL;
    }
+   DatabaseReader *reader = malloc(sizeof(DatabaseReader));
+   reader->database = database;
+   reader->epoch = registerEpochReader(database->epochs);
+   reader->text = NULL;
+   reader->capacity = 0;
+   return reader;
+}
 
-   Disease *newDisease = malloc(sizeof(Disease));
-   newDisease->description = malloc((strlen(description) + 1) * sizeof(char));
-   strcpy(newDisease->description, description);
-   newDisease->counter = 1;
+void deleteDatabaseReader(DatabaseReader *reader) {
+   unregisterEpochReader(reader->database->epochs, reader->epoch);
+   free(reader->text);
+   free(reader);
+}
 
-   removeDisease(diseaseList->disease, database);
-   diseaseList->disease = newDisease;
+/* Kopiuje do bufora czytającego reader treść n-tej choroby pacjenta patient,
+ * widzianą w chwili odczytu. Zwraca false, jeżeli nie ma takiej choroby. */
+bool readDisease(DatabaseReader *reader, Patient *patient, int n) {
+   /* Liczba chorób nie przekracza pojemności tablicy, na którą wskazywała
+    * historia przed jej odczytaniem i po nim (tablica, do której mamy dostęp,
+    * nie jest zwalniana, więc jej adres nie może wrócić do historii). */
+   DiseaseHandle *history;
+   int diseases;
+   do {
+      history = __atomic_load_n(&patient->history, __ATOMIC_ACQUIRE);
+      diseases = __atomic_load_n(&patient->diseases, __ATOMIC_ACQUIRE);
+   } while (history != __atomic_load_n(&patient->history, __ATOMIC_ACQUIRE));
+   int index = (n > 1) ? n - 1 : 0;
+   if (history == NULL || index >= diseases) {
+      return false;
+   }
 
-   database->descriptions++;
+   DiseaseHandle handle = __atomic_load_n(&history[index], __ATOMIC_ACQUIRE);
+   Description *description = diseaseAt(handle, reader->database)->description;
+   if (reader->capacity < description->length) {
+      reader->capacity = description->length;
+      reader->text = realloc(reader->text, reader->capacity);
+   }
+   if (description->compressed) {
+      decompressDescription(description, reader->database, reader->text);
+   }
+   else {
+      memcpy(reader->text, description->text, description->length);
+   }
+   reader->length = description->length;
+   return true;
+}
 
-   puts(OK_MESSAGE);
-   printDebug(database, debug);
+CommandStatus readDescription(DatabaseReader *reader, StringView name, int n, StringView *description) {
+   Database *database = reader->database;
+   enterEpoch(database->epochs, reader->epoch);
+   Patient *patient = hashMapFindConcurrently(database->patients, name.data, name.length,
+                                              hashKey(name.data, name.length));
+   bool found = patient != NULL && readDisease(reader, patient, n);
+   leaveEpoch(reader->epoch);
+   if (!found) {
+      return IgnoredStatus;
+   }
+   *description = (StringView) {.data = reader->text, .length = reader->length};
+   return OkStatus;
 }
 
-void printDescription(char *name, int n, Database *database, bool debug) {
-   Patient *patient = findPatient(database->patientList, name);
-   if (patient == NULL) {
-      puts(IGNORED_MESSAGE);
-      printDebug(database, debug);
-      return;
+void collectStatistics(Database *database, DatabaseStatistics *statistics) {
+   memset(statistics, 0, sizeof(DatabaseStatistics));
+   for (uint32_t i = 0; i < database->shardCount; i++) {
+      addShardStatistics((database->shards == NULL) ? database : database->shards[i], statistics);
    }
+}
 
-   DiseaseList *diseaseList = patient->diseaseList;
-   for (int i = 1; i < n; i++) {
-      if (diseaseList == NULL) {
-         puts(IGNORED_MESSAGE);
-         printDebug(database, debug);
-         return;
+const char *databaseFailure(Database *database) {
+   for (uint32_t i = 0; i < database->shardCount; i++) {
+      Database *shard = (database->shards == NULL) ? database : database->shards[i];
+      if (shard->failure[0] != '\0') {
+         return shard->failure;
       }
-      diseaseList = diseaseList->next;
    }
-   if (diseaseList == NULL) {
-      puts(IGNORED_MESSAGE);
-      printDebug(database, debug);
-      return;
+   return NULL;
+}
+
+// Wykonuje polecenie mutation i zwraca jego wynik (patrz commandStatus).
+CommandStatus executeMutation(Mutation *mutation, Database *database) {
+   if (databaseFailure(database) != NULL) {
+      return FailedStatus;
    }
+   return commandStatus(applyMutation(mutation, database), database);
+}
 
-   printf("%s\n", diseaseList->disease->description);
-   printDebug(database, debug);
+CommandStatus newDiseaseEnterDescription(StringView name, StringView description, Database *database) {
+   Mutation mutation = {.type = EnterDescriptionMutation, .atr1 = name, .atr2 = description};
+   return executeMutation(&mutation, database);
 }
 
-void deletePatientData(char *name, Database *database, bool debug) {
-   Patient *patient = findPatient(database->patientList, name);
-   if (patient == NULL) {
-      puts(IGNORED_MESSAGE);
-      printDebug(database, debug);
-      return;
+CommandStatus newDiseaseCopyDescription(StringView name1, StringView name2, Database *database) {
+   Mutation mutation = {.type = CopyDescriptionMutation, .atr1 = name1, .atr2 = name2};
+   return executeMutation(&mutation, database);
+}
+
+CommandStatus changeDescription(StringView name, int n, StringView description, Database *database) {
+   Mutation mutation = {.type = ChangeDescriptionMutation, .atr1 = name, .n = n, .atr2 = description};
+   return executeMutation(&mutation, database);
+}
+
+CommandStatus getDescription(StringView name, int n, Database *database, StringView *description) {
+   if (databaseFailure(database) != NULL) {
+      return FailedStatus;
    }
+   return commandStatus(applyPrintDescription(name, n, database, description), database);
+}
 
-   removeDiseaseList(patient->diseaseList, database);
-   patient->diseaseList = NULL;
+CommandStatus deletePatientData(StringView name, Database *database) {
+   Mutation mutation = {.type = DeletePatientMutation, .atr1 = name};
+   return executeMutation(&mutation, database);
+}
+
+CommandStatus snapshotDatabase(StringView path, Database *database) {
+   if (database->shards != NULL) {
+      return IgnoredStatus;
+   }
+   if (databaseFailure(database) != NULL) {
+      return FailedStatus;
+   }
+   return applySaveSnapshot(path, database) ? OkStatus : FailedStatus;
+}
 
-   puts(OK_MESSAGE);
-   printDebug(database, debug);
+int countDescriptions(Database *database) {
+   int descriptions = 0;
+   for (uint32_t i = 0; i < database->shardCount; i++) {
+      descriptions += ((database->shards == NULL) ? database : database->shards[i])->descriptions;
+   }
+   return descriptions;
 }
@@ -2,30 +2,165 @@
 #define STRUCTURE_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include "view.h"
+
+// Domyślny rozmiar dziennika (w bajtach), po przekroczeniu którego jest kompaktowany.
+#define DEFAULT_LOG_COMPACTION_SIZE (64 << 20)
+
+// Domyślna długość (w bajtach), od której opisy są przenoszone do pliku (spillDescriptions).
+#define DEFAULT_SPILL_THRESHOLD 4096
+
+// Domyślna liczba opisów, z których budowany jest słownik kompresji opisów.
+#define DEFAULT_DICTIONARY_SAMPLES 1000
+
+/* Funkcje z tego pliku są jedynymi symbolami eksportowanymi przez libhospital.so
+ * (pozostałe obiekty biblioteki są kompilowane z -fvisibility=hidden). */
+#define HOSPITAL_API __attribute__((visibility("default")))
 
 typedef struct Database Database;
 
-// Alkouje pamięć oraz inicjuje strukturę danych.
-Database *initializeDatabase();
+// Opcje struktury danych, ustalane przy jej tworzeniu.
+typedef struct DatabaseOptions {
+   /* Czy opisy o identycznej treści mają być przechowywane raz
+    * (niezależnie od tego, którym poleceniem zostały wprowadzone). */
+   bool internDescriptions;
+   /* Liczba części, na które dzielona jest struktura (po jednym wątku
+    * wykonującym polecenia na część, patrz pipeline.h). */
+   int shards;
+   /* Czy opisy mają być kompresowane ze słownikiem zbudowanym
+    * z pierwszych dictionarySamples opisów (patrz compress.h). */
+   bool compressDescriptions;
+   size_t dictionarySamples;
+} DatabaseOptions;
+
+// Statystyki struktury danych wypisywane przez polecenie STATS.
+typedef struct DatabaseStatistics {
+   size_t patients;
+   int descriptions;
+   size_t descriptionBytes; // Pamięć zajmowana przez opisy (również przeniesione do pliku).
+   size_t spilledBytes; // Łączna długość opisów przeniesionych do pliku.
+   size_t sharedBytes; // Pamięć oszczędzana dzięki współdzieleniu opisów przez wpisy historii.
+   size_t historyEntries; // Łączna długość historii pacjentów.
+   // Łączna długość opisów skompresowanych i ich postaci skompresowanych.
+   size_t compressedTextBytes, compressedBytes;
+   bool interning; // Czy opisy są internowane (pozostałe pola internowania są wtedy zerowe).
+   size_t internedDescriptions; // Liczba różnych treści opisów.
+   size_t internHits; // Liczba opisów, dla których znaleziono identyczną treść.
+   size_t internSavedBytes; // Pamięć zaoszczędzona obecnie dzięki internowaniu.
+} DatabaseStatistics;
+
+// Wynik polecenia.
+typedef enum CommandStatus {
+   OkStatus,
+   IgnoredStatus, // Polecenie nie dotyczy żadnych danych (np. pacjent nie ma takiej choroby).
+   /* Polecenia nie udało się wykonać (np. zapisać migawki). Jeżeli
+    * databaseFailure nie zwraca NULL, struktura nie wykonuje już poleceń. */
+   FailedStatus
+} CommandStatus;
+
+// Alkouje pamięć oraz inicjuje strukturę danych z opcjami options.
+HOSPITAL_API Database *initializeDatabase(DatabaseOptions *options);
 
 // Zwalnia pamięć zajmowaną przez database.
-void deleteDatabase(Database *database);
+HOSPITAL_API void deleteDatabase(Database *database);
+
+// Zapisuje w statistics statystyki database (sumy dla wszystkich części).
+HOSPITAL_API void collectStatistics(Database *database, DatabaseStatistics *statistics);
+
+/* Zapisuje stan database do pliku path (zastępując go w całości).
+ * Zwraca false, jeżeli zapis się nie powiódł. */
+HOSPITAL_API bool saveSnapshot(Database *database, const char *path);
+
+/* Wczytuje stan zapisany przez saveSnapshot z pliku path do pustej database.
+ * Plik jest mapowany do pamięci, a historie chorób pacjentów są odtwarzane
+ * dopiero przy pierwszym odwołaniu do pacjenta, więc czas wczytania zależy
+ * tylko od liczby pacjentów. Zwraca false, jeżeli pliku nie da się wczytać. */
+HOSPITAL_API bool loadSnapshot(Database *database, const char *path);
+
+/* Włącza dziennik zapisu z wyprzedzeniem w pliku path: odtwarza w pustej
+ * database stan z migawki path.snapshot i poleceń zapisanych w dzienniku,
+ * a następnie dopisuje do niego każde wykonane polecenie modyfikujące database.
+ * Gdy dziennik przekroczy compactionSize bajtów, stan jest zapisywany
+ * do migawki, a dziennik zaczyna się od nowa. Zwraca false, jeżeli
+ * dziennika lub migawki nie da się wczytać. */
+HOSPITAL_API bool openWriteAheadLog(Database *database, const char *path, size_t compactionSize);
+
+/* Włącza przenoszenie treści opisów o długości co najmniej threshold
+ * do pliku tymczasowego path, czytanego przez mapowanie do pamięci, dzięki
+ * czemu w pamięci zostają tylko treści, do których program się odwołuje.
+ * Miejsce po usuniętych opisach jest stopniowo odzyskiwane (patrz blob.h).
+ * Należy wywołać na pustej database. Zwraca false, jeżeli nie udało się
+ * utworzyć pliku. */
+HOSPITAL_API bool spillDescriptions(Database *database, const char *path, size_t threshold);
+
+/* Zapisuje trwale polecenia dopisane do dziennika (jednym fsync dla wszystkich).
+ * Potwierdzenia poleceń wolno wypisać dopiero po wywołaniu tej funkcji i tylko
+ * wtedy, gdy zwróciła true (false oznacza błąd struktury, patrz databaseFailure). */
+HOSPITAL_API bool syncWriteAheadLog(Database *database);
+
+/* Zwraca opis błędu, po którym database przestała wykonywać polecenia (wszystkie
+ * zwracają od tej chwili FailedStatus), albo NULL, jeżeli go nie było. Takim błędem
+ * jest nieudany zapis dziennika, uszkodzona migawka odkryta przy odtwarzaniu
+ * historii pacjenta i brak miejsca na nowe choroby. Strukturę, w której wystąpił,
+ * można już tylko usunąć (bez gwarancji, że dziennik zawiera jej ostatnie zmiany). */
+HOSPITAL_API const char *databaseFailure(Database *database);
+
+/* Funkcje poniżej kopiują z argumentów tylko te dane, które zapamiętują,
+ * więc argumenty mogą wskazywać na bufor wejścia. Niczego nie wypisują
+ * (odpowiedzi programu hospital wypisuje command.h). Struktura podzielona
+ * na części (DatabaseOptions::shards > 1) może być zmieniana tylko przez
+ * runPipeline z pipeline.h. */
 
 // Dodaje informację o chorobie pacjenta o nazwisku name.
-void newDiseaseEnterDescription(char *name, char *description, Database *database, bool debug);
+HOSPITAL_API CommandStatus newDiseaseEnterDescription(StringView name, StringView description, Database *database);
 
 /* Dodaje informację o chorobie pacjenta o nazwisku name1.
  * Opis nowej choroby jest taki sam, jak
  * aktualny opis ostatnio zarejestrowanej choroby pacjenta o nazwisku name2. */
-void newDiseaseCopyDescription(char *name1, char *name2, Database *database, bool debug);
+HOSPITAL_API CommandStatus newDiseaseCopyDescription(StringView name1, StringView name2, Database *database);
 
 // Aktualizuje opis n-tej choroby pacjenta o nazwisku name.
-void changeDescription(char *name, int n, char *description, Database *database, bool debug);
+HOSPITAL_API CommandStatus changeDescription(StringView name, int n, StringView description, Database *database);
 
-// Wypisuje na standardowe wyjście opis n-tej choroby pacjenta o nazwisku name.
-void printDescription(char *name, int n, Database *database, bool debug);
+/* Zapisuje w description opis n-tej choroby pacjenta o nazwisku name (polecenie
+ * PRINT_DESCRIPTION). Opis nie jest kopiowany: wskazuje na pamięć database
+ * i jest ważny do następnego wywołania funkcji z tego pliku dla database. */
+HOSPITAL_API CommandStatus getDescription(StringView name, int n, Database *database, StringView *description);
 
 // Usuwa historię chorób pacjenta o nazwisku name.
-void deletePatientData(char *name, Database *database, bool debug);
+HOSPITAL_API CommandStatus deletePatientData(StringView name, Database *database);
+
+// Zapisuje stan database do pliku o nazwie path (polecenie SNAPSHOT).
+HOSPITAL_API CommandStatus snapshotDatabase(StringView path, Database *database);
+
+// Zwraca liczbę chorób w database.
+HOSPITAL_API int countDescriptions(Database *database);
+
+/* Odczyty opisów z innych wątków. Jeden wątek zmienia strukturę funkcjami
+ * powyżej, a dowolnie wiele innych równocześnie wykonuje readDescription,
+ * nie zakładając żadnych blokad: usunięte choroby i opisy są zwalniane
+ * dopiero wtedy, gdy żaden odczyt ich nie widzi (patrz epoch.h). */
+
+/* Włącza odczyty z innych wątków. Należy ją wywołać przed utworzeniem
+ * pierwszego czytającego, a po wczytaniu migawki i dziennika (odtwarza od razu
+ * wszystkie historie z migawki). Zwraca false, jeżeli struktura jest
+ * podzielona na części albo przenosi opisy do pliku. */
+HOSPITAL_API bool enableConcurrentReaders(Database *database);
+
+// Stan wątku czytającego.
+typedef struct DatabaseReader DatabaseReader;
+
+/* Tworzy czytającego dla bieżącego wątku (każdy wątek potrzebuje własnego).
+ * Zwraca NULL, jeżeli odczyty z innych wątków nie zostały włączone. */
+HOSPITAL_API DatabaseReader *createDatabaseReader(Database *database);
+
+// Usuwa czytającego (przed usunięciem struktury).
+HOSPITAL_API void deleteDatabaseReader(DatabaseReader *reader);
+
+/* Jak getDescription, ale z wątku czytającego reader, równocześnie ze
+ * zmianami struktury. Opis jest kopiowany do bufora czytającego i jest ważny
+ * do następnego wywołania dla reader. */
+HOSPITAL_API CommandStatus readDescription(DatabaseReader *reader, StringView name, int n, StringView *description);
 
 #endif // STRUCTURE_H
@@ -0,0 +1,13 @@
+#ifndef VIEW_H
+#define VIEW_H
+
+#include <stddef.h>
+
+/* Fragment napisu przechowywanego gdzie indziej (np. w buforze wejścia):
+ * wskaźnik na pierwszy znak i długość. Nie musi kończyć się znakiem '\0'. */
+typedef struct StringView {
+   const char *data;
+   size_t length;
+} StringView;
+
+#endif // VIEW_H
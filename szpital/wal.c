@@ -0,0 +1,393 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "database.h"
+
+/* Format dziennika: LogHeader, a po nim kolejne rekordy postaci
+ *    typ (MutationType, 1 bajt),
+ *    długość atr1, [długość atr2], [n] (liczby zapisane po 7 bitów na bajt),
+ *    atr1, [atr2],
+ *    suma kontrolna (32 bity skrótu hashKey z poprzednich bajtów rekordu).
+ * atr2 występuje we wszystkich poleceniach poza DELETE_PATIENT_DATA,
+ * a n tylko w CHANGE_DESCRIPTION. Zapis przerwany awarią zostawia na końcu
+ * niepełny rekord, który przy odtwarzaniu jest odrzucany. */
+
+#define LOG_MAGIC "HOSPWAL1"
+
+/* Rozmiar bufora, w którym zbierane są rekordy przed zapisem do pliku.
+ * Dla dłuższego rekordu bufor jest powiększany na czas jego zapisu. */
+#define LOG_BUFFER_SIZE (1 << 20)
+
+// Największy rozmiar rekordu bez atr1 i atr2: typ, trzy liczby i suma kontrolna.
+#define MAX_RECORD_OVERHEAD (1 + 3 * 5 + 4)
+
+typedef struct LogHeader {
+   char magic[8];
+   uint64_t generation; // Numer migawki, od której zaczynają się polecenia.
+} LogHeader;
+
+struct WriteAheadLog {
+   int fd;
+   char *path;
+   char *snapshotPath; // Migawka, do której dziennik jest kompaktowany.
+   char *buffer;
+   size_t used, capacity;
+   uint64_t size; // Rozmiar pliku razem z zawartością bufora.
+   bool dirty; // Czy są dopisane polecenia, które nie zostały zapisane trwale.
+   uint64_t compactionSize;
+   uint64_t snapshotSize;
+};
+
+/* Zgłasza błąd struktury database, jeżeli nie da się zapisać dziennika - polecenia
+ * nie zostaną już potwierdzone (patrz syncWriteAheadLog). */
+static void logFailure(const char *operation, Database *database) {
+   char message[64];
+   snprintf(message, sizeof(message), "write-ahead log %s", operation);
+   failDatabase(database, message, errno);
+}
+
+static bool writeAll(int fd, const char *data, size_t length) {
+   while (length > 0) {
+      ssize_t written = write(fd, data, length);
+      if (written < 0) {
+         if (errno == EINTR) {
+            continue;
+         }
+         return false;
+      }
+      data += written;
+      length -= written;
+   }
+   return true;
+}
+
+static char *encodeNumber(char *position, uint32_t value) {
+   while (value >= 0x80) {
+      *position++ = (char) (value | 0x80);
+      value >>= 7;
+   }
+   *position++ = (char) value;
+   return position;
+}
+
+static bool decodeNumber(const char **position, const char *end, uint32_t *value) {
+   *value = 0;
+   for (int shift = 0; shift < 35 && *position < end; shift += 7) {
+      unsigned char byte = *(*position)++;
+      *value |= (uint32_t) (byte & 0x7F) << shift;
+      if (byte < 0x80) {
+         return true;
+      }
+   }
+   return false;
+}
+
+static uint32_t checksum(const char *record, size_t length) {
+   return (uint32_t) hashKey(record, length);
+}
+
+/* Odczytuje z [*position, end) rekord do *mutation (atr1 i atr2 wskazują
+ * na odczytywane dane). Zwraca false, jeżeli rekord jest niepełny lub uszkodzony. */
+static bool decodeRecord(const char **position, const char *end, Mutation *mutation) {
+   const char *record = *position;
+   const char *current = record;
+   if (current == end || (unsigned char) *current > DeletePatientMutation) {
+      return false;
+   }
+   mutation->type = (unsigned char) *current++;
+
+   uint32_t length1, length2 = 0, n = 0;
+   if (!decodeNumber(&current, end, &length1)) {
+      return false;
+   }
+   if (mutation->type != DeletePatientMutation && !decodeNumber(&current, end, &length2)) {
+      return false;
+   }
+   if (mutation->type == ChangeDescriptionMutation && !decodeNumber(&current, end, &n)) {
+      return false;
+   }
+   if (length1 > (size_t) (end - current) || length2 > (size_t) (end - current) - length1
+       || sizeof(uint32_t) > (size_t) (end - current) - length1 - length2) {
+      return false;
+   }
+   mutation->n = (int) n;
+   mutation->atr1 = (StringView) {.data = current, .length = length1};
+   current += length1;
+   mutation->atr2 = (StringView) {.data = current, .length = length2};
+   current += length2;
+
+   uint32_t sum;
+   memcpy(&sum, current, sizeof(uint32_t));
+   if (sum != checksum(record, current - record)) {
+      return false;
+   }
+   *position = current + sizeof(uint32_t);
+   return true;
+}
+
+/* Wykonuje na database polecenia z dziennika otwartego jako fd o rozmiarze size
+ * i zapisuje w *valid długość jego poprawnej części. Zwraca false, jeżeli
+ * dziennika nie da się odczytać albo jego polecenia spowodowały błąd struktury. */
+static bool replayLog(int fd, uint64_t size, Database *database, uint64_t *valid) {
+   *valid = size;
+   if (size == sizeof(LogHeader)) {
+      return true;
+   }
+   char *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+   if (data == MAP_FAILED) {
+      return false;
+   }
+   const char *position = data + sizeof(LogHeader);
+   const char *end = data + size;
+   // Dziennik nie jest jeszcze podłączony do database, więc polecenia nie są do niego dopisywane.
+   Mutation mutation;
+   while (database->failure[0] == '\0' && decodeRecord(&position, end, &mutation)) {
+      applyMutation(&mutation, database);
+   }
+   *valid = position - data;
+   munmap(data, size);
+   return database->failure[0] == '\0';
+}
+
+/* Tworzy pusty dziennik path zaczynający się od migawki generation
+ * i zwraca jego deskryptor (-1, jeżeli się nie udało). Plik jest
+ * zapisywany pod inną nazwą i podmieniany dopiero po zapisaniu trwale. */
+static int createLog(const char *path, const char *temporaryPath, uint64_t generation) {
+   int fd = open(temporaryPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+   if (fd < 0) {
+      return -1;
+   }
+   LogHeader header;
+   memset(&header, 0, sizeof(LogHeader));
+   memcpy(header.magic, LOG_MAGIC, sizeof(header.magic));
+   header.generation = generation;
+   if (!writeAll(fd, (const char *) &header, sizeof(LogHeader)) || fsync(fd) != 0
+       || (path != NULL && rename(temporaryPath, path) != 0)) {
+      close(fd);
+      unlink(temporaryPath);
+      return -1;
+   }
+   return fd;
+}
+
+static char *concatenate(const char *text, const char *suffix) {
+   size_t length = strlen(text);
+   char *result = malloc(length + strlen(suffix) + 1);
+   memcpy(result, text, length);
+   strcpy(result + length, suffix);
+   return result;
+}
+
+static void deleteLog(WriteAheadLog *log) {
+   if (log->fd >= 0) {
+      close(log->fd);
+   }
+   free(log->path);
+   free(log->snapshotPath);
+   free(log->buffer);
+   free(log);
+}
+
+// Zapisuje do pliku zawartość bufora dziennika database.
+static void writeBuffer(Database *database) {
+   WriteAheadLog *log = database->log;
+   if (!writeAll(log->fd, log->buffer, log->used)) {
+      logFailure("write", database);
+   }
+   log->used = 0;
+   if (log->capacity > LOG_BUFFER_SIZE) {
+      log->capacity = LOG_BUFFER_SIZE;
+      log->buffer = realloc(log->buffer, log->capacity);
+   }
+}
+
+// Zwraca false, jeżeli nie udało się zapisać trwale dziennika database.
+static bool syncLog(Database *database) {
+   WriteAheadLog *log = database->log;
+   writeBuffer(database);
+   if (database->failure[0] == '\0' && fdatasync(log->fd) != 0) {
+      logFailure("sync", database);
+   }
+   log->dirty = false;
+   return database->failure[0] == '\0';
+}
+
+/* Zapisuje stan database do migawki i zastępuje dziennik pustym.
+ * Po awarii w trakcie kompaktowania stary dziennik ma numer migawki mniejszy
+ * niż nowa migawka, więc przy odtwarzaniu jest pomijany. */
+static void compactLog(Database *database) {
+   WriteAheadLog *log = database->log;
+   char *temporaryPath = concatenate(log->path, ".tmp");
+   int fd = createLog(NULL, temporaryPath, database->generation + 1);
+   if (fd < 0) {
+      free(temporaryPath);
+      return;
+   }
+
+   database->generation++;
+   if (!saveSnapshot(database, log->snapshotPath)) {
+      database->generation--;
+      close(fd);
+      unlink(temporaryPath);
+      free(temporaryPath);
+      return;
+   }
+   // Od tej chwili stary dziennik jest nieaktualny, więc nie wolno dalej do niego pisać.
+   if (rename(temporaryPath, log->path) != 0) {
+      logFailure("compaction", database);
+      close(fd);
+      unlink(temporaryPath);
+      free(temporaryPath);
+      return;
+   }
+   free(temporaryPath);
+
+   struct stat status;
+   log->snapshotSize = (stat(log->snapshotPath, &status) == 0) ? (uint64_t) status.st_size : 0;
+   close(log->fd);
+   log->fd = fd;
+   log->size = sizeof(LogHeader);
+}
+
+bool openWriteAheadLog(Database *database, const char *path, size_t compactionSize) {
+   WriteAheadLog *log = malloc(sizeof(WriteAheadLog));
+   log->fd = -1;
+   log->path = concatenate(path, "");
+   log->snapshotPath = concatenate(path, ".snapshot");
+   log->buffer = malloc(LOG_BUFFER_SIZE);
+   log->used = 0;
+   log->capacity = LOG_BUFFER_SIZE;
+   log->dirty = false;
+   log->compactionSize = compactionSize;
+   log->snapshotSize = 0;
+
+   struct stat status;
+   if (stat(log->snapshotPath, &status) == 0) {
+      if (!loadSnapshot(database, log->snapshotPath)) {
+         deleteLog(log);
+         return false;
+      }
+      log->snapshotSize = status.st_size;
+   }
+
+   log->fd = open(path, O_RDWR);
+   LogHeader header;
+   if (log->fd >= 0) {
+      if (fstat(log->fd, &status) != 0 || (size_t) status.st_size < sizeof(LogHeader)
+          || pread(log->fd, &header, sizeof(LogHeader), 0) != sizeof(LogHeader)
+          || memcmp(header.magic, LOG_MAGIC, sizeof(header.magic)) != 0
+          || header.generation > database->generation) {
+         deleteLog(log);
+         return false;
+      }
+      if (header.generation < database->generation) {
+         // Dziennik sprzed przerwanego kompaktowania - jego polecenia są już w migawce.
+         close(log->fd);
+         log->fd = -1;
+      }
+   }
+   else if (errno != ENOENT) {
+      deleteLog(log);
+      return false;
+   }
+
+   if (log->fd < 0) {
+      char *temporaryPath = concatenate(path, ".tmp");
+      log->fd = createLog(path, temporaryPath, database->generation);
+      free(temporaryPath);
+      if (log->fd < 0) {
+         deleteLog(log);
+         return false;
+      }
+      log->size = sizeof(LogHeader);
+   }
+   else {
+      if (!replayLog(log->fd, status.st_size, database, &log->size)) {
+         deleteLog(log);
+         return false;
+      }
+      // Odrzucamy niepełny rekord zapisany w trakcie awarii.
+      if (log->size < (uint64_t) status.st_size
+          && (ftruncate(log->fd, log->size) != 0 || fsync(log->fd) != 0)) {
+         deleteLog(log);
+         return false;
+      }
+   }
+   if (lseek(log->fd, 0, SEEK_END) < 0) {
+      deleteLog(log);
+      return false;
+   }
+
+   database->log = log;
+   return true;
+}
+
+void appendToLog(Mutation *mutation, Database *database) {
+   WriteAheadLog *log = database->log;
+   size_t maxLength = MAX_RECORD_OVERHEAD + mutation->atr1.length + mutation->atr2.length;
+   if (log->capacity - log->used < maxLength) {
+      writeBuffer(database);
+   }
+   if (log->capacity < maxLength) {
+      log->capacity = maxLength;
+      log->buffer = realloc(log->buffer, log->capacity);
+   }
+
+   char *record = log->buffer + log->used;
+   char *position = record;
+   *position++ = (char) mutation->type;
+   position = encodeNumber(position, mutation->atr1.length);
+   if (mutation->type != DeletePatientMutation) {
+      position = encodeNumber(position, mutation->atr2.length);
+   }
+   if (mutation->type == ChangeDescriptionMutation) {
+      position = encodeNumber(position, (uint32_t) mutation->n);
+   }
+   memcpy(position, mutation->atr1.data, mutation->atr1.length);
+   position += mutation->atr1.length;
+   if (mutation->type != DeletePatientMutation) {
+      memcpy(position, mutation->atr2.data, mutation->atr2.length);
+      position += mutation->atr2.length;
+   }
+   uint32_t sum = checksum(record, position - record);
+   memcpy(position, &sum, sizeof(uint32_t));
+   position += sizeof(uint32_t);
+
+   log->used += position - record;
+   log->size += position - record;
+   log->dirty = true;
+}
+
+bool syncWriteAheadLog(Database *database) {
+   WriteAheadLog *log = database->log;
+   if (log == NULL || !log->dirty || database->failure[0] != '\0') {
+      return database->failure[0] == '\0';
+   }
+   if (!syncLog(database)) {
+      return false;
+   }
+   // Migawka jest zapisywana, gdy dziennik przerośnie zarówno próg, jak i poprzednią migawkę.
+   if (log->size > log->compactionSize && log->size > log->snapshotSize) {
+      compactLog(database);
+   }
+   return database->failure[0] == '\0';
+}
+
+void closeWriteAheadLog(Database *database) {
+   WriteAheadLog *log = database->log;
+   if (log == NULL) {
+      return;
+   }
+   if (log->dirty && database->failure[0] == '\0') {
+      syncLog(database);
+   }
+   deleteLog(log);
+   database->log = NULL;
+}